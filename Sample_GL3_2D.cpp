@@ -5,14 +5,27 @@
 #include <vector>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#ifndef __APPLE__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
 #include <time.h>
 #include <unistd.h>
 #include <string>
 #include <sstream>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <atomic>
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include "soft_raster.h"
+#include "angrysim.h"
+#ifdef USE_VULKAN
+#include "render_vulkan.h"
+#endif
 
 using namespace std;
 
@@ -24,6 +37,10 @@ struct VAO {
 	GLenum PrimitiveMode;
 	GLenum FillMode;
 	int NumVertices;
+
+	// Copies of the buffers, used when rendering without OpenGL
+	GLfloat* Vertices;
+	GLfloat* Colors;
 };
 typedef struct VAO VAO;
 
@@ -36,6 +53,22 @@ struct GLMatrices {
 
 GLuint programID;
 
+/* Renderer behind create3DObject / draw3DObject */
+enum RenderBackend { BACKEND_GL, BACKEND_SOFT, BACKEND_NULL, BACKEND_VULKAN };
+int backend = BACKEND_GL;
+SoftRasterizer *softRaster = NULL;
+#ifdef USE_VULKAN
+VulkanRenderer *vulkan = NULL;
+#endif
+glm::mat4 currentMVP;
+
+/* What the null backend was asked to do */
+struct DrawStats {
+	long meshes;
+	long draws;
+	long vertices;
+} drawStats;
+
 /* Function to load Shaders - Use it as it is */
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path) {
 
@@ -76,7 +109,7 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	// Check Vertex Shader
 	glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
 	glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	std::vector<char> VertexShaderErrorMessage(InfoLogLength);
+	std::vector<char> VertexShaderErrorMessage( max(InfoLogLength, int(1)) );
 	glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
 	fprintf(stdout, "%s", &VertexShaderErrorMessage[0]);
 
@@ -89,7 +122,7 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	// Check Fragment Shader
 	glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
 	glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	std::vector<char> FragmentShaderErrorMessage(InfoLogLength);
+	std::vector<char> FragmentShaderErrorMessage( max(InfoLogLength, int(1)) );
 	glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
 	fprintf(stdout, "%s", &FragmentShaderErrorMessage[0]);
 
@@ -118,10 +151,25 @@ static void error_callback(int error, const char* description)
 	fprintf(stderr, "Error: %s\n", description);
 }
 
+/* Simulation thread, when the game runs on two threads */
+atomic<bool> simRunning(false);
+thread simThread;
+
+void stopSimulation()
+{
+	if (simThread.joinable()) {
+		simRunning = false;
+		simThread.join();
+	}
+}
+
 void quit(GLFWwindow *window)
 {
-	glfwDestroyWindow(window);
-	glfwTerminate();
+	stopSimulation();
+	if (window) {
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
 	exit(EXIT_SUCCESS);
 }
 
@@ -133,6 +181,32 @@ struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloa
 	vao->PrimitiveMode = primitive_mode;
 	vao->NumVertices = numVertices;
 	vao->FillMode = fill_mode;
+	vao->Vertices = NULL;
+	vao->Colors = NULL;
+
+	if (backend == BACKEND_NULL) {
+		// Only hand out a handle, nothing is ever drawn
+		vao->VertexArrayID = ++drawStats.meshes;
+		vao->VertexBuffer = 0;
+		vao->ColorBuffer = 0;
+		return vao;
+	}
+	if (backend == BACKEND_SOFT) {
+		vao->Vertices = new GLfloat [3*numVertices];
+		vao->Colors = new GLfloat [3*numVertices];
+		memcpy(vao->Vertices, vertex_buffer_data, 3*numVertices*sizeof(GLfloat));
+		memcpy(vao->Colors, color_buffer_data, 3*numVertices*sizeof(GLfloat));
+		return vao;
+	}
+#ifdef USE_VULKAN
+	if (backend == BACKEND_VULKAN) {
+		// The vertices are uploaded once, the handle indexes the renderer's mesh table
+		vao->VertexArrayID = vulkan->createMesh(primitive_mode, fill_mode, numVertices, vertex_buffer_data, color_buffer_data);
+		vao->VertexBuffer = 0;
+		vao->ColorBuffer = 0;
+		return vao;
+	}
+#endif
 
 	// Create Vertex Array Object
 	// Should be done after CreateWindow and before any other GL calls
@@ -182,6 +256,22 @@ struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloa
 /* Render the VBOs handled by VAO */
 void draw3DObject (struct VAO* vao)
 {
+	if (backend == BACKEND_NULL) {
+		drawStats.draws++;
+		drawStats.vertices += vao->NumVertices;
+		return;
+	}
+	if (backend == BACKEND_SOFT) {
+		softRaster->draw(vao->PrimitiveMode, vao->FillMode, vao->NumVertices, vao->Vertices, vao->Colors, 3, &currentMVP[0][0]);
+		return;
+	}
+#ifdef USE_VULKAN
+	if (backend == BACKEND_VULKAN) {
+		vulkan->draw(vao->VertexArrayID, &currentMVP[0][0]);
+		return;
+	}
+#endif
+
 	// Change the Fill Mode for this object
 	glPolygonMode (GL_FRONT_AND_BACK, vao->FillMode);
 
@@ -202,11 +292,216 @@ void draw3DObject (struct VAO* vao)
 	glDrawArrays(vao->PrimitiveMode, 0, vao->NumVertices); // Starting from vertex 0; 3 vertices total -> 1 triangle
 }
 
-float gravity = 0.6,airDrag = 0.005,friction = 0.1,t=0,groundDrag = 0.5;
+/* Set the MVP matrix used by the following draw calls */
+void setMVP (glm::mat4& MVP)
+{
+	if (backend == BACKEND_GL)
+		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+	else
+		currentMVP = MVP;
+}
+
+void setClearColor (GLfloat red, GLfloat green, GLfloat blue)
+{
+	if (backend == BACKEND_GL)
+		glClearColor (red, green, blue, 1.0f); // R, G, B, A
+	else if (backend == BACKEND_SOFT)
+		softRaster->setClearColor(red, green, blue);
+#ifdef USE_VULKAN
+	else if (backend == BACKEND_VULKAN)
+		vulkan->setClearColor(red, green, blue);
+#endif
+}
+
+/* Draws between beginStaticLayer and endStaticLayer must only depend on the VP matrix.
+   The Vulkan backend records them once and replays them while VP stays the same;
+   when beginStaticLayer returns false the draws must be skipped */
+bool beginStaticLayer (int layer, glm::mat4 VP)
+{
+#ifdef USE_VULKAN
+	if (backend == BACKEND_VULKAN)
+		return vulkan->beginStaticLayer(layer, &VP[0][0]);
+#endif
+	return true;
+}
+
+void endStaticLayer ()
+{
+#ifdef USE_VULKAN
+	if (backend == BACKEND_VULKAN)
+		vulkan->endStaticLayer();
+#endif
+}
+
+/* Ring buffer for geometry that changes every frame (trails, previews, batched sprites).
+   Vertices are interleaved as x,y,z,r,g,b. The buffer is split in STREAM_SEGMENTS
+   segments, one per frame in flight, and each segment is guarded by a fence so the
+   CPU never writes into memory the GPU may still be reading.
+   With GL_ARB_buffer_storage the buffer is mapped once, persistently; otherwise the
+   segment is written to a client side copy and uploaded into an orphaned buffer. */
+#define STREAM_SEGMENTS 3
+
+struct StreamBuffer {
+	GLuint VertexArrayID;
+	GLuint Buffer;
+
+	int SegmentVertices; // capacity of one segment
+	int Segment;         // segment written this frame
+	int Written;         // vertices written to the segment so far
+	int Drawn;           // vertices of the segment already drawn
+	GLsync Fence[STREAM_SEGMENTS];
+
+	bool Persistent;
+	GLfloat* Mapped;     // persistent mapping or client side copy of one segment
+};
+typedef struct StreamBuffer StreamBuffer;
+
+/* Generate the VAO and the ring buffer, big enough for maxVertices per frame */
+struct StreamBuffer* createStreamBuffer (int maxVertices)
+{
+	struct StreamBuffer* sb = new struct StreamBuffer;
+	GLsizeiptr segmentSize = 6*maxVertices*sizeof(GLfloat);
+	sb->SegmentVertices = maxVertices;
+	sb->Segment = 0;
+	sb->Written = 0;
+	sb->Drawn = 0;
+	for (int i=0; i<STREAM_SEGMENTS; i++)
+		sb->Fence[i] = 0;
+	sb->Persistent = backend == BACKEND_GL && GLAD_GL_ARB_buffer_storage;
+
+	if (backend != BACKEND_GL) {
+		sb->Mapped = new GLfloat [6*maxVertices];
+		return sb;
+	}
+
+	glGenVertexArrays(1, &(sb->VertexArrayID));
+	glGenBuffers (1, &(sb->Buffer));
+	glBindVertexArray (sb->VertexArrayID);
+	glBindBuffer (GL_ARRAY_BUFFER, sb->Buffer);
+
+	if (sb->Persistent) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage (GL_ARRAY_BUFFER, STREAM_SEGMENTS*segmentSize, NULL, flags);
+		sb->Mapped = (GLfloat*) glMapBufferRange (GL_ARRAY_BUFFER, 0, STREAM_SEGMENTS*segmentSize, flags);
+	}
+	else {
+		glBufferData (GL_ARRAY_BUFFER, segmentSize, NULL, GL_STREAM_DRAW);
+		sb->Mapped = new GLfloat [6*maxVertices];
+	}
+
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6*sizeof(GLfloat), (void*)0);                   // x,y,z
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6*sizeof(GLfloat), (void*)(3*sizeof(GLfloat))); // r,g,b
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+
+	return sb;
+}
+
+/* Reserve numVertices in the current segment and return where to write them (6 floats each) */
+GLfloat* mapStream (struct StreamBuffer* sb, int numVertices)
+{
+	if (sb->Written + numVertices > sb->SegmentVertices) {
+		fprintf(stderr, "Stream buffer overflow: %d vertices requested, %d left\n", numVertices, sb->SegmentVertices - sb->Written);
+		return NULL;
+	}
+	GLfloat* ptr = sb->Mapped + 6*sb->Written;
+	if (sb->Persistent)
+		ptr += 6*sb->Segment*sb->SegmentVertices;
+	sb->Written += numVertices;
+	return ptr;
+}
+
+/* Render everything written since the last drawStream call */
+void drawStream (struct StreamBuffer* sb, GLenum primitive_mode, GLenum fill_mode=GL_FILL)
+{
+	int count = sb->Written - sb->Drawn;
+	if (count <= 0)
+		return;
+
+	if (backend == BACKEND_NULL) {
+		drawStats.draws++;
+		drawStats.vertices += count;
+		sb->Drawn = sb->Written;
+		return;
+	}
+	if (backend == BACKEND_SOFT) {
+		softRaster->draw(primitive_mode, fill_mode, count, sb->Mapped + 6*sb->Drawn, sb->Mapped + 6*sb->Drawn + 3, 6, &currentMVP[0][0]);
+		sb->Drawn = sb->Written;
+		return;
+	}
+#ifdef USE_VULKAN
+	if (backend == BACKEND_VULKAN) {
+		vulkan->drawTransient(primitive_mode, fill_mode, count, sb->Mapped + 6*sb->Drawn, &currentMVP[0][0]);
+		sb->Drawn = sb->Written;
+		return;
+	}
+#endif
+
+	glPolygonMode (GL_FRONT_AND_BACK, fill_mode);
+	glBindVertexArray (sb->VertexArrayID);
+
+	if (sb->Persistent) {
+		glDrawArrays(primitive_mode, sb->Segment*sb->SegmentVertices + sb->Drawn, count);
+	}
+	else {
+		// The buffer was orphaned at the start of the frame, so this range is never in use by the GPU
+		glBindBuffer (GL_ARRAY_BUFFER, sb->Buffer);
+		glBufferSubData (GL_ARRAY_BUFFER, 6*sb->Drawn*sizeof(GLfloat), 6*count*sizeof(GLfloat), sb->Mapped + 6*sb->Drawn);
+		glDrawArrays(primitive_mode, sb->Drawn, count);
+	}
+	sb->Drawn = sb->Written;
+}
+
+/* Call once per frame after the last drawStream: fence this segment and move to the next one */
+void endStreamFrame (struct StreamBuffer* sb)
+{
+	if (backend != BACKEND_GL) {
+		// Nothing to synchronise with
+	}
+	else if (sb->Persistent) {
+		if (sb->Fence[sb->Segment])
+			glDeleteSync(sb->Fence[sb->Segment]);
+		sb->Fence[sb->Segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		sb->Segment = (sb->Segment + 1) % STREAM_SEGMENTS;
+
+		// Only blocks when the CPU is STREAM_SEGMENTS frames ahead of the GPU
+		GLsync fence = sb->Fence[sb->Segment];
+		if (fence) {
+			GLenum status = glClientWaitSync(fence, 0, 0);
+			while (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED && status != GL_WAIT_FAILED)
+				status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+			glDeleteSync(fence);
+			sb->Fence[sb->Segment] = 0;
+		}
+	}
+	else {
+		// Orphan the storage: the driver hands out fresh memory instead of waiting on the old one
+		glBindBuffer (GL_ARRAY_BUFFER, sb->Buffer);
+		glBufferData (GL_ARRAY_BUFFER, 6*sb->SegmentVertices*sizeof(GLfloat), NULL, GL_STREAM_DRAW);
+	}
+	sb->Written = 0;
+	sb->Drawn = 0;
+}
+
+#define MAX_FRAME_TIME 0.25	// longest frame caught up on, after that the game slows down instead
+#define SNAP_DISTANCE 0.5	// moves longer than this in one step are jumps (respawn, portal), drawn without blending
+
+/* Fraction of a step elapsed since the last Game::step(); advanceSimulation() runs steps of
+   SIM_DT until the time accumulated in simTime catches up with the clock. Moving objects
+   keep their state from the step before and are drawn in between, so motion is smooth at
+   any refresh rate */
+float renderAlpha = 1;
+
+float interpolate(float previous, float current, float snap = 1e30f)
+{
+	if (fabs(current - previous) > snap)
+		return current;
+	return previous + (current - previous)*renderAlpha;
+}
+
 float camera_rotation_angle = 90;
-int counter,counter1,counter2;
 bool twinkleOverride = false;
-int level=1;
 glm::vec3 cameraPos = glm::vec3(0.0f,0.0f,3.0f);
 glm::vec3 cameraFront = glm::vec3(0.0f,0.0f,-1.0f);
 glm::vec3 cameraUp = glm::vec3(0.0f,1.0f,0.0f);
@@ -216,6 +511,18 @@ class Background{
 	public:
 
 		void draw(){
+			if(backend == BACKEND_NULL)
+				return;
+			if(backend == BACKEND_SOFT){
+				softRaster->clear();
+				return;
+			}
+#ifdef USE_VULKAN
+			if(backend == BACKEND_VULKAN){
+				vulkan->beginFrame();
+				return;
+			}
+#endif
 			glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 			glUseProgram (programID);
 
@@ -226,10 +533,8 @@ Background bg;
 class Board{
 	public:
 		VAO *brd,*bbrd,*cir[2],*tri,*cross[2],*dcir[2];
-		bool levelUp;
 		float radius;
 		Board(){
-			levelUp = false;
 			radius = 0.6;
 		}
 
@@ -414,7 +719,7 @@ class Board{
 			}
 
 			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+			setMVP(MVP);
 			if(index==-1)
 				draw3DObject(bbrd);
 			if(index==0)
@@ -539,7 +844,7 @@ class Border{
 			Matrices.model *= (translateBor3);
 		}
 		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+		setMVP(MVP);
 		draw3DObject(bor[orient]);
 
 	}
@@ -737,7 +1042,7 @@ class Sun{
 			glm::mat4 translateSn = glm::translate (glm::vec3(posx, posy, 0));
 			Matrices.model *= (translateSn);
 			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+			setMVP(MVP);
 			draw3DObject(sn[index]);
 
 
@@ -746,23 +1051,12 @@ class Sun{
 
 Sun sun;
 
-class Portal{
+class PortalMesh{
 
 	public:
 		VAO *por,*layer[5];
-		float posx;
-		float posy;
-		float radius;
-		float center[2];
-		Portal(){
-			posx = 3.2;
-			posy = 1.5;	
-			radius = 0.4;
-			center[0]=posx;
-			center[1]=posy;
-		}
 
-		void create(int index){
+		void create(int index,float radius){
 			int i,numVertices = 360;
 
 			if(index==0){
@@ -920,7 +1214,7 @@ class Portal{
 			}
 		}
 
-		void draw(int index,int num){
+		void draw(Portal& portal,int index,int num){
 			Matrices.view = glm::lookAt(cameraPos,cameraPos+cameraFront,cameraUp);
 			glm::mat4 VP = Matrices.projection * Matrices.view;
 			glm::mat4 MVP;  // MVP = Projection * View * Model
@@ -928,12 +1222,10 @@ class Portal{
 
 			Matrices.model = glm::mat4(1.0f);
 
-			glm::mat4 translatePt = glm::translate (glm::vec3(posx, posy, 0));
+			glm::mat4 translatePt = glm::translate (glm::vec3(portal.posx, portal.posy, 0));
 			Matrices.model *= (translatePt);
 			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-			center[0]=posx;
-			center[1]=posy;
+			setMVP(MVP);
 			if(index==1)
 				draw3DObject(por);
 			else
@@ -944,7 +1236,7 @@ class Portal{
 
 };
 
-Portal portal[4];
+PortalMesh portalMesh;
 class Heart{
 
 	public:
@@ -1034,7 +1326,7 @@ class Heart{
 			glm::mat4 translateLt = glm::translate (glm::vec3(posx, posy, 0));
 			Matrices.model *= (translateLt);
 			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+			setMVP(MVP);
 			draw3DObject(hrt[index]);
 
 
@@ -1045,23 +1337,11 @@ class Heart{
 
 Heart heart[4];
 
-class Star{
+/* The three strokes of a star, one mesh each */
+class StarMesh{
 
 	public:
-		VAO *st[90];
-		float posx;
-		float posy;
-		float radius;
-		int twinkle;
-		bool pause;
-
-		Star(){
-			posx=0;
-			posy=0;
-			radius=0.05;
-			twinkle=1;
-			pause=false;
-		}
+		VAO *st[3];
 		void createone(int index)
 		{
 
@@ -1120,7 +1400,7 @@ class Star{
 
 		}
 
-		void draw(int index){
+		void draw(Transform& transform,int index){
 			/*glUseProgram (programID);
 
 			  glm::vec3 eye ( 5*cos(camera_rotation_angle*M_PI/180.0f), 0, 5*sin(camera_rotation_angle*M_PI/180.0f) );
@@ -1136,46 +1416,23 @@ class Star{
 
 			Matrices.model = glm::mat4(1.0f);
 
-			glm::mat4 translateStar = glm::translate (glm::vec3(posx, posy, 0));
+			glm::mat4 translateStar = glm::translate (glm::vec3(transform.x, transform.y, 0));
 			Matrices.model *= (translateStar);
 			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+			setMVP(MVP);
 			draw3DObject(st[index]);
 
 		}
 
 };
-Star star[180];
+StarMesh starMesh;
 
-class Varys{
+class VarysMesh{
 
 	public:
 		VAO *var[2];
-		float posx;
-		float posy;
-		float center[2];
-		float radius;
-		bool collided;
-		int dir;
-		int up;
-		int count;
-		bool pause;
-		Varys(){
-
-			count=0;
-			posx=0;
-			posy=-3.5;
-			radius = 0.1;
-			center[0] = posx;
-			center[1] = posy;
-			dir = 1;
-			up = 1;
-			pause=false;
-		}
-
 
-
-		void createBody(){
+		void createBody(float radius){
 			int numVertices = 360;
 			GLfloat* vertex_buffer_data = new GLfloat [3*numVertices];
 			for (int i=0; i<numVertices; i++) {
@@ -1277,7 +1534,7 @@ class Varys{
 
 		}
 
-		void draw(int index){
+		void draw(Transform& transform,int index){
 			Matrices.view = glm::lookAt(cameraPos,cameraPos+cameraFront,cameraUp);
 			glm::mat4 VP = Matrices.projection * Matrices.view;
 			glm::mat4 MVP;  // MVP = Projection * View * Model
@@ -1285,111 +1542,29 @@ class Varys{
 
 			Matrices.model = glm::mat4(1.0f);
 
-			glm::mat4 translateVarys = glm::translate (glm::vec3(posx, posy, 0));
+			glm::mat4 translateVarys = glm::translate (glm::vec3(interpolate(transform.prevx, transform.x, SNAP_DISTANCE), interpolate(transform.prevy, transform.y, SNAP_DISTANCE), 0));
 			Matrices.model *= (translateVarys);
 			MVP = VP * Matrices.model;
-			if(!pause){
-				posx += 0.02*dir;
-				posy += 0.02*up;
-			}
-			center[0]=posx;
-			center[1]=posy;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+			setMVP(MVP);
 			draw3DObject(var[index]);
 
 		}
-
-		void turn(){
-			count++;
-			if(count%25==0){
-				dir=-1*dir;
-			}
-			if(center[1] > 3.5)
-				up = -1;
-			if(center[1] < -3.5)
-				up = 1;
-		}	
 };
-Varys varys[2];
+VarysMesh varysMesh;
 
-class Target{
-	float posx;
-	float posy;
-	float vel;
-	float theta;
-	float marks;
-	float center[2];
-	float radius;
-	bool collided;
+class TargetMesh{
 	public:
-	int dir;
-	float scaleFactor;
-	bool shrink;
 	VAO *tar,*eye[2],*pupil[2],*mouth,*tooth;
-	bool pause;
-	int count;
-	Target(){
-		posx = 2;
-		posy = 2;
-		vel = 0;
-		theta = 0;
-		marks = 5;
-		center[0] = 2;
-		center[1] = 2;
-		radius = 0.25;
-		collided = false;
-		count = 0;
-		dir=1;
-		scaleFactor=1;
-		shrink=false;
-		pause=false;
-	}
-	float getX(){
-		return posx;
-	}
-	float getY(){
-		return posy;
-	}
-	void setX(int x){
-		posx = x;
-	}
-	void setY(int y){
-		posy = y;
-	}
-	float getMarks(){
-		return marks;
-	}
-	float* getCenter(){
-		return center;
-	}
-	float getRadius(){
-		return radius;
-	}
-	bool getCollided(){
-		return collided;
-	}
-	void setCollided(bool col){
-		collided = col;
-	}
-	void setMarks(int m){
-		marks = m;
-	}
-	void setCenter(float cx,float cy){
-		center[0] = cx;
-		center[1] = cy;
-	}
-	void setRadius(float r){
-		radius = r;
-	}
 
+	/* The meshes are built for a unit radius, draw() scales them to size */
 	void create()
 	{
 
 		int numVertices = 360;
 		GLfloat* vertex_buffer_data = new GLfloat [3*numVertices];
 		for (int i=0; i<numVertices; i++) {
-			vertex_buffer_data [3*i] = 1.05*radius*cos(i*M_PI/180.0f);
-			vertex_buffer_data [3*i + 1] = 0.95*radius*sin(i*M_PI/180.0f);
+			vertex_buffer_data [3*i] = 1.05*cos(i*M_PI/180.0f);
+			vertex_buffer_data [3*i + 1] = 0.95*sin(i*M_PI/180.0f);
 			vertex_buffer_data [3*i + 2] = 0;
 		}
 
@@ -1412,8 +1587,8 @@ class Target{
 		int numVertices = 360;
 		GLfloat* vertex_buffer_data = new GLfloat [3*numVertices];
 		for (int i=0; i<numVertices; i++) {
-			vertex_buffer_data [3*i] = startx + 0.22*radius*cos(i*M_PI/180.0f);
-			vertex_buffer_data [3*i + 1] = starty + 0.44*radius*sin(i*M_PI/180.0f);
+			vertex_buffer_data [3*i] = startx + 0.22*cos(i*M_PI/180.0f);
+			vertex_buffer_data [3*i + 1] = starty + 0.44*sin(i*M_PI/180.0f);
 			vertex_buffer_data [3*i + 2] = 0;
 		}
 
@@ -1436,8 +1611,8 @@ class Target{
 		int numVertices = 360;
 		GLfloat* vertex_buffer_data = new GLfloat [3*numVertices];
 		for (int i=0; i<numVertices; i++) {
-			vertex_buffer_data [3*i] = startx + 0.11*radius*cos(i*M_PI/180.0f);
-			vertex_buffer_data [3*i + 1] = starty + 0.22*radius*sin(i*M_PI/180.0f);
+			vertex_buffer_data [3*i] = startx + 0.11*cos(i*M_PI/180.0f);
+			vertex_buffer_data [3*i + 1] = starty + 0.22*sin(i*M_PI/180.0f);
 			vertex_buffer_data [3*i + 2] = 0;
 		}
 
@@ -1458,8 +1633,8 @@ class Target{
 		int numVertices = 180;
 		GLfloat* vertex_buffer_data = new GLfloat [3*numVertices];
 		for (int i=0; i<numVertices; i++) {
-			vertex_buffer_data [3*i] = x + 0.4*radius*cos(i*M_PI/180.0f);
-			vertex_buffer_data [3*i + 1] = y + 0.4*radius*sin(i*M_PI/180.0f);
+			vertex_buffer_data [3*i] = x + 0.4*cos(i*M_PI/180.0f);
+			vertex_buffer_data [3*i + 1] = y + 0.4*sin(i*M_PI/180.0f);
 			vertex_buffer_data [3*i + 2] = 0;
 		}
 
@@ -1478,7 +1653,7 @@ class Target{
 
 	}
 
-	void createTooth(float x,float y){
+	void createTooth(float radius,float y){
 		static const GLfloat vertex_buffer_data [] = {
 			-0.15*radius,-1*y,0, // vertex 1
 			0.15*radius,-1*y,0, // vertex 2
@@ -1502,7 +1677,7 @@ class Target{
 		tooth = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
 
 	}
-	void draw(int i,int index,float angle){
+	void draw(Transform& transform,RenderMesh& mesh,int i,int index,float angle){
 
 		Matrices.view = glm::lookAt(cameraPos,cameraPos+cameraFront,cameraUp);
 		glm::mat4 VP = Matrices.projection * Matrices.view;
@@ -1511,22 +1686,13 @@ class Target{
 
 		Matrices.model = glm::mat4(1.0f);
 
-		glm::mat4 translateTar = glm::translate (glm::vec3(posx, posy, 0));
+		float scale = mesh.size*interpolate(transform.prevScale, transform.scale, SNAP_DISTANCE);
+		glm::mat4 translateTar = glm::translate (glm::vec3(transform.x, interpolate(transform.prevy, transform.y, SNAP_DISTANCE), 0));
 		glm::mat4 rotateTar = glm::rotate((float)(angle*M_PI/180.0f), glm::vec3(0,0,1));
-		glm::mat4 scaleTar = glm::scale (glm::vec3(scaleFactor, scaleFactor, 0));
+		glm::mat4 scaleTar = glm::scale (glm::vec3(scale, scale, 0));
 		Matrices.model *= (translateTar * rotateTar * scaleTar);
-		if(!pause){
-			posy+=0.0005*dir;
-			center[1] = posy;	
-			count++;
-			if(count%150==0)
-				dir=-1*dir;
-
-			if(scaleFactor>0&&shrink)
-				scaleFactor-=0.001;
-		}
 		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+		setMVP(MVP);
 		if(i==0)
 			draw3DObject(tar);
 		if(i==1)
@@ -1540,30 +1706,15 @@ class Target{
 
 
 	}
-
 };
 
-Target target[7];
+TargetMesh targetMesh;
 
-class Comet{
+class CometMesh{
 	public:
 		VAO *com,*train;
-		float posx;
-		float posy;
-		bool show;
-		float center[2];
-		float radius;
-		bool pause;
-		Comet(){
-			posx = 5;
-			posy = 2;
-			center[0] = posx;
-			center[1] = posy;
-			radius = 0.1;
-			show = false;	
-			pause=false;
-		}
-		void create(){
+
+		void create(float radius){
 			int numVertices = 360;
 			GLfloat* vertex_buffer_data = new GLfloat [3*numVertices];
 			for (int i=0; i<numVertices; i++) {
@@ -1661,7 +1812,7 @@ class Comet{
 
 
 		}
-		void draw(int index){
+		void draw(Transform& transform,int index){
 			Matrices.view = glm::lookAt(cameraPos,cameraPos+cameraFront,cameraUp);
 			glm::mat4 VP = Matrices.projection * Matrices.view;
 			glm::mat4 MVP;  // MVP = Projection * View * Model
@@ -1669,14 +1820,10 @@ class Comet{
 
 			Matrices.model = glm::mat4(1.0f);
 
-			glm::mat4 translateTar = glm::translate (glm::vec3(posx, posy, 0));
+			glm::mat4 translateTar = glm::translate (glm::vec3(interpolate(transform.prevx, transform.x, SNAP_DISTANCE), interpolate(transform.prevy, transform.y, SNAP_DISTANCE), 0));
 			Matrices.model *= (translateTar);
-			if(!pause){
-				posx-=0.03;
-				center[0]=posx;
-			}
 			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+			setMVP(MVP);
 			if(index==0)
 				draw3DObject(com);
 			if(index==1)
@@ -1684,44 +1831,17 @@ class Comet{
 
 
 		}
-
-		void stop(){
-			if(center[0] < -4.5){
-				show = false;
-				posx = 5;
-				center[0] = posx;
-			}
-		}
-
 };
 
-Comet comet;
+CometMesh cometMesh;
 
 
-class Light{
+class LightMesh{
 
 	public:
 		VAO *li;
-		float posx;
-		float posy;
-		float center[2];
-		float radius;
-		bool show;
-		bool pause;
-		float angle;
-
-		Light(){
-			posx=0;
-			posy=0;
-			radius=0.05;
-			center[0] = posx;
-			center[1] = posy;
-			show = true;
-			pause = false;
-			angle = 0;
-		}
-
-		void create()
+
+		void create(float radius)
 		{
 
 			int numVertices = 360;
@@ -1744,7 +1864,7 @@ class Light{
 			li = create3DObject(GL_TRIANGLE_FAN, numVertices, vertex_buffer_data, color_buffer_data, GL_FILL);
 		}
 
-		void draw(){
+		void draw(Transform& transform){
 			Matrices.view = glm::lookAt(cameraPos,cameraPos+cameraFront,cameraUp);
 			glm::mat4 VP = Matrices.projection * Matrices.view;
 			glm::mat4 MVP;  // MVP = Projection * View * Model
@@ -1752,92 +1872,32 @@ class Light{
 
 			Matrices.model = glm::mat4(1.0f);
 
-			glm::mat4 translateLt1 = glm::translate (glm::vec3(0, 0, 0));
-			glm::mat4 translateLt2 = glm::translate (glm::vec3(posx, posy, 0));
-			glm::mat4 rotateLt = glm::rotate((float)(angle*M_PI/180.0f), glm::vec3(0,1,0));
-			center[0] = posx;
-			center[1] = posy;
-			if(!pause)
-				angle+=2;
-			Matrices.model *= (translateLt2 * rotateLt);
+			glm::mat4 translateLt = glm::translate (glm::vec3(transform.x, transform.y, 0));
+			glm::mat4 rotateLt = glm::rotate((float)(transform.rotation*M_PI/180.0f), glm::vec3(0,1,0));
+			Matrices.model *= (translateLt * rotateLt);
 			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+			setMVP(MVP);
 			draw3DObject(li);
 
 
 		}
-
 };
 
-Light light[30];
+LightMesh lightMesh;
 
-float obstacle_rotation = 0;
-class Obstacle{
-	float posx;
-	float posy;
-	float marks;
-	float center[2];
-	float radius;
-	bool collided;
+class ObstacleMesh{
 	public:
 	VAO *obs[3];
-	bool pause;
-	Obstacle(){
-		posx = 2;
-		posy = 2;
-		marks = 5;
-		center[0] = posx;
-		center[1] = posy;
-		radius = 0.25;
-		collided = false;
-		pause=false;
-	}
-	float getX(){
-		return posx;
-	}
-	float getY(){
-		return posy;
-	}
-	void setX(int x){
-		posx = x;
-	}
-	void setY(int y){
-		posy = y;
-	}
-	float getMarks(){
-		return marks;
-	}
-	float* getCenter(){
-		return center;
-	}
-	float getRadius(){
-		return radius;
-	}
-	bool getCollided(){
-		return collided;
-	}
-	void setCollided(bool col){
-		collided = col;
-	}
-	void setMarks(int m){
-		marks = m;
-	}
-	void setCenter(float cx,float cy){
-		center[0] = cx;
-		center[1] = cy;
-	}
-	void setRadius(float r){
-		radius = r;
-	}
 
+	/* The meshes are built for a unit radius, draw() scales them to radius */
 	void createBig()
 	{
 
 		int numVertices = 72,i;
 		GLfloat* vertex_buffer_data = new GLfloat [3*numVertices];
 		for (i=0; i<numVertices; i++) {
-			vertex_buffer_data [3*i] = radius*cos((72*i)*M_PI/180.0f);
-			vertex_buffer_data [3*i + 1] = radius*sin((72*i)*M_PI/180.0f);
+			vertex_buffer_data [3*i] = cos((72*i)*M_PI/180.0f);
+			vertex_buffer_data [3*i + 1] = sin((72*i)*M_PI/180.0f);
 			vertex_buffer_data [3*i + 2] = 0;
 		}
 
@@ -1865,8 +1925,8 @@ class Obstacle{
 		int numVertices = 72,i;
 		GLfloat* vertex_buffer_data = new GLfloat [3*numVertices];
 		for (i=0; i<numVertices; i++) {
-			vertex_buffer_data [3*i] = 0.66*radius*cos((72*i)*M_PI/180.0f);
-			vertex_buffer_data [3*i + 1] = 0.66*radius*sin((72*i)*M_PI/180.0f);
+			vertex_buffer_data [3*i] = 0.66*cos((72*i)*M_PI/180.0f);
+			vertex_buffer_data [3*i + 1] = 0.66*sin((72*i)*M_PI/180.0f);
 			vertex_buffer_data [3*i + 2] = 0;
 		}
 
@@ -1891,8 +1951,8 @@ class Obstacle{
 
 		GLfloat* vertex_buffer_data1 = new GLfloat [3*numVertices];
 		for (i=0; i<numVertices; i++) {
-			vertex_buffer_data1 [3*i] = 0.33*radius*cos((72*i)*M_PI/180.0f);
-			vertex_buffer_data1 [3*i + 1] = 0.33*radius*sin((72*i)*M_PI/180.0f);
+			vertex_buffer_data1 [3*i] = 0.33*cos((72*i)*M_PI/180.0f);
+			vertex_buffer_data1 [3*i + 1] = 0.33*sin((72*i)*M_PI/180.0f);
 			vertex_buffer_data1 [3*i + 2] = 0;
 		}
 
@@ -1918,7 +1978,7 @@ class Obstacle{
 
 	}
 
-	void draw(int index){
+	void draw(Transform& transform,RenderMesh& mesh,int index){
 
 		Matrices.view = glm::lookAt(cameraPos,cameraPos+cameraFront,cameraUp);
 		glm::mat4 VP = Matrices.projection * Matrices.view;
@@ -1927,152 +1987,25 @@ class Obstacle{
 
 		Matrices.model = glm::mat4(1.0f);
 
-		glm::mat4 translateObs = glm::translate (glm::vec3(posx, posy, 0));
-		glm::mat4 rotateObs = glm::rotate((float)(obstacle_rotation*M_PI/180.0f), glm::vec3(0,0,1));
-		Matrices.model *= (translateObs*rotateObs);
+		glm::mat4 translateObs = glm::translate (glm::vec3(transform.x, transform.y, 0));
+		glm::mat4 rotateObs = glm::rotate((float)(interpolate(transform.prevRotation, transform.rotation)*M_PI/180.0f), glm::vec3(0,0,1));
+		glm::mat4 scaleObs = glm::scale (glm::vec3(mesh.size, mesh.size, 1));
+		Matrices.model *= (translateObs*rotateObs*scaleObs);
 		MVP = VP * Matrices.model;
-		if(!pause)
-			obstacle_rotation+=0.15;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+		setMVP(MVP);
 		draw3DObject(obs[index]);
 
 	}
-
 };
 
-Obstacle obstacle[7];
+ObstacleMesh obstacleMesh;
 
 
-float bird_rotation = 0;
-class Bird{
-	int lives;
-	int score;
-	float posx;
-	float posy;
-	float vel;
-	float theta;
-	bool isMoving; 
-	float radius;
+class BirdMesh{
 	public:
-	bool immune;
-	bool pause;
-	int hit;
-	bool allowed;
-	float center[2];
-	float initX;
-	float initY;
-	float absy;
-	float absx;
-	float store;
-	float newv;
-	bool floor;
-	bool flag;
-	int dir;
 	VAO *bird,*saucer;
-	Bird(){
-		immune=false;
-		lives = 3;
-		score = 0;
-		allowed=true;
-		isMoving = false;
-		vel = 1.2;
-		theta = 45;
-		posx = 0;
-		posy = 0;
-		radius = 0.12;
-		initX = -3.5;
-		initY = 0;
-		center[0] = 0.05 + initX;
-		center[1] = 0 + initY; 
-		absy = 0;
-		absx = 4;
-		store = 0;
-		floor = false;
-		flag = true;
-		dir = 1;
-		hit=0;
-		pause=false;
-	}
 
-	float getLives(){
-		return lives;
-	}
-	float getScore(){
-		return score;
-	}
-	float getX(){
-		return posx;
-	}
-	float getY(){
-		return posy;
-	}
-	float getVel(){
-		return vel;
-	}
-	float getAngle(){
-		return theta;
-	}
-	float getStatus(){
-		return isMoving;
-	}
-	float *getCenter(){
-		return center;
-	}
-	float getRadius(){
-		return radius;
-	}
-
-	void setStatus(bool st){
-		isMoving = st;
-	}
-
-	void setLives(float l){
-		lives = l;
-	}
-	void setScore(float s){
-		score = s;
-	}
-	void setX(float x){
-		posx = x;
-	}
-	void setY(float y){
-		posy = y;
-	}
-	void setVel(float v){
-		vel = v;
-	}
-	void setAngle(float ang){
-		theta = ang;
-	}
-	void setCenter(float cx,float cy){
-		center[0] = cx;
-		center[1] = cy;
-	}
-	void setRadius(float r){
-		radius = r;
-	}
-
-	void reset(){
-		initX = -3.5;
-		initY = 0;
-		posx = 0;
-		posy = 0;
-		t=0;
-		allowed=true;
-		center[0] = 0.05 + initX; 
-		center[1] = 0 + initY;
-		theta = 45;
-		vel = 1.2;
-		lives--;
-		isMoving = !isMoving;
-		floor = false;
-		immune = false;
-		counter2=0;
-		flag = true;
-		dir = 1;
-	}
-
-	void createSaucer(){
+	void createSaucer(float radius){
 		int numVertices = 360;
 		GLfloat* vertex_buffer_data = new GLfloat [3*numVertices];
 		for (int i=0; i<numVertices; i++) {
@@ -2113,7 +2046,7 @@ class Bird{
 		bird = create3DObject(GL_TRIANGLES, 3, vertex_buffer_data, color_buffer_data, GL_FILL);
 	}
 
-	void draw(int index)
+	void draw(Bird& b,int index)
 
 	{
 
@@ -2122,244 +2055,19 @@ class Bird{
 		glm::mat4 MVP;	// MVP = Projection * View * Model
 		Matrices.model = glm::mat4(1.0f);
 		Matrices.model = glm::mat4(1.0f);
-		glm::mat4 moveBird = glm::translate(glm::vec3((float)(initX+posx),float(initY+posy),0.0f)); 
-		glm::mat4 rotateBird = glm::rotate((float)(bird_rotation*M_PI/180.0f), glm::vec3(0,0,1));
+		glm::mat4 moveBird = glm::translate(glm::vec3(interpolate(b.prevx, b.initX+b.getX(), SNAP_DISTANCE), interpolate(b.prevy, b.initY+b.getY(), SNAP_DISTANCE), 0.0f)); 
+		glm::mat4 rotateBird = glm::rotate((float)(interpolate(b.prevRotation, b.rotation)*M_PI/180.0f), glm::vec3(0,0,1));
 		Matrices.model *= (moveBird*rotateBird);
-		if(!pause)
-			bird_rotation+=0.5;
 		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+		setMVP(MVP);
 		if(index==0)
 			draw3DObject(bird);
 		else
 			draw3DObject(saucer);
-		if(floor&&!pause){
-			if(flag){	
-				vel = vel - groundDrag*t;
-				posx = posx + dir*(vel*t - 0.5*groundDrag*t*t);
-				center[0] = initX + posx + (0.17/3);
-			}
-			if(vel <= 0 || center[0] > 3.25 || center[0] < -3.75){
-				flag = false;
-				//floor = false;
-				reset();
-			}
-		}
-		else if(isMoving&&!pause){
-			float vel_old,theta_old,vel_new,theta_new;
-			if(t>3)
-				allowed=true;	
-			posx = vel*cos(theta*M_PI/180.0f)*t - 0.5*airDrag*t*t;
-			posy = vel*sin(theta*M_PI/180.0f)*t - (0.5*(gravity+(airDrag*sin(theta*M_PI/180.0f)))*t*t);
-			center[0] = initX + posx + (0.17/3);
-			center[1] = initY + posy;
-
-		}
-	}
-
-	void checkCollision(int index){
-		float cx,cy;
-		float r;
-		cx = target[index].getCenter()[0];
-		cy = target[index].getCenter()[1];
-		r = target[index].getRadius();
-		if(sqrt(pow((center[0]-cx),2)+pow((center[1]-cy),2))<=(radius + target[index].getRadius()) && !target[index].shrink){
-			target[index].setCollided(true);
-			setScore(getScore() + (int)((1/r)*4 + abs(target[index].getX()*4) + level*5));	
-			target[index].shrink=true;
-			target[index].setRadius(0);
-			hit++;
-		}
-	}
-
-	void checkComet(){
-		float cx,cy;
-		cx = comet.center[0];
-		cy = comet.center[1];
-		if(sqrt(pow((center[0]-cx),2)+pow((center[1]-cy),2))<=(radius + 0.1)){
-			setLives(getLives() + 1);
-			//immune=true;
-			comet.show=false;
-			comet.posx = 5;
-			comet.center[0] = comet.posx;
-		}
-
-	}
-	void checkLight(int i){
-		float cx,cy;
-		cx = light[i].center[0];
-		cy = light[i].center[1];
-		if(sqrt(pow((center[0]-cx),2)+pow((center[1]-cy),2))<=(radius + light[i].radius)){
-			immune=true;
-			light[i].show=false;
-			light[i].radius=0;
-		}
-	}
-
-	void checkPortal(){
-		float cx1,cy1,cx2,cy2;
-
-		cx1 = portal[0].center[0];
-		cy1 = portal[0].center[1];
-		cx2 = portal[1].center[0];
-		cy2 = portal[1].center[1];
-		if(center[1]>0&&allowed){
-			if(sqrt(pow((center[0]-cx1),2)+pow((center[1]-cy1),2))<=(radius + portal[0].radius)){
-
-				t = 0;
-				initX = cx2;
-				initY = cy2;
-				posx = 0;
-				posy = 0;
-				center[0] = 0.05 + initX; 
-				center[1] = 0 + initY;
-				allowed=false;
-				dir = -1*dir;
-				isMoving=true;
-				if(dir==-1)
-					theta = 135;
-				else
-					theta = 45;
-			}
-		}
-		else if(center[1]<0&&allowed){
-			if(sqrt(pow((center[0]-cx2),2)+pow((center[1]-cy2),2))<=(radius + portal[1].radius)){
-
-				t = 0;
-				initX = cx1;
-				initY = cy1;
-				posx = 0;
-				posy = 0;
-				allowed=false;
-				center[0] = 0.05 + initX; 
-				center[1] = 0 + initY;
-				isMoving=true;
-				dir = -1*dir;
-				if(dir==-1)
-					theta = 135;
-				else
-					theta = 45;
-			}
-		}
-
-	}
-	void checkVarys(){
-		float cx,cy;
-		float r;
-		cx = varys[0].center[0];
-		cy = varys[0].center[1];
-		if(!immune){
-			if(sqrt(pow((center[0]-cx),2)+pow((center[1]-cy),2))<=(radius + 0.2)){
-				setScore(getScore() - (10*level));	
-				reset();
-
-			}
-		}
-
-	}
-	void checkObstacle(int i){
-		float cx,cy;
-		float theta_old,vel_old,vel_new,theta_new,alpha=0.8;
-		cx = obstacle[i].getCenter()[0];
-		cy = obstacle[i].getCenter()[1];
-		if(sqrt(pow((center[0]-cx),2)+pow((center[1]-cy),2))<=(radius + obstacle[i].getRadius())){
-			if(!obstacle[i].getCollided()){
-				initX = initX + posx;
-				initY = initY + posy;
-				theta_old = theta;
-				vel_old = vel;
-
-				vel_new = sqrt(pow(alpha*vel_old*cos(theta_old*M_PI/180.0f),2)+pow(vel_old*sin(theta_old*M_PI/180.0f),2));
-
-				if(dir == 1 && t== 0){	
-					theta_new = 180 - atan(sin(theta_old*M_PI/180.0f)/(alpha*cos(theta*M_PI/180.0f)));
-					dir = -1;
-					obstacle[i].setCollided(true);
-				}
-				else if(dir == -1 && t== 0){
-					theta_new = atan(sin(theta_old*M_PI/180.0f)/(alpha*cos(theta*M_PI/180.0f)));
-					dir = 1;
-					obstacle[i].setCollided(true);
-				}		
-				t=0;
-				vel = vel_new;
-				theta = theta_new;
-			}
-
-		}
-		else
-			obstacle[i].setCollided(false);
-
-	}
-
-	void checkRoof(){
-		float theta_old,vel_old,vel_new,theta_new,alpha=0.8;
-		if(center[1] > 3.6){
-			initX = initX + posx;
-			initY = initY + posy;
-			t=0;
-			theta_old = theta;
-			vel_old = vel;
-			vel_new = sqrt(((alpha*vel_old*cos(theta_old*M_PI/180.0f))*(alpha*vel_old*cos(theta_old*M_PI/180.0f)))+(vel_old*sin(theta_old*M_PI/180.0f)*(vel_old*sin(theta_old*M_PI/180.0f))));
-			theta_new = -1*(atan(sin(theta_old*M_PI/180.0f)/(alpha*cos(theta*M_PI/180.0f))));
-			vel = vel_new;
-			theta = theta_new;
-		}
-	}
-	void checkWall(){
-		float theta_old,vel_old,vel_new,theta_new,alpha=0.8;
-		if(center[0] > 3.65){
-			initX = initX + posx;
-			initY = initY + posy;
-			t=0;
-			theta_old = theta;
-			vel_old = vel;
-			vel_new = sqrt(((alpha*vel_old*cos(theta_old*M_PI/180.0f))*(alpha*vel_old*cos(theta_old*M_PI/180.0f)))+(vel_old*sin(theta_old*M_PI/180.0f)*(vel_old*sin(theta_old*M_PI/180.0f))));
-			theta_new = 180 - atan(sin(theta_old*M_PI/180.0f)/(alpha*cos(theta*M_PI/180.0f)));
-			vel = vel_new;
-			theta = theta_new;
-			if(theta < 90)
-				dir = 1;
-			else
-				dir = -1;
-
-		}
-		else if(center[0] < -3.65){
-			initX = initX + posx;
-			initY = initY + posy;
-			t=0;
-			theta_old = theta;
-			vel_old = vel;
-			vel_new = sqrt(((alpha*vel_old*cos(theta_old*M_PI/180.0f))*(alpha*vel_old*cos(theta_old*M_PI/180.0f)))+(vel_old*sin(theta_old*M_PI/180.0f)*(vel_old*sin(theta_old*M_PI/180.0f))));
-			theta_new = atan(sin(theta_old*M_PI/180.0f)/(alpha*cos(theta*M_PI/180.0f)));
-			vel = vel_new;
-			theta = theta_new;
-			if(theta < 90)
-				dir = 1;
-			else
-				dir = -1;
-
-		}
-
-	}
-
-	void checkFloor(){
-		float theta_old,vel_old,vel_new,theta_new,alpha=0.8;
-		if(center[1] <= -3.6&&!floor){
-			theta_old = theta;
-			vel_old = vel;
-			vel_new = sqrt(((alpha*vel_old*cos(theta_old*M_PI/180.0f))*(alpha*vel_old*cos(theta_old*M_PI/180.0f)))+(vel_old*sin(theta_old*M_PI/180.0f)*(vel_old*sin(theta_old*M_PI/180.0f))));
-			theta_new = atan(sin(theta_old*M_PI/180.0f)/(alpha*cos(theta*M_PI/180.0f)));
-			vel = vel_new;	
-			theta = theta_new;
-			t = 0;
-			vel = vel*cos(theta*M_PI/180.0f);
-			floor = true;	
-		}
 	}
 
 };
-Bird angryBird;
+BirdMesh birdMesh;
 
 
 class Point{
@@ -2368,7 +2076,6 @@ class Point{
 	public:
 	float initX;
 	float initY;
-	VAO *point;
 	Point(){
 		posx = 0;
 		posy = 0;
@@ -2389,9 +2096,31 @@ class Point{
 		posy = y;
 	}
 
-	void create()
+	/* Write the 6 vertices of this dot of the trajectory preview into a stream buffer */
+	void stream (float time, Bird& bird, GLfloat* vertex_data)
 	{
-		static const GLfloat vertex_buffer_data [] = {
+		time/=2;
+
+		posx = bird.getVel()*cos(bird.getAngle()*M_PI/180.0f)*time - (0.5*airDrag*cos(bird.getAngle()*M_PI/180.0f)*time*time);
+		posy = bird.getVel()*sin(bird.getAngle()*M_PI/180.0f)*time - (0.5*(gravity+(airDrag*sin(bird.getAngle()*M_PI/180.0f)))*time*time);
+
+		initX = bird.initX;
+		initY = bird.initY;
+		write(vertex_data);
+	}
+
+	/* The same for a dot at x, y */
+	void streamAt (float x, float y, GLfloat* vertex_data)
+	{
+		posx = posy = 0;
+		initX = x;
+		initY = y;
+		write(vertex_data);
+	}
+
+	void write (GLfloat* vertex_data)
+	{
+		static const GLfloat quad [] = {
 			0,0,0, // vertex 1
 			0,0.03,0, // vertex 2
 			0.08,0.03,0, // vertex 3
@@ -2400,152 +2129,573 @@ class Point{
 			0.08,0,0, // vertex 4
 			0,0,0, // vertex 1
 		};
-
-		static const GLfloat color_buffer_data [] = {
-			1.0,0.325,0.28,	
-			1.0,0.325,0.28,	
-			1.0,0.325,0.28,	
-			1.0,0.325,0.28,	
-			1.0,0.325,0.28,	
-			1.0,0.325,0.28,	
-		};
-
-		// create3DObject creates and returns a handle to a VAO that can be used later
-		point = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
+		for (int i=0; i<6; i++) {
+			vertex_data [6*i] = quad[3*i] + initX + posx;
+			vertex_data [6*i + 1] = quad[3*i + 1] + initY + posy;
+			vertex_data [6*i + 2] = quad[3*i + 2];
+			vertex_data [6*i + 3] = 1.0;
+			vertex_data [6*i + 4] = 0.325;
+			vertex_data [6*i + 5] = 0.28;
+		}
 	}
-	void draw (float time)
-	{
-		// clear the color and depth in the frame buffer
-		//glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+};
 
-		/*glUseProgram (programID);
+#define PATH_DOTS 9
+#define WELL_SIDES 24	// of the disc of a planet
+#define FORCE_ARROWS 16	// per side of the lattice the force field is shown on
+
+/* The most vertices each stream is given in a frame, and all of them together */
+#define PATH_VERTICES (6*PATH_DOTS)
+#define SHOT_VERTICES (3*MAX_SHOTS)
+#define BLOCK_VERTICES (6*MAX_BLOCKS)
+#define DEBRIS_VERTICES (3*(FRACTURE_CORNERS - 2)*MAX_DEBRIS)
+#define WELL_VERTICES (3*MAX_WELLS + 3*WELL_SIDES*WELL_PLANETS)
+#define FORCE_VERTICES (3*FORCE_ARROWS*FORCE_ARROWS)
+#define SWARM_VERTICES (3*MAX_SWARM)
+#define STREAM_VERTICES (PATH_VERTICES + SHOT_VERTICES + BLOCK_VERTICES + DEBRIS_VERTICES + WELL_VERTICES + FORCE_VERTICES + SWARM_VERTICES)
+
+Point path[PATH_DOTS + 1];
+StreamBuffer *pathStream = NULL;
+StreamBuffer *shotStream = NULL;
+StreamBuffer *blockStream = NULL;
+StreamBuffer *debrisStream = NULL;
+StreamBuffer *wellStream = NULL;
+StreamBuffer *forceStream = NULL;
+StreamBuffer *swarmStream = NULL;
+
+/* The game, owned by the simulation side */
+Game game;
+
+/* Where the arrows of the force field stand, along either axis */
+float forceLattice(int i){
+	return GRID_MIN + (i + 0.5f)*(GRID_MAX - GRID_MIN)/FORCE_ARROWS;
+}
 
-		  glm::vec3 eye ( 5*cos(camera_rotation_angle*M_PI/180.0f), 0, 5*sin(camera_rotation_angle*M_PI/180.0f) );
-		  glm::vec3 target (0, 0, 0);
-		  glm::vec3 up (0, 1, 0);
-		 */
-		//	Matrices.view = glm::lookAt(glm::vec3(0,0,3), glm::vec3(0,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
+struct ShotState {
+	float x, y, prevx, prevy;
+};
 
-		Matrices.view = glm::lookAt(cameraPos,cameraPos+cameraFront,cameraUp);
-		glm::mat4 VP = Matrices.projection * Matrices.view;
-		glm::mat4 MVP;	// MVP = Projection * View * Model
-		Matrices.model = glm::mat4(1.0f);
+struct BlockState {
+	float x, y, prevx, prevy;
+	float angle, prevAngle;	// radians
+	float hx, hy;
+};
 
-		// Render your scene 
-		Matrices.model = glm::mat4(1.0f);
+struct AgentState {
+	float x, y, prevx, prevy;
+	float vx, vy;
+	int kind;
+};
 
-		time/=2;
+/* What the renderer reads of one simulation step and nothing else. Each slot reserves
+   room for the most there can be of everything, so taking a step allocates nothing */
+struct Snapshot {
+	double time;	// simulation time of this state
+	Bird bird;
+	Portal portal[2];
+	int level, targets, volleySize;
+	bool levelUp, over;
+	float deltaTime;
+	vector<RenderMesh> meshes;
+	vector<Transform> transforms;	// of the entity of each mesh
+	vector<ShotState> shots;
+	vector<BlockState> blocks;	// the moving ones
+	vector<Debris> debris;
+	vector<Well> wells;
+	vector<AgentState> agents;
+	float agentRadius[SWARM_KINDS];
+	bool forces;
+	float forceX[FORCE_ARROWS*FORCE_ARROWS], forceY[FORCE_ARROWS*FORCE_ARROWS];	// the field at the lattice
+	bool bentPath;		// the wells or the field pull the bird, the preview is flown
+	float pathX[PATH_DOTS], pathY[PATH_DOTS];
+
+	Snapshot(){
+		meshes.reserve(MAX_ENTITIES);
+		transforms.reserve(MAX_ENTITIES);
+		shots.reserve(MAX_SHOTS);
+		blocks.reserve(MAX_BLOCKS);
+		debris.reserve(MAX_DEBRIS);
+		wells.reserve(MAX_WELLS);
+		agents.reserve(MAX_SWARM);
+	}
+	void take(Game& game);
+};
 
-		posx = angryBird.getVel()*cos(angryBird.getAngle()*M_PI/180.0f)*time - (0.5*airDrag*cos(angryBird.getAngle()*M_PI/180.0f)*time*time);
-		posy = angryBird.getVel()*sin(angryBird.getAngle()*M_PI/180.0f)*time - (0.5*(gravity+(airDrag*sin(angryBird.getAngle()*M_PI/180.0f)))*time*time);
+void Snapshot::take(Game& game)
+{
+	int i, j;
+	bird = game.angryBird;
+	portal[0] = game.portal[0];
+	portal[1] = game.portal[1];
+	level = game.level;
+	targets = game.targets;
+	volleySize = game.volleySize;
+	levelUp = game.levelUp;
+	over = game.isOver();
+	deltaTime = game.deltaTime;
+	meshes.assign(game.meshes.data.begin(), game.meshes.data.end());
+	transforms.resize(meshes.size());
+	for(i=0;i<(int)meshes.size();i++)
+		transforms[i] = game.transforms.get(game.meshes.owner[i]);
+	shots.resize(game.shots.count);
+	for(i=0;i<game.shots.count;i++){
+		ShotState shot = { game.shots.x[i], game.shots.y[i], game.shotPrevx[i], game.shotPrevy[i] };
+		shots[i] = shot;
+	}
+	blocks.clear();
+	for(i=0;i<(int)game.blocks.bodies.size();i++){
+		RigidBody& b = game.blocks.bodies[i];
+		if(b.invMass == 0)
+			continue;
+		BlockState block = { b.x, b.y, b.prevx, b.prevy, b.angle, b.prevAngle, b.hx, b.hy };
+		blocks.push_back(block);
+	}
+	debris.assign(game.debris.pieces.begin(), game.debris.pieces.end());
+	wells.assign(game.wells.begin(), game.wells.end());
+	Flock& swarm = game.swarm;
+	agents.resize(swarm.count);
+	for(i=0;i<swarm.count;i++){
+		AgentState agent = { swarm.x[i], swarm.y[i], swarm.prevx[i], swarm.prevy[i], swarm.vx[i], swarm.vy[i], swarm.kind[i] };
+		agents[i] = agent;
+	}
+	for(i=0;i<SWARM_KINDS;i++)
+		agentRadius[i] = swarm.kinds[i].radius;
+	forces = !game.forces.empty();
+	if(forces)
+		for(j=0;j<FORCE_ARROWS;j++)
+			for(i=0;i<FORCE_ARROWS;i++)
+				game.forces.sample(forceLattice(i), forceLattice(j), forceX[FORCE_ARROWS*j + i], forceY[FORCE_ARROWS*j + i]);
+	bentPath = game.birdFeelsForces();
+	if(bentPath)
+		game.aimPath(0.5, PATH_DOTS, pathX, pathY);
+}
 
-		//glm::mat4 translateInit = glm::translate (glm::vec3(0, 0, 0));     
-		initX = angryBird.initX;
-		initY = angryBird.initY;
-		glm::mat4 translatePoint = glm::translate(glm::vec3((float)(initX + posx),(float)(initY + posy), 0.0f));        
-		Matrices.model *= (translatePoint);
-		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		draw3DObject(point);
+/* Lock-free triple buffer between the simulation and the renderer. The simulation fills
+   its slot and swaps it with the spare one; the renderer swaps its slot with the spare one
+   when a newer state is there. Both sides only do one atomic exchange, so neither ever
+   waits for the other, and the renderer always gets the newest complete state */
+#define SNAPSHOT_FRESH 4
+
+struct SnapshotBuffer {
+	Snapshot slots[3];
+	atomic<int> spare;	// index of the spare slot, plus SNAPSHOT_FRESH if it was not read yet
+	int writing;		// slot owned by the simulation
+	int reading;		// slot owned by the renderer
+
+	SnapshotBuffer(){
+		writing = 0;
+		spare = 1;
+		reading = 2;
+	}
+	Snapshot* writeSlot(){
+		return &slots[writing];
+	}
+	void publish(){
+		writing = spare.exchange(writing | SNAPSHOT_FRESH, memory_order_acq_rel) & 3;
+	}
+	Snapshot* acquire(){
+		if (spare.load(memory_order_relaxed) & SNAPSHOT_FRESH)
+			reading = spare.exchange(reading, memory_order_acq_rel) & 3;
+		return &slots[reading];
+	}
+} snapshots;
+
+/* State on screen, owned by the render thread. The input callbacks read it too */
+Snapshot *view = NULL;
+
+/* Input from the GLFW callbacks to the simulation, a lock-free single producer /
+   single consumer ring. The game state is only ever changed on the simulation side */
+enum InputType { INPUT_KEY, INPUT_AIM, INPUT_BUTTON, INPUT_NEXT };
+
+struct InputEvent {
+	int type;
+	int key;	// key or mouse button
+	int action;
+	double x;
+	double y;
+};
 
+#define INPUT_QUEUE_SIZE 256
+
+struct InputQueue {
+	InputEvent events[INPUT_QUEUE_SIZE];
+	atomic<int> head;	// next slot the callbacks write
+	atomic<int> tail;	// next slot the simulation reads
+
+	InputQueue(){
+		head = 0;
+		tail = 0;
+	}
+	bool push(const InputEvent& event){
+		int h = head.load(memory_order_relaxed);
+		int next = (h + 1) % INPUT_QUEUE_SIZE;
+		if (next == tail.load(memory_order_acquire))
+			return false;	// full, the event is dropped
+		events[h] = event;
+		head.store(next, memory_order_release);
+		return true;
+	}
+	bool pop(InputEvent& event){
+		int t = tail.load(memory_order_relaxed);
+		if (t == head.load(memory_order_acquire))
+			return false;
+		event = events[t];
+		tail.store((t + 1) % INPUT_QUEUE_SIZE, memory_order_release);
+		return true;
+	}
+} inputs;
+
+void sendInput (int type, int key, int action, double x=0, double y=0)
+{
+	InputEvent event = { type, key, action, x, y };
+	inputs.push(event);
+}
+
+/* Draw one entity of the game with its meshes */
+void drawEntity (Transform& transform, RenderMesh& mesh)
+{
+	switch (mesh.mesh) {
+		case MESH_STAR:
+			if(mesh.visible||twinkleOverride)
+				starMesh.draw(transform,mesh.variant);
+			break;
+		case MESH_TARGET:
+			targetMesh.draw(transform,mesh,0,0,0);
+			targetMesh.draw(transform,mesh,1,0,-10);
+			targetMesh.draw(transform,mesh,1,1,10);
+			targetMesh.draw(transform,mesh,2,0,-10);
+			targetMesh.draw(transform,mesh,2,1,10);
+			targetMesh.draw(transform,mesh,3,0,180);
+			break;
+		case MESH_OBSTACLE:
+			obstacleMesh.draw(transform,mesh,0);
+			obstacleMesh.draw(transform,mesh,1);
+			obstacleMesh.draw(transform,mesh,2);
+			break;
+		case MESH_LIGHT:
+			if(mesh.visible)
+				lightMesh.draw(transform);
+			break;
+		case MESH_VARYS:
+			varysMesh.draw(transform,0);
+			varysMesh.draw(transform,1);
+			break;
+		case MESH_COMET:
+			cometMesh.draw(transform,1);
+			cometMesh.draw(transform,0);
+			break;
 	}
-};
+}
 
-Point path[20];
+/* The entities with meshes of one kind; spawning and despawning reorder the packed
+   arrays, so the layering comes from the kinds and not from the array order */
+void drawLayer (Snapshot& snap, int kind)
+{
+	int i;
+	for(i=0;i<(int)snap.meshes.size();i++)
+		if(snap.meshes[i].mesh == kind)
+			drawEntity(snap.transforms[i], snap.meshes[i]);
+}
 
+/* Draw the triangles streamed into sb since the last call, in world space as seen by the
+   camera; the model is identity */
+void drawWorld(StreamBuffer* sb){
+	Matrices.view = glm::lookAt(cameraPos,cameraPos+cameraFront,cameraUp);
+	glm::mat4 MVP = Matrices.projection * Matrices.view;
+	setMVP(MVP);
+	drawStream(sb, GL_TRIANGLES);
+}
 
-void pauseGame(bool play){
+/* Trajectory preview: all the dots are streamed every frame and drawn with one call */
+void drawPath(){
 	int i;
-	if(!play){
-		angryBird.pause=true;
-		varys[0].pause=true;
-		comet.pause=true;
-		for(i=0;i<7;i++){
-			obstacle[i].pause=true;
-			target[i].pause=true;
-		}
-		for(i=0;i<2;i++)
-			light[i].pause=true;
-	}
-	else{
-		angryBird.pause=false;
-		varys[0].pause=false;
-		comet.pause=false;
-		for(i=0;i<7;i++){
-			obstacle[i].pause=false;
-			target[i].pause=false;
-		}
-		for(i=0;i<2;i++)
-			light[i].pause=false;
+	GLfloat* vertex_data = mapStream(pathStream, PATH_VERTICES);
+	if(vertex_data == NULL)
+		return;
+	if(view->bentPath)
+		for(i=1;i<=PATH_DOTS;i++)
+			path[i].streamAt(view->pathX[i-1], view->pathY[i-1], vertex_data + 36*(i-1));
+	else
+		for(i=1;i<=PATH_DOTS;i++)
+			path[i].stream(i, view->bird, vertex_data + 36*(i-1));
+
+	drawWorld(pathStream);
+}
+
+/* Split-bird and volley shots, a triangle each, streamed and drawn with one call however many there are */
+void drawShots(){
+	int i,k;
+	static const GLfloat triangle [] = {
+		0,2*SHOT_RADIUS,
+		-1.7f*SHOT_RADIUS,-SHOT_RADIUS,
+		1.7f*SHOT_RADIUS,-SHOT_RADIUS,
+	};
+	vector<ShotState>& shots = view->shots;
+	if(shots.empty())
+		return;
+	GLfloat* vertex_data = mapStream(shotStream, 3*shots.size());
+	if(vertex_data == NULL)
+		return;
+	for(i=0;i<(int)shots.size();i++){
+		float x = interpolate(shots[i].prevx, shots[i].x);
+		float y = interpolate(shots[i].prevy, shots[i].y);
+		for(k=0;k<3;k++){
+			GLfloat* v = vertex_data + 6*(3*i + k);
+			v[0] = x + triangle[2*k];
+			v[1] = y + triangle[2*k + 1];
+			v[2] = 0;
+			v[3] = 1.0;
+			v[4] = 0.85;
+			v[5] = 0.3;
+		}
+	}
+
+	drawWorld(shotStream);
+}
+
+/* The agents of the swarms, darts pointing the way they fly, streamed and drawn with one
+   call; gnats are grey, hornets yellow */
+void drawSwarm(){
+	int i,k;
+	vector<AgentState>& agents = view->agents;
+	if(agents.empty())
+		return;
+	GLfloat* vertex_data = mapStream(swarmStream, 3*agents.size());
+	if(vertex_data == NULL)
+		return;
+	for(i=0;i<(int)agents.size();i++){
+		AgentState& a = agents[i];
+		float x = interpolate(a.prevx, a.x);
+		float y = interpolate(a.prevy, a.y);
+		float speed = sqrt(a.vx*a.vx + a.vy*a.vy);
+		float r = view->agentRadius[a.kind];
+		float dx = speed > 0 ? r*a.vx/speed : r, dy = speed > 0 ? r*a.vy/speed : 0;
+		// Nose ahead, the tail corners behind and to the sides
+		GLfloat corners[6] = { x + 1.5f*dx, y + 1.5f*dy, x - dx - 0.7f*dy, y - dy + 0.7f*dx, x - dx + 0.7f*dy, y - dy - 0.7f*dx };
+		bool hornet = a.kind == SWARM_HORNETS;
+		for(k=0;k<3;k++){
+			vertex_data[0] = corners[2*k];
+			vertex_data[1] = corners[2*k + 1];
+			vertex_data[2] = 0;
+			vertex_data[3] = hornet ? 0.95 : 0.6;
+			vertex_data[4] = hornet ? 0.75 : 0.65;
+			vertex_data[5] = hornet ? 0.1 : 0.5;
+			vertex_data += 6;
+		}
+	}
+
+	drawWorld(swarmStream);
+}
+
+/* The blocks of the towers, two triangles each, streamed and drawn with one call; planks
+   are lighter than bricks */
+void drawBlocks(){
+	int i,k;
+	static const float corner [] = { -1,-1, 1,-1, 1,1, -1,-1, 1,1, -1,1 };
+	vector<BlockState>& blocks = view->blocks;
+	if(blocks.empty())
+		return;
+	GLfloat* vertex_data = mapStream(blockStream, 6*blocks.size());
+	if(vertex_data == NULL)
+		return;
+	for(i=0;i<(int)blocks.size();i++){
+		BlockState& b = blocks[i];
+		float x = interpolate(b.prevx, b.x);
+		float y = interpolate(b.prevy, b.y);
+		float angle = interpolate(b.prevAngle, b.angle);
+		float c = cos(angle), s = sin(angle);
+		bool plank = b.hx > BLOCK_WIDTH;
+		for(k=0;k<6;k++){
+			float px = corner[2*k]*b.hx, py = corner[2*k + 1]*b.hy;
+			vertex_data[0] = x + c*px - s*py;
+			vertex_data[1] = y + s*px + c*py;
+			vertex_data[2] = 0;
+			vertex_data[3] = plank ? 0.8 : 0.6;
+			vertex_data[4] = plank ? 0.6 : 0.35;
+			vertex_data[5] = plank ? 0.35 : 0.2;
+			vertex_data += 6;
+		}
+	}
+
+	drawWorld(blockStream);
+}
+
+/* Planets as discs and moons as triangles, streamed and drawn with one call */
+void drawWells(){
+	int i,k,n;
+	static GLfloat disc [2*(WELL_SIDES+1)];
+	vector<Well>& wells = view->wells;
+	if(wells.empty())
+		return;
+	if(disc[0] == 0)
+		for(k=0;k<=WELL_SIDES;k++){
+			disc[2*k] = cos(2*k*M_PI/WELL_SIDES);
+			disc[2*k + 1] = sin(2*k*M_PI/WELL_SIDES);
+		}
+	for(i=0,n=0;i<(int)wells.size();i++)
+		n += wells[i].planet < 0 ? 3*WELL_SIDES : 3;
+	GLfloat* vertex_data = mapStream(wellStream, n);
+	if(vertex_data == NULL)
+		return;
+	for(i=0;i<(int)wells.size();i++){
+		Well& well = wells[i];
+		float x = interpolate(well.prevx, well.x);
+		float y = interpolate(well.prevy, well.y);
+		bool planet = well.planet < 0;
+		for(k=0;k<(planet ? 3*WELL_SIDES : 3);k++){
+			// Fans of a disc, or every third corner of it for a moon
+			int corner = planet ? k/3 + k%3 - (k%3 ? 1 : 0) : k*WELL_SIDES/3;
+			bool centre = planet && k%3 == 0;
+			vertex_data[0] = centre ? x : x + well.radius*disc[2*corner];
+			vertex_data[1] = centre ? y : y + well.radius*disc[2*corner + 1];
+			vertex_data[2] = 0;
+			vertex_data[3] = planet ? 0.75 : 0.8;
+			vertex_data[4] = planet ? 0.45 : 0.8;
+			vertex_data[5] = planet ? 0.3 : 0.75;
+			vertex_data += 6;
+		}
+	}
+
+	drawWorld(wellStream);
+}
+
+#define FORCE_ARROW_SCALE 0.6
+
+/* The force field as small arrows on a lattice over the grid, each pointing along the
+   field and as long as it is strong; streamed and drawn with one call */
+void drawForces(){
+	int i,j;
+	if(!view->forces)
+		return;
+	GLfloat* vertex_data = mapStream(forceStream, FORCE_VERTICES);
+	if(vertex_data == NULL)
+		return;
+	for(j=0;j<FORCE_ARROWS;j++){
+		for(i=0;i<FORCE_ARROWS;i++){
+			float x = forceLattice(i), y = forceLattice(j);
+			// Tip ahead along the field, the base across it
+			float dx = FORCE_ARROW_SCALE*view->forceX[FORCE_ARROWS*j + i], dy = FORCE_ARROW_SCALE*view->forceY[FORCE_ARROWS*j + i];
+			GLfloat corners[6] = { x + dx, y + dy, x - dx/2 - dy/4, y - dy/2 + dx/4, x - dx/2 + dy/4, y - dy/2 - dx/4 };
+			for(int k=0;k<3;k++){
+				vertex_data[0] = corners[2*k];
+				vertex_data[1] = corners[2*k + 1];
+				vertex_data[2] = 0;
+				vertex_data[3] = 0.55;
+				vertex_data[4] = 0.75;
+				vertex_data[5] = 0.9;
+				vertex_data += 6;
+			}
+		}
 	}
+
+	drawWorld(forceStream);
+}
+
+/* Pieces of shattered obstacles, fans of their corners, streamed and drawn with one call;
+   the shades of the rock alternate from piece to piece */
+void drawDebris(){
+	int i,k,n;
+	vector<Debris>& debris = view->debris;
+	if(debris.empty())
+		return;
+	for(i=0,n=0;i<(int)debris.size();i++)
+		n += 3*(fracturePatterns[debris[i].pattern].pieces[debris[i].piece].corners - 2);
+	GLfloat* vertex_data = mapStream(debrisStream, n);
+	if(vertex_data == NULL)
+		return;
+	for(i=0;i<(int)debris.size();i++){
+		Debris& d = debris[i];
+		FracturePiece& piece = fracturePatterns[d.pattern].pieces[d.piece];
+		float x = interpolate(d.prevx, d.x);
+		float y = interpolate(d.prevy, d.y);
+		float angle = interpolate(d.prevAngle, d.angle)*M_PI/180;
+		float c = d.size*cos(angle), s = d.size*sin(angle);
+		float shade = d.piece%2 ? 0.5 : 0.35;
+		for(k=0;k<3*(piece.corners - 2);k++){
+			int corner = k%3 == 0 ? 0 : k/3 + k%3;
+			vertex_data[0] = x + c*piece.x[corner] - s*piece.y[corner];
+			vertex_data[1] = y + s*piece.x[corner] + c*piece.y[corner];
+			vertex_data[2] = 0;
+			vertex_data[3] = shade;
+			vertex_data[4] = shade;
+			vertex_data[5] = shade;
+			vertex_data += 6;
+		}
+	}
+
+	drawWorld(debrisStream);
 }
+
+
 /**************************
  * Customizable functions *
  **************************/
 GLfloat fov=89.8f;
-GLfloat deltaTime = 0.0f;
 GLfloat factor = 0.01f;
-GLfloat cameraSpeed = 3.0f * deltaTime;
-bool pressNext=false;
-bool goNext=false;
-bool on=true;
+GLfloat cameraSpeed = 0.0f;
 double bird_x=38.0f,bird_y=300.0f;
-void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
+/* Game keys, applied on the simulation side */
+void applyKey (int key, int action)
 {
-	// Function is called first on GLFW_PRESS.
-
-	if (action == GLFW_RELEASE && !angryBird.getStatus()&&!angryBird.pause) {
+	if (action == GLFW_RELEASE) {
 		switch (key) {
 			case GLFW_KEY_F:
-				angryBird.setVel(angryBird.getVel()+0.2); 
+				game.control(CONTROL_FASTER);
 				break;
 			case GLFW_KEY_S:
-				angryBird.setVel(angryBird.getVel()-0.2); 
+				game.control(CONTROL_SLOWER);
 				break;
 			case GLFW_KEY_B:
-				angryBird.setAngle(angryBird.getAngle()-5); 
+				game.control(CONTROL_AIM_DOWN);
 				break;
 			case GLFW_KEY_A:
-				angryBird.setAngle(angryBird.getAngle()+5); 
+				game.control(CONTROL_AIM_UP);
 				break;
 			case GLFW_KEY_SPACE:
-				angryBird.setStatus(!angryBird.getStatus()); 
+				game.control(CONTROL_LAUNCH);
 				break;
 			case GLFW_KEY_UP:
-				if(angryBird.initY < 3.5){
-					angryBird.initY += 0.2; 
-					bird_y-=10;
-				}
-				angryBird.center[1] = angryBird.initY;			
+				game.control(CONTROL_RAISE);
 				break;
 			case GLFW_KEY_DOWN:
-				if(angryBird.initY > -3.5){
-					angryBird.initY -= 0.2; 
-					bird_y+=10;
-				}
-				angryBird.center[1] = angryBird.initY;			
+				game.control(CONTROL_LOWER);
+				break;
+			case GLFW_KEY_G:
+				game.control(CONTROL_RESOLVE);
+				break;
+			case GLFW_KEY_V:
+				game.control(CONTROL_SPLIT);
 				break;
-
 			default:
 				break;
 		}
 	}
-	else if (action == GLFW_PRESS) {
-		cameraSpeed = 3.0f * deltaTime;
+	else if (action == GLFW_PRESS && key == GLFW_KEY_P)
+		game.togglePause();
+}
+
+/* Camera and view keys are handled right here, the game keys go to the simulation */
+void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+	// Function is called first on GLFW_PRESS.
+
+	sendInput(INPUT_KEY, key, action);
+	if (action == GLFW_PRESS) {
+		cameraSpeed = 3.0f * view->deltaTime;
 		switch (key) {
 			case GLFW_KEY_ESCAPE:
 				quit(window);
 				break;
 			case GLFW_KEY_LEFT:	
-				if(!angryBird.pause)
+				if(!view->bird.pause)
 					cameraPos += glm::normalize(glm::cross(cameraFront,cameraUp))*cameraSpeed*factor;
 				break;
 			case GLFW_KEY_RIGHT:
-				if(!angryBird.pause)
+				if(!view->bird.pause)
 					cameraPos -= glm::normalize(glm::cross(cameraFront,cameraUp))*cameraSpeed*factor;
 				break;
 			case GLFW_KEY_K:
-				if(!angryBird.pause){
+				if(!view->bird.pause){
 					if(fov<89)
 						fov=89;
 					if(fov>91)
@@ -2555,7 +2705,7 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
 				}
 				break;
 			case GLFW_KEY_M:
-				if(!angryBird.pause){
+				if(!view->bird.pause){
 					if(fov<89)
 						fov=89;
 					if(fov>91)
@@ -2564,12 +2714,8 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
 						fov+=0.1;
 				}
 				break;
-			case GLFW_KEY_P:
-				on=!on;
-				pauseGame(on);
-				break;
 			case GLFW_KEY_T:
-				if(!angryBird.pause)
+				if(!view->bird.pause)
 					twinkleOverride = !twinkleOverride; 
 				break;
 			default:
@@ -2584,8 +2730,8 @@ void keyboardChar (GLFWwindow* window, unsigned int key)
 	switch (key) {
 		case 'Q':
 		case 'q':
-			cout << "Your score: " << angryBird.getScore() << endl;
-			cout << "LEVEL: " << level << endl;
+			cout << "Your score: " << view->bird.getScore() << endl;
+			cout << "LEVEL: " << view->level << endl;
 			quit(window);
 			break;
 		default:
@@ -2596,51 +2742,64 @@ void keyboardChar (GLFWwindow* window, unsigned int key)
 /* Executed when a mouse button is pressed/released */
 double slope;
 double mouse_X,mouse_Y;
+void applyAim(double x,double y){
+	// The bird sits 10 pixels higher for every step it was raised
+	bird_y = 300 - 50*game.angryBird.initY;
+	slope = atan((y-bird_y)/(x-bird_x));
+	slope = (-1*slope*180.0/M_PI)+20;
+	game.aim(slope);
+}
 void mouse_callback(GLFWwindow* window,double x,double y){
-	if(!angryBird.pause){
-		//cout << y << endl;
-		slope = atan((y-bird_y)/(x-bird_x));
-		slope = (-1*slope*180.0/M_PI)+20;
-		if(pressNext)
-			angryBird.setAngle(slope);
-	}
-
+	sendInput(INPUT_AIM, 0, 0, x, y);
 	mouse_X = x;
 	mouse_Y = y;
 }
+void applyButton (int button, int action)
+{
+	if (button == GLFW_MOUSE_BUTTON_RIGHT)
+		game.grab(action == GLFW_PRESS);
+}
 void mouseButton (GLFWwindow* window, int button, int action, int mods)
 {
 	switch (button) {
 		case GLFW_MOUSE_BUTTON_LEFT:
 			if (action == GLFW_PRESS){
-				if(board.levelUp){
+				if(view->levelUp){
 					if(mouse_X>180&&mouse_X<270&&mouse_Y>250&&mouse_Y<340)
-						goNext = true;
+						sendInput(INPUT_NEXT, 0, 0);
 					if(mouse_X>330&&mouse_X<420&&mouse_Y>250&&mouse_Y<340){
-						cout << "Your score: " << angryBird.getScore() << endl;
-						cout << "LEVEL: " << level << endl;
+						cout << "Your score: " << view->bird.getScore() << endl;
+						cout << "LEVEL: " << view->level << endl;
 						quit(window);
 					}
 				}
 
 			}
 			break;
-			if (action == GLFW_RELEASE)
-				pressNext=false;
-			break;
 		case GLFW_MOUSE_BUTTON_RIGHT:
-			if (action == GLFW_PRESS) {
-				if(!angryBird.pause&&!angryBird.getStatus())
-					pressNext=true;
-			}
-			if (action == GLFW_RELEASE)
-				pressNext=false;
+			sendInput(INPUT_BUTTON, button, action);
 			break;
 		default:
 			break;
 	}
 }
 
+/* Run on the simulation side before each step */
+void applyInput ()
+{
+	InputEvent event;
+	while (inputs.pop(event)) {
+		if (event.type == INPUT_KEY)
+			applyKey(event.key, event.action);
+		else if (event.type == INPUT_AIM)
+			applyAim(event.x, event.y);
+		else if (event.type == INPUT_BUTTON)
+			applyButton(event.key, event.action);
+		else if (event.type == INPUT_NEXT)
+			game.accept();
+	}
+}
+
 
 
 void scroll(GLFWwindow* window,double x,double y){
@@ -2651,7 +2810,7 @@ void scroll(GLFWwindow* window,double x,double y){
 		fov=91;
 	if(fov>=89&&fov<=91)
 		fov-=y*0.1;
-	cameraSpeed = 3.0f * deltaTime;
+	cameraSpeed = 3.0f * view->deltaTime;
 	if(x==-1)
 		cameraPos -= glm::normalize(glm::cross(cameraFront,cameraUp))*cameraSpeed*factor;
 	if(x==1)
@@ -2668,12 +2827,14 @@ void reshapeWindow (GLFWwindow* window, int width, int height)
 	int fbwidth=width, fbheight=height;
 	/* With Retina display on Mac OS X, GLFW's FramebufferSize
 	   is different from WindowSize */
-	glfwGetFramebufferSize(window, &fbwidth, &fbheight);
+	if (window)
+		glfwGetFramebufferSize(window, &fbwidth, &fbheight);
 
 	//GLfloat fov = 90.0f;
 
 	// sets the viewport of openGL renderer
-	glViewport (0, 0, (GLsizei) fbwidth, (GLsizei) fbheight);
+	if (backend == BACKEND_GL)
+		glViewport (0, 0, (GLsizei) fbwidth, (GLsizei) fbheight);
 
 	// set the projection matrix as perspective
 	/*glMatrixMode (GL_PROJECTION);
@@ -2688,6 +2849,108 @@ void reshapeWindow (GLFWwindow* window, int width, int height)
 	//Matrices.projection = glm::ortho(-4.0f, 4.0f, -4.0f, 4.0f, 0.1f, 500.0f);
 }
 
+/* Headless OpenGL: an EGL context without any surface, rendering into a framebuffer object.
+   Works on machines without a display or GPU through Mesa's llvmpipe, and is never
+   throttled by vsync since nothing is ever presented */
+struct Offscreen {
+#ifndef __APPLE__
+	EGLDisplay display;
+	EGLContext context;
+#endif
+	GLuint FramebufferID;
+	GLuint ColorBuffer;
+	GLuint DepthBuffer;
+} offscreen;
+
+bool initHeadless (int width, int height)
+{
+#ifdef __APPLE__
+	fprintf(stderr, "Error: headless rendering needs EGL\n");
+	return false;
+#else
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+	offscreen.display = EGL_NO_DISPLAY;
+	if (getPlatformDisplay)
+		offscreen.display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (offscreen.display == EGL_NO_DISPLAY)
+		offscreen.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (offscreen.display == EGL_NO_DISPLAY || !eglInitialize(offscreen.display, NULL, NULL)) {
+		fprintf(stderr, "Error: no EGL display\n");
+		return false;
+	}
+
+	static const EGLint config_attribs[] = {
+		EGL_SURFACE_TYPE, 0,	// no window nor pbuffer needed
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	static const EGLint context_attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint numConfigs = 0;
+	eglBindAPI(EGL_OPENGL_API);
+	if (!eglChooseConfig(offscreen.display, config_attribs, &config, 1, &numConfigs) || numConfigs == 0) {
+		fprintf(stderr, "Error: no EGL config for OpenGL\n");
+		return false;
+	}
+	offscreen.context = eglCreateContext(offscreen.display, config, EGL_NO_CONTEXT, context_attribs);
+	if (offscreen.context == EGL_NO_CONTEXT || !eglMakeCurrent(offscreen.display, EGL_NO_SURFACE, EGL_NO_SURFACE, offscreen.context)) {
+		fprintf(stderr, "Error: cannot create a surfaceless OpenGL 3.3 context\n");
+		return false;
+	}
+	gladLoadGLLoader((GLADloadproc) eglGetProcAddress);
+
+	// The default framebuffer does not exist without a surface, render into our own
+	glGenFramebuffers(1, &offscreen.FramebufferID);
+	glGenRenderbuffers(1, &offscreen.ColorBuffer);
+	glGenRenderbuffers(1, &offscreen.DepthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, offscreen.ColorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, offscreen.DepthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindFramebuffer(GL_FRAMEBUFFER, offscreen.FramebufferID);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreen.ColorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, offscreen.DepthBuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		fprintf(stderr, "Error: offscreen framebuffer incomplete\n");
+		return false;
+	}
+	return true;
+#endif
+}
+
+void quitHeadless ()
+{
+#ifndef __APPLE__
+	eglMakeCurrent(offscreen.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(offscreen.display, offscreen.context);
+	eglTerminate(offscreen.display);
+#endif
+}
+
+/* Save the offscreen framebuffer as a PPM image */
+bool writeFramebufferPPM (const char* path, int width, int height)
+{
+	std::vector<unsigned char> pixels(3*width*height);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+
+	FILE* fp = fopen(path, "wb");
+	if (fp == NULL) {
+		fprintf(stderr, "Error: cannot write %s\n", path);
+		return false;
+	}
+	fprintf(fp, "P6\n%d %d\n255\n", width, height);
+	for (int y=height-1; y>=0; y--)	// GL rows start at the bottom
+		fwrite(&pixels[3*width*y], 1, 3*width, fp);
+	fclose(fp);
+	return true;
+}
+
 /* Initialise glfw window, I/O callbacks and the renderer to use */
 /* Nothing to Edit here */
 GLFWwindow* initGLFW (int width, int height)
@@ -2745,9 +3008,11 @@ GLFWwindow* initGLFW (int width, int height)
 
 /* Initialize the OpenGL rendering properties */
 /* Add all the models to be created here */
+/* Create the meshes and set up the renderer, once at startup.
+   The meshes do not depend on the level, the game places the objects */
 void initGL (GLFWwindow* window, int width, int height)
 {
-	int i =0,j=0;
+	int i =0;
 	/* Objects should be created before any other gl function and shaders */
 	// Create the models
 	//createTriangle (); // Generate the VAO, VBOs, vertices data & copy into the array buffer
@@ -2757,11 +3022,27 @@ void initGL (GLFWwindow* window, int width, int height)
 	border[1].create(2);
 	border[2].create(1);
 	border[3].create(3);
-	angryBird.createSaucer();
-	angryBird.create();
-	for(i=1;i<20;i++){
-		path[i].create();
-	}
+#ifdef USE_VULKAN
+	// The recorded layers point to the meshes just replaced
+	if(backend == BACKEND_VULKAN)
+		vulkan->invalidateStaticLayers();
+#endif
+	birdMesh.createSaucer(game.angryBird.getRadius());
+	birdMesh.create();
+	if(pathStream == NULL)
+		pathStream = createStreamBuffer(PATH_VERTICES);
+	if(shotStream == NULL)
+		shotStream = createStreamBuffer(SHOT_VERTICES);
+	if(blockStream == NULL)
+		blockStream = createStreamBuffer(BLOCK_VERTICES);
+	if(debrisStream == NULL)
+		debrisStream = createStreamBuffer(DEBRIS_VERTICES);
+	if(wellStream == NULL)
+		wellStream = createStreamBuffer(WELL_VERTICES);
+	if(forceStream == NULL)
+		forceStream = createStreamBuffer(FORCE_VERTICES);
+	if(swarmStream == NULL)
+		swarmStream = createStreamBuffer(SWARM_VERTICES);
 
 	board.createBoard();
 	board.createBrownBoard();
@@ -2772,122 +3053,24 @@ void initGL (GLFWwindow* window, int width, int height)
 	board.createTriangle();
 	board.createCross(0);
 	board.createCross(1);
-	for(j=0;j<7;j++){
-
-		target[j].setX((float)((float)(rand()%7) + (-3.2f)));
-		target[j].setY((float)((float)(rand()%7) + (-3.2f)));
-		target[j].setCenter(target[j].getX(),target[j].getY());
-		target[j].setRadius((float)((float)((rand()%20)+35)/100));
-		target[j].create();		
-		target[j].createEye(0,(target[j].getRadius()/2),target[j].getRadius()/4);
-		target[j].createEye(1,-1*(target[j].getRadius()/2),target[j].getRadius()/4);
-		target[j].createPupil(0,(target[j].getRadius()/2),target[j].getRadius()/8);
-		target[j].createPupil(1,-1*(target[j].getRadius()/2),target[j].getRadius()/8);
-		target[j].createMouth(0,(target[j].getRadius()/3));
-		target[j].dir=pow(-1,j%2);
-		//target[j].createTooth(0,(target[j].getRadius()/3));
-	}
-	for(j=0;j<7;j++){
-
-		obstacle[j].setX((float)((float)(rand()%7) + (-3.2f)));
-		obstacle[j].setY((float)((float)(rand()%7) + (-3.2f)));
-		obstacle[j].setCenter(obstacle[j].getX(),obstacle[j].getY());
-		obstacle[j].setRadius((float)((float)((rand()%20)+15)/100));
-		obstacle[j].createBig();		
-		obstacle[j].createSmall();		
-	}
-
-	for(j=0;j<39;j++){
-		if(j<3){
-			star[j].posx = -3.0;
-			star[j].posy = 2.6;
-			star[j].twinkle=1;
-		}
-		else if(j<6){
-			star[j].posx = -1.0;
-			star[j].posy = 1.1;
-			star[j].twinkle=0;
-		}
-		else if(j<9){
-			star[j].posx = 1.0;
-			star[j].posy = 2.75;
-			star[j].twinkle=1;
-		}
-		else if(j<12){
-			star[j].posx = 2.0;
-			star[j].posy = 1.75;
-			star[j].twinkle=0;
-		}
-		else if(j<15){
-			star[j].posx = 3.0;
-			star[j].posy = 2.25;
-			star[j].twinkle=1;
-		}
-		else if(j<18){
-			star[j].posx = 1.0;
-			star[j].posy = -2.75;
-			star[j].twinkle=0;
-		}
-		else if(j<21){
-			star[j].posx = -2.8;
-			star[j].posy = -3.1;
-			star[j].twinkle=1;
-		}
-		else if(j<24){
-			star[j].posx = 1.4;
-			star[j].posy = 2.5;
-			star[j].twinkle=1;
-		}
-		else if(j<27){
-			star[j].posx = 3.05;
-			star[j].posy = -2.15;
-			star[j].twinkle=0;
-		}
-		else if(j<30){
-			star[j].posx = -1.5;
-			star[j].posy = -0.5;
-			star[j].twinkle=1;
-		}
-		else if(j<33){
-			star[j].posx = 3.25;
-			star[j].posy = -3.15;
-			star[j].twinkle=1;
-		}
-		else if(j<36){
-			star[j].posx = -1.05;
-			star[j].posy = 3.35;
-			star[j].twinkle=0;
-		}
-		else if(j<39){
-			star[j].posx = -0.75;
-			star[j].posy = -2.15;
-			star[j].twinkle=1;
-		}
-		if(j%3==0){
-			star[j].createone(j);
-			//cout << j << " " << star[j].posx << " " << star[j].posy << " " << star[j].twinkle << endl;
-		}
-		if(j%3==1){
-			star[j].createtwo(j);
-		}
-		if(j%3==2){
-			star[j].createthree(j);
-		}
-	}
-
-	for(j=0;j<2;j++){
-		//light[j].posx = (((j)-15)*0.25) + 0.25;
-		//light[j].posy = 3.0 + pow(-1,(j)%2)*0.25;
-		light[j].posx = ((float)((float)(rand()%5) + (-2.5f)));
-		light[j].posy = ((float)((float)(rand()%5) + (-2.5f)));
-		light[j].radius = 0.05;
-		light[j].show = true;
-		light[j].create();
-	}
+	targetMesh.create();
+	targetMesh.createEye(0,0.5,0.25);
+	targetMesh.createEye(1,-0.5,0.25);
+	targetMesh.createPupil(0,0.5,0.125);
+	targetMesh.createPupil(1,-0.5,0.125);
+	targetMesh.createMouth(0,(1/3.0f));
+	obstacleMesh.createBig();
+	obstacleMesh.createSmall();
+
+	starMesh.createone(0);
+	starMesh.createtwo(1);
+	starMesh.createthree(2);
+
+	lightMesh.create(0.05);
 
 
-	varys[0].createBody();
-	varys[0].createLegs();
+	varysMesh.createBody(0.1);
+	varysMesh.createLegs();
 
 	heart[3].posx = 2.60;
 	heart[3].posy = 3.45;
@@ -2905,40 +3088,28 @@ void initGL (GLFWwindow* window, int width, int height)
 	sun.createSun(0);
 	sun.createSun(2);
 	sun.createRays();
-	comet.show = false;
-	comet.posy = rand()%5 - 2;
-	comet.center[1] = comet.posy;
-	comet.createTrain();
-	comet.create();
-	portal[0].posx = 2.8;
-	portal[0].posy = 1.5;
-	portal[0].create(0);
-	portal[1].posx = -2.0;
-	portal[1].posy = -2.8;
-	portal[1].create(0);
-	portal[2].posx = 2.8;
-	portal[2].posy = 1.5;
-	portal[2].create(1);
-	portal[3].posx = -2.0;
-	portal[3].posy = -2.8;
-	portal[3].create(1);
-
-	// Create and compile our GLSL program from the shaders
-	programID = LoadShaders( "Sample_GL.vert", "Sample_GL.frag" );
-	// Get a handle for our "MVP" uniform
-	Matrices.MatrixID = glGetUniformLocation(programID, "MVP");
+	cometMesh.createTrain();
+	cometMesh.create(COMET_RADIUS);
+	portalMesh.create(0,game.portal[0].radius);
+	portalMesh.create(1,game.portal[0].radius);
+
+	if (backend == BACKEND_GL) {
+		// Create and compile our GLSL program from the shaders
+		programID = LoadShaders( "Sample_GL.vert", "Sample_GL.frag" );
+		// Get a handle for our "MVP" uniform
+		Matrices.MatrixID = glGetUniformLocation(programID, "MVP");
+	}
 
 
 	reshapeWindow (window, width, height);
-	goNext=false;
-	pressNext=false;
-	board.levelUp=false;
 	// Background color of the scene
-	glClearColor (0.0f, 0.2f, 0.4f, 1.0f); // R, G, B, A
-	glClearDepth (1.0f);
+	setClearColor (0.0f, 0.2f, 0.4f);
+	if (backend == BACKEND_GL) {
+		glClearDepth (1.0f);
 
-	glEnable (GL_DEPTH_TEST);
-	glDepthFunc (GL_LEQUAL);
+		glEnable (GL_DEPTH_TEST);
+		glDepthFunc (GL_LEQUAL);
+	}
 
 	//cout << "VENDOR: " << glGetString(GL_VENDOR) << endl;
 	//cout << "RENDERER: " << glGetString(GL_RENDERER) << endl;
@@ -2946,164 +3117,241 @@ void initGL (GLFWwindow* window, int width, int height)
 	//cout << "GLSL: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << endl;
 }
 
-int num;
-
-void next_level(GLFWwindow* window, int width, int height){
-	int i;
-	goNext=false;
-	angryBird.setScore(angryBird.getScore() + angryBird.getLives()*50);
-	angryBird.reset();
-	angryBird.setStatus(false);
-	angryBird.setLives(3);
-	angryBird.hit=0;
-	level++;
-	initGL (window, width, height);
-	for(i=0;i<7;i++){
-		target[i].shrink=false;
-		target[i].scaleFactor=1;
-
-	}
-	counter1=0;
-	counter2=0;
-	num = rand()%400 + 200;
-	pauseGame(true);
-	board.levelUp=false;
-	goNext=false;
+/* Without a window the clock is virtual: every frame lasts 1/60 s, so runs are reproducible */
+atomic<double> frameClock(0);
+double getTime(GLFWwindow* window){
+	if(window)
+		return glfwGetTime();
+	return frameClock;
+}
 
+/* Copy what the renderer reads and hand it over */
+void publishSnapshot (double time)
+{
+	Snapshot *snap = snapshots.writeSlot();
+	snap->time = time;
+	snap->take(game);
+	snapshots.publish();
 }
 
-void new_game(GLFWwindow* window, int width, int height){
-	int i;
-	goNext=false;
-	angryBird.setScore(0);
-	angryBird.reset();
-	angryBird.setStatus(false);
-	angryBird.setLives(3);
-	angryBird.hit=0;
-	level=1;
-	initGL (window, width, height);
-	for(i=0;i<7;i++){
-		target[i].shrink=false;
-		target[i].scaleFactor=1;
+/* Run the steps due at time now and publish the result. simTime is the time the simulation has reached */
+void advanceSimulation (double now, double& simTime)
+{
+	bool stepped = false;
+	if(now - simTime > MAX_FRAME_TIME)
+		simTime = now - MAX_FRAME_TIME;
+	while(simTime + SIM_DT <= now){
+		applyInput();
+		game.step();
+		simTime += SIM_DT;
+		stepped = true;
+	}
+	if(stepped)
+		publishSnapshot(simTime);
+}
 
+/* Body of the simulation thread: steps on time and sleeps in between, never waiting for the renderer */
+void simulationLoop (GLFWwindow* window, double simTime)
+{
+	while(simRunning){
+		double now = getTime(window);
+		if(simTime + SIM_DT > now){
+			this_thread::sleep_for(chrono::duration<double>(min(simTime + SIM_DT - now, 0.001)));
+			continue;
+		}
+		advanceSimulation(now, simTime);
 	}
-	counter1=0;
-	counter2=0;
-	num = rand()%400 + 200;
-	pauseGame(true);
-	board.levelUp=false;
-	goNext=false;
-
 }
 
 int main (int argc, char** argv)
 {
 	int width = 600;
 	int height = 600;
-	int i,j,k;
+	int i;
+	int frame = 0,maxFrames = 600,threads = thread::hardware_concurrency();
+	bool headless = false;
+	bool simThreaded = false;
+	const char *dumpPath = NULL;
 	stringstream ss1,ss2;
 	string convStr1,convStr2,concatStr;
-	num = rand()%400 + 200;
-	//cout << num << endl;
-	GLFWwindow* window = initGLFW(width, height);
+
+	/* --soft: render on the CPU into memory, without a window or OpenGL
+	   --null: run the game without rendering anything, only count the draw calls
+	   --headless: OpenGL through a surfaceless EGL context, without a window
+	   --vulkan: render with Vulkan into an offscreen image, without a window (make vulkan)
+	   --sim-thread: simulate on a second thread without a window too (always done with a window)
+	   --threads N: threads of the software rasterizer and of the simulation
+	   --frames N: number of frames to run without a window
+	   --dump FILE: write the last frame to FILE as a PPM image
+	   --flight euler|rk4|fixed: integrate the flight of the bird instead of the closed form,
+	   or keep to the closed form in fixed point, the same on every build; fixed plays
+	   without the float simulations: volleys, blocks, shattering, wells, wind, swarms, chasers
+	   --substeps N: integration steps per simulation step
+	   --volley N: the bird splits into N shots on V, without a window as soon as it flies
+	   --blocks N: build the levels with towers of N blocks
+	   --shatter: obstacles break into pieces when they are hit
+	   --wells N: N planets and moons pull the shots, the debris and an integrated bird
+	   --wind N: wind, vortices and an updraft on a field of N by N cells push them too
+	   --swarm N: N gnats and hornets swarm the level and chase the bird
+	   --chasers N: N spiders like Varys find their way to the bird around the obstacles */
+	for(i=1;i<argc;i++){
+		if(!strcmp(argv[i],"--soft"))
+			backend = BACKEND_SOFT;
+		else if(!strcmp(argv[i],"--null"))
+			backend = BACKEND_NULL;
+		else if(!strcmp(argv[i],"--headless"))
+			headless = true;
+		else if(!strcmp(argv[i],"--vulkan")){
+#ifdef USE_VULKAN
+			backend = BACKEND_VULKAN;
+#else
+			cerr << "Vulkan support not compiled in, build with make vulkan" << endl;
+			exit(EXIT_FAILURE);
+#endif
+		}
+		else if(!strcmp(argv[i],"--sim-thread"))
+			simThreaded = true;
+		else if(!strcmp(argv[i],"--threads") && i+1<argc)
+			threads = atoi(argv[++i]);
+		else if(!strcmp(argv[i],"--frames") && i+1<argc)
+			maxFrames = atoi(argv[++i]);
+		else if(!strcmp(argv[i],"--dump") && i+1<argc)
+			dumpPath = argv[++i];
+		else if(!strcmp(argv[i],"--flight") && i+1<argc){
+			i++;
+			flight.model = !strcmp(argv[i],"rk4") ? FLIGHT_RK4 : !strcmp(argv[i],"euler") ? FLIGHT_EULER : !strcmp(argv[i],"fixed") ? FLIGHT_FIXED : FLIGHT_PARABOLA;
+		}
+		else if(!strcmp(argv[i],"--substeps") && i+1<argc)
+			flight.substeps = atoi(argv[++i]);
+		else if(!strcmp(argv[i],"--volley") && i+1<argc)
+			game.volleySize = min(max(atoi(argv[++i]), 0), MAX_SHOTS);
+		else if(!strcmp(argv[i],"--blocks") && i+1<argc)
+			game.towerBlocks = min(max(atoi(argv[++i]), 0), MAX_BLOCKS);
+		else if(!strcmp(argv[i],"--shatter"))
+			game.shatter = true;
+		else if(!strcmp(argv[i],"--wells") && i+1<argc)
+			game.wellCount = min(max(atoi(argv[++i]), 0), MAX_WELLS);
+		else if(!strcmp(argv[i],"--wind") && i+1<argc)
+			game.forceCells = min(max(atoi(argv[++i]), 0), MAX_FORCE_CELLS);
+		else if(!strcmp(argv[i],"--swarm") && i+1<argc)
+			game.swarmSize = min(max(atoi(argv[++i]), 0), MAX_SWARM);
+		else if(!strcmp(argv[i],"--chasers") && i+1<argc)
+			game.chaserCount = min(max(atoi(argv[++i]), 0), MAX_CHASERS);
+	}
+	if(flight.model == FLIGHT_FIXED && (game.volleySize || game.towerBlocks || game.shatter || game.wellCount || game.forceCells || game.swarmSize || game.chaserCount))
+		cerr << "--flight fixed plays without volleys, blocks, shattering, wells, wind, swarms and chasers" << endl;
+	game.workers = new WorkerPool(max(threads, 1));
+
+	GLFWwindow* window = NULL;
+	if(backend == BACKEND_GL && headless){
+		if(!initHeadless(width, height))
+			exit(EXIT_FAILURE);
+	}
+	else if(backend == BACKEND_GL)
+		window = initGLFW(width, height);
+	else if(backend == BACKEND_SOFT)
+		softRaster = new SoftRasterizer(width, height, max(threads, 1));
+#ifdef USE_VULKAN
+	else if(backend == BACKEND_VULKAN){
+		vulkan = new VulkanRenderer();
+		if(!vulkan->init(width, height, STREAM_VERTICES))
+			exit(EXIT_FAILURE);
+	}
+#endif
 	initGL (window, width, height);
-	bool blink = true;
-	double last_update_time = glfwGetTime(), current_time;
-	double last_blink_time = glfwGetTime(), current_blink_time;
+	game.start();
+	chrono::steady_clock::time_point run_start = chrono::steady_clock::now();
+	double simTime = getTime(window);
+	publishSnapshot(simTime);
+	view = snapshots.acquire();
+
+	/* With a window the simulation gets its own thread. Without one it is stepped from
+	   the frame loop by default, which keeps runs on the virtual clock reproducible */
+	if(window)
+		simThreaded = true;
+	if(simThreaded){
+		simRunning = true;
+		simThread = thread(simulationLoop, window, simTime);
+	}
 
 	/* Draw in loop */
-	while (!glfwWindowShouldClose(window)) {
+	while (window ? !glfwWindowShouldClose(window) : frame < maxFrames) {
 		// OpenGL Draw commands
 		reshapeWindow (window, width, height);
-		ss1.str("");	
-		ss2.str("");	
-		ss1 << angryBird.getScore();
-		ss2 << level;
-		convStr1 = ss1.str();	
-		convStr2 = ss2.str();	
-		concatStr = "Angry Birds: Star Wars Edition!!!\t\t\t Level: " +  convStr2 + "\t\tScore: " + convStr1;
-		const char *gameTitle = concatStr.c_str();
-		glfwSetWindowTitle(window,gameTitle);
+		if(window){
+			ss1.str("");	
+			ss2.str("");	
+			ss1 << view->bird.getScore();
+			ss2 << view->level;
+			convStr1 = ss1.str();	
+			convStr2 = ss2.str();	
+			concatStr = "Angry Birds: Star Wars Edition!!!\t\t\t Level: " +  convStr2 + "\t\tScore: " + convStr1;
+			const char *gameTitle = concatStr.c_str();
+			glfwSetWindowTitle(window,gameTitle);
+		}
+		else{
+			// Nobody at the controls: shoot as soon as the bird is ready, split it and accept the next level
+			if(!view->bird.getStatus()&&!view->bird.pause)
+				sendInput(INPUT_KEY, GLFW_KEY_SPACE, GLFW_RELEASE);
+			else if(view->volleySize&&!view->bird.split)
+				sendInput(INPUT_KEY, GLFW_KEY_V, GLFW_RELEASE);
+			if(view->levelUp)
+				sendInput(INPUT_NEXT, 0, 0);
+		}
+
+		// Draw the newest state, between its previous and current step
+		double current_time = getTime(window); // Time in seconds
+		if(!simThreaded)
+			advanceSimulation(current_time, simTime);
+		view = snapshots.acquire();
+		renderAlpha = min(max((current_time - view->time)/SIM_DT, 0.0), 1.0);
+		if(view->over)
+			setClearColor (0.34f, 0.34f, 0.34f);
+		else
+			setClearColor (0.0f, 0.2f, 0.4f);
+
 		bg.draw();
 		sun.draw(0);
-		if(!angryBird.immune)
+		if(!view->bird.immune)
 			sun.draw(1);
-		if(angryBird.immune)
+		if(view->bird.immune)
 			sun.draw(2);
-		border[0].draw(0);
-		border[1].draw(2);
-		border[2].draw(1);
-		border[3].draw(3);
+		if(beginStaticLayer(0, Matrices.projection*glm::lookAt(cameraPos,cameraPos+cameraFront,cameraUp))){
+			border[0].draw(0);
+			border[1].draw(2);
+			border[2].draw(1);
+			border[3].draw(3);
+			endStaticLayer();
+		}
 		//for(i=0;i<5;i++){
-		portal[0].draw(0,0);
-		portal[1].draw(0,0);
+		portalMesh.draw(view->portal[0],0,0);
+		portalMesh.draw(view->portal[1],0,0);
 		//}
-		if(!angryBird.allowed){
-			portal[2].draw(1,0);
-			portal[3].draw(1,0);
-		}
-		angryBird.draw(1);
-		angryBird.draw(0);
-		if(!angryBird.floor){
-			for(i=1;i<10;i++){
-				path[i].draw(i);
-			}
-		}
-
-		for(i=0;i<39;i++){
-			if(star[i].twinkle||twinkleOverride)
-				star[i].draw(i);
-		}
-
-		for(i=0;i<7;i++){
-			target[i].draw(0,0,0);
-			target[i].draw(1,0,-10);
-			target[i].draw(1,1,10);
-			target[i].draw(2,0,-10);
-			target[i].draw(2,1,10);
-			target[i].draw(3,0,180);
-		}
-		for(i=0;i<7;i++){
-			obstacle[i].draw(0);
-			obstacle[i].draw(1);
-			obstacle[i].draw(2);
-
-		}
-		for(i=0;i<2;i++){
-			if(light[i].show)
-				light[i].draw();
-		}
-		varys[0].turn();	
-		varys[0].draw(0);
-		varys[0].draw(1);
-
-		for(i=0;i<angryBird.getLives();i++){
+		if(!view->bird.allowed){
+			portalMesh.draw(view->portal[0],1,0);
+			portalMesh.draw(view->portal[1],1,0);
+		}
+		birdMesh.draw(view->bird,1);
+		birdMesh.draw(view->bird,0);
+		drawForces();
+		drawWells();
+		drawBlocks();
+		drawDebris();
+		drawSwarm();
+		drawShots();
+		if(!view->bird.floor)
+			drawPath();
+
+		for(i=MESH_STAR;i<MESH_COMET;i++)
+			drawLayer(*view, i);
+
+		for(i=0;i<view->bird.getLives();i++){
 			heart[i].draw(0);
 			heart[i].draw(1);
 			heart[i].draw(2);
 		}
-		if(comet.show){
-			comet.draw(1);
-			comet.draw(0);
-			angryBird.checkComet();
-		}
-		comet.stop();
-		if(angryBird.getStatus()){
-			angryBird.checkWall();
-			angryBird.checkFloor();
-			for(i=0;i<7;i++)
-				angryBird.checkCollision(i);
-			for(i=0;i<7;i++)
-				angryBird.checkObstacle(i);
-			for(i=0;i<2;i++)
-				angryBird.checkLight(i);
-			angryBird.checkVarys();
-			angryBird.checkRoof();
-			angryBird.checkPortal();
-		}
-		if(angryBird.getLives() <= 0){
-			pauseGame(false);
-			board.levelUp=true;
+		drawLayer(*view, MESH_COMET);
+		if(view->bird.getLives() <= 0){
 			board.draw(-1);
 			board.draw(0);
 			board.draw(6);
@@ -3112,16 +3360,9 @@ int main (int argc, char** argv)
 			board.draw(2);
 			board.draw(5);
 			board.draw(4);
-			glClearColor (0.34f, 0.34f, 0.34f, 1.0f); // R, G, B, A
-			if(goNext&&board.levelUp){
-				goNext=false;
-				new_game(window, width, height);
-			}	
 			//quit(window);
 		}
-		if(angryBird.hit == 7){
-			pauseGame(false);
-			board.levelUp=true;
+		if(view->bird.hit == view->targets){
 			board.draw(-1);
 			board.draw(0);
 			board.draw(6);
@@ -3130,49 +3371,84 @@ int main (int argc, char** argv)
 			board.draw(2);
 			board.draw(3);
 			board.draw(4);
-			glClearColor (0.34f, 0.34f, 0.34f, 1.0f); // R, G, B, A
-			if(goNext&&board.levelUp){
-				goNext=false;
-				next_level(window, width, height);
-			}
 		}
-		// Swap Frame Buffer in double buffering
-		glfwSwapBuffers(window);
+		endStreamFrame(pathStream);
+		endStreamFrame(shotStream);
+		endStreamFrame(blockStream);
+		endStreamFrame(debrisStream);
+		endStreamFrame(wellStream);
+		endStreamFrame(forceStream);
+		endStreamFrame(swarmStream);
 
-		// Poll for Keyboard and mouse events
-		glfwPollEvents();
+		if(window){
+			// Swap Frame Buffer in double buffering
+			glfwSwapBuffers(window);
 
-		// Control based on time (Time based transformation like 5 degrees rotation every 0.5s)
-		current_time = glfwGetTime(); // Time in seconds
-		if ((current_time - last_update_time) >= 0.025) { // atleast 0.5s elapsed since last frame
-			// do something every 0.5 seconds ..
-			deltaTime+=0.025;
-			if(!angryBird.pause){
-				counter++;
-				counter1++;
-			}
-			if(angryBird.getStatus()&&!angryBird.pause)
-				t+=0.025;
-			last_update_time = current_time;
-			if(counter%10==0&&!angryBird.pause){
-				for(k=0;k<39;k++)
-					star[k].twinkle=!star[k].twinkle;
-			}
-			if(counter1 == num){
-				comet.show=true;
-				comet.posx = 5;
-				comet.center[0] = comet.posx;
-			}
-			if(angryBird.immune&&!angryBird.pause){
-				counter2++;
-				if(counter2 == 250){
-					counter2 = 0;
-					angryBird.immune = false;
-				}
+			// Poll for Keyboard and mouse events
+			glfwPollEvents();
+		}
+		else{
+			if(backend == BACKEND_SOFT)
+				softRaster->flush();
+			else if(backend == BACKEND_GL)
+				glFlush();
+#ifdef USE_VULKAN
+			else if(backend == BACKEND_VULKAN)
+				vulkan->endFrame(frame+1 == maxFrames && dumpPath);
+#endif
+			frame++;
+			frameClock = frameClock + 1.0/60;
+			if(frame == maxFrames && dumpPath){
+				if(backend == BACKEND_SOFT)
+					softRaster->writePPM(dumpPath);
+#ifdef USE_VULKAN
+				else if(backend == BACKEND_VULKAN)
+					vulkan->writePPM(dumpPath);
+#endif
+				else if(backend == BACKEND_GL)
+					writeFramebufferPPM(dumpPath, width, height);
 			}
 		}
 	}
 
-	glfwTerminate();
+	stopSimulation();
+	if(!window){
+		if(backend == BACKEND_GL)
+			glFinish();
+		double elapsed = chrono::duration<double>(chrono::steady_clock::now() - run_start).count();
+		cout << "Frames: " << frame << "\tTime: " << elapsed*1000 << " ms\t(" << elapsed*1000/max(frame,1) << " ms/frame)" << endl;
+		if(backend == BACKEND_NULL){
+			cout << "Meshes: " << drawStats.meshes << "\tDraw calls: " << drawStats.draws << " (" << drawStats.draws/max(frame,1) << "/frame)";
+			cout << "\tVertices: " << drawStats.vertices << " (" << drawStats.vertices/max(frame,1) << "/frame)" << endl;
+		}
+#ifdef USE_VULKAN
+		if(backend == BACKEND_VULKAN)
+			cout << "Draws recorded: " << vulkan->draws << " (" << vulkan->draws/max(frame,1) << "/frame)\tStatic layers replayed: " << vulkan->replayedLayers << endl;
+#endif
+		cout << "Your score: " << game.getScore() << endl;
+		cout << "LEVEL: " << game.getLevel() << endl;
+		if(flight.model == FLIGHT_FIXED)
+			cout << "State hash: " << hex << game.tickHash << dec << endl;
+		if(game.wellCount)
+			cout << "Wells: " << game.wells.size() << endl;
+		if(game.forceCells)
+			cout << "Force field: " << game.forceCells << "x" << game.forceCells << " cells" << endl;
+		if(game.swarmSize)
+			cout << "Swarm: " << game.swarm.count << " of " << game.swarmSize << " alive" << endl;
+		if(game.chaserCount)
+			cout << "Chasers: " << game.chaserCount << "\tFlow field searches: " << game.flow.searches << " (" << game.flow.repairs << " repaired)" << endl;
+		if(game.towerBlocks)
+			cout << "Blocks awake: " << game.blocks.awakeBodies() << "\tIslands awake: " << game.blocks.islandsAwake << "/" << game.blocks.islands << endl;
+	}
+
+	if(window)
+		glfwTerminate();
+	else if(backend == BACKEND_GL)
+		quitHeadless();
+	delete softRaster;
+	delete game.workers;
+#ifdef USE_VULKAN
+	delete vulkan;
+#endif
 	exit(EXIT_SUCCESS);
 }
@@ -0,0 +1,23 @@
+#version 450
+
+// input data : sent from main program
+layout (location = 0) in vec3 vertexPosition;
+layout (location = 1) in vec3 vertexColor;
+
+// MVP matrix, pushed with every draw
+layout (push_constant) uniform Transform {
+    mat4 MVP;
+} transform;
+
+// output data : used by fragment shader
+layout (location = 0) out vec3 fragColor;
+
+void main ()
+{
+    fragColor = vertexColor;
+    gl_Position = transform.MVP * vec4(vertexPosition, 1);
+
+    // The matrices are built for OpenGL: Vulkan's y axis points down and its depth range is [0,1]
+    gl_Position.y = -gl_Position.y;
+    gl_Position.z = (gl_Position.z + gl_Position.w) / 2.0;
+}
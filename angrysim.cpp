@@ -0,0 +1,2136 @@
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include "angrysim.h"
+
+using namespace std;
+
+float gravity = 0.6,airDrag = 0.005,friction = 0.1,groundDrag = 0.5;
+// The integrated flight pulls with the same gravity and drag as the closed form
+FlightParams flight = { FLIGHT_PARABOLA, gravity, airDrag, 4 };
+
+/* Share of the speed across a border or an obstacle a bounce keeps */
+#define RESTITUTION 0.8
+
+/* Where the centre of the bird is from where its trajectory starts */
+#define BIRD_OFFSET (0.17/3)
+
+static bool integrated(){
+	return flight.model == FLIGHT_EULER || flight.model == FLIGHT_RK4;
+}
+
+/* Towers, wells, wind, swarms, chasers, volleys and debris are simulated in floats, which
+   do not give the same bits on every build; the fixed point flight plays without them */
+static bool floatWorld(){
+	return flight.model != FLIGHT_FIXED;
+}
+
+void Bird::reset(){
+	initX = -3.5;
+	initY = 0;
+	posx = 0;
+	posy = 0;
+	t=0;
+	allowed=true;
+	center[0] = 0.05 + initX;
+	center[1] = 0 + initY;
+	theta = 45;
+	vel = 1.2;
+	velocity = vec2(0, 0);
+	lives--;
+	isMoving = !isMoving;
+	floor = false;
+	immune = false;
+	immuneCount=0;
+	flag = true;
+	dir = 1;
+}
+
+/* One simulation step, t has already been advanced */
+void Bird::update(){
+	if(!pause)
+		rotation+=1.5;
+	if(flight.model == FLIGHT_FIXED){
+		updateFixed();
+		return;
+	}
+	if(floor&&!pause){
+		if(flag){
+			vel = vel - groundDrag*t;
+			posx = posx + dir*(vel*t - 0.5*groundDrag*t*t);
+			center[0] = initX + posx + (0.17/3);
+		}
+		if(vel <= 0 || center[0] > 3.25 || center[0] < -3.75){
+			flag = false;
+			//floor = false;
+			reset();
+		}
+	}
+	else if(isMoving&&!pause&&integrated()){
+		if(t>3)
+			allowed=true;
+		advanceProjectiles(&center[0], &center[1], &velocity.x, &velocity.y, 1, SIM_DT, flight);
+		moveTo(center[0], center[1]);
+	}
+	else if(isMoving&&!pause)
+		flyTo(t);
+}
+
+/* Off it goes at vel along theta */
+void Bird::launch(){
+	isMoving = true;
+	split = false;
+	velocity = vec2(vel*cos(theta*M_PI/180.0f), vel*sin(theta*M_PI/180.0f));
+	// Where the fixed point flight starts, the aim is rounded to it
+	fixedFlight.initX = toFixed(initX);
+	fixedFlight.initY = toFixed(initY);
+	fixedFlight.posx = fixedFlight.posy = 0;
+	fixedFlight.vel = toFixed(vel);
+	fixedFlight.theta = toFixed(theta);
+	fixedFlight.t = 0;
+	if(flight.model == FLIGHT_FIXED)
+		syncFixed();
+}
+
+/* FLIGHT_FIXED: the floats follow the fixed point state, converting is exact both ways */
+void Bird::syncFixed(){
+	initX = fromFixed(fixedFlight.initX);
+	initY = fromFixed(fixedFlight.initY);
+	posx = fromFixed(fixedFlight.posx);
+	posy = fromFixed(fixedFlight.posy);
+	vel = fromFixed(fixedFlight.vel);
+	theta = fromFixed(fixedFlight.theta);
+	t = fromFixed(fixedFlight.t);
+	center[0] = fromFixed(fixedFlight.initX + fixedFlight.posx + toFixed(BIRD_OFFSET));
+	center[1] = fromFixed(fixedFlight.initY + fixedFlight.posy);
+}
+
+/* update() in fixed point */
+void Bird::updateFixed(){
+	FixedFlight& f = fixedFlight;
+	fixed drag = toFixed(airDrag), g = toFixed(gravity);
+	if(floor&&!pause){
+		if(flag){
+			fixed ground = toFixed(groundDrag);
+			f.vel -= fixedMul(ground, f.t);
+			f.posx += dir*(fixedMul(f.vel, f.t) - fixedMul(fixedMul(ground/2, f.t), f.t));
+			syncFixed();
+		}
+		fixed x = f.initX + f.posx + toFixed(BIRD_OFFSET);
+		if(f.vel <= 0 || x > toFixed(3.25) || x < toFixed(-3.75)){
+			flag = false;
+			reset();
+		}
+	}
+	else if(isMoving&&!pause){
+		if(f.t > 3*FIXED_ONE)
+			allowed=true;
+		fixed c = fixedCos(f.theta), s = fixedSin(f.theta);
+		f.posx = fixedMul(fixedMul(f.vel, c), f.t) - fixedMul(fixedMul(drag/2, f.t), f.t);
+		f.posy = fixedMul(fixedMul(f.vel, s), f.t) - fixedMul(fixedMul((g + fixedMul(drag, s))/2, f.t), f.t);
+		syncFixed();
+	}
+}
+
+/* The speed a bounce leaves in fixed point, the same as the float bounces work it out, and
+   atan(sin/(alpha*cos)) of the angle, which they take from atan() in radians and use as
+   degrees; so does this. With anchor the trajectory starts again where the bird is. */
+fixed Bird::reboundFixed(bool anchor){
+	FixedFlight& f = fixedFlight;
+	fixed alpha = toFixed(RESTITUTION), c = fixedCos(f.theta), s = fixedSin(f.theta);
+	fixed vx = fixedMul(alpha, fixedMul(f.vel, c)), vy = fixedMul(f.vel, s);
+	if(anchor){
+		f.initX += f.posx;
+		f.initY += f.posy;
+		f.posx = f.posy = 0;
+	}
+	f.vel = fixedSqrt(fixedMul(vx, vx) + fixedMul(vy, vy));
+	return fixedMul(fixedAtan(s, fixedMul(alpha, c)), toFixed(M_PI/180));
+}
+
+/* Where the trajectory has the bird at the given time since its start */
+void Bird::flyTo(float time){
+	t = time;
+	if(t>3)
+		allowed=true;
+	posx = vel*cos(theta*M_PI/180.0f)*t - 0.5*airDrag*t*t;
+	posy = vel*sin(theta*M_PI/180.0f)*t - (0.5*(gravity+(airDrag*sin(theta*M_PI/180.0f)))*t*t);
+	center[0] = initX + posx + (0.17/3);
+	center[1] = initY + posy;
+}
+
+/* Velocity of the centre now and its acceleration, which is the same all along the trajectory */
+void Bird::motion(float& vx, float& vy, float& ax, float& ay){
+	ax = -airDrag;
+	ay = -(gravity+(airDrag*sin(theta*M_PI/180.0f)));
+	vx = vel*cos(theta*M_PI/180.0f) + ax*t;
+	vy = vel*sin(theta*M_PI/180.0f) + ay*t;
+}
+
+/* Put the centre at x, y on the current trajectory, as if it had been flown there */
+void Bird::moveTo(float x, float y){
+	posx = x - initX - (0.17/3);
+	posy = y - initY;
+	center[0] = x;
+	center[1] = y;
+}
+
+bool Bird::touches(float cx, float cy, float r){
+	if(flight.model == FLIGHT_FIXED){
+		long long dx = fixedFlight.initX + fixedFlight.posx + toFixed(BIRD_OFFSET) - toFixed(cx);
+		long long dy = fixedFlight.initY + fixedFlight.posy - toFixed(cy);
+		long long reach = toFixed(radius) + toFixed(r);
+		return dx*dx + dy*dy <= reach*reach;
+	}
+	return sqrt(pow((center[0]-cx),2)+pow((center[1]-cy),2))<=(radius + r);
+}
+
+/* The two portals send the bird from one to the other, at 45 degrees up and the other way */
+void Bird::checkPortal(Portal portal[2]){
+	float cx1,cy1,cx2,cy2;
+	bool sent = false;
+
+	cx1 = portal[0].center[0];
+	cy1 = portal[0].center[1];
+	cx2 = portal[1].center[0];
+	cy2 = portal[1].center[1];
+	if(center[1]>0&&allowed){
+		if(touches(cx1, cy1, portal[0].radius)){
+
+			t = 0;
+			initX = cx2;
+			initY = cy2;
+			posx = 0;
+			posy = 0;
+			center[0] = 0.05 + initX;
+			center[1] = 0 + initY;
+			allowed=false;
+			dir = -1*dir;
+			isMoving=true;
+			if(dir==-1)
+				theta = 135;
+			else
+				theta = 45;
+			sent = true;
+		}
+	}
+	else if(center[1]<0&&allowed){
+		if(touches(cx2, cy2, portal[1].radius)){
+
+			t = 0;
+			initX = cx1;
+			initY = cy1;
+			posx = 0;
+			posy = 0;
+			allowed=false;
+			center[0] = 0.05 + initX;
+			center[1] = 0 + initY;
+			isMoving=true;
+			dir = -1*dir;
+			if(dir==-1)
+				theta = 135;
+			else
+				theta = 45;
+			sent = true;
+		}
+	}
+	if(sent && integrated()){
+		float speed = sqrt(dot(velocity, velocity));
+		velocity = vec2(speed*cos(theta*M_PI/180.0f), speed*sin(theta*M_PI/180.0f));
+	}
+	if(sent && flight.model == FLIGHT_FIXED){
+		fixedFlight.initX = toFixed(initX);
+		fixedFlight.initY = toFixed(initY);
+		fixedFlight.posx = fixedFlight.posy = 0;
+		fixedFlight.theta = toFixed(theta);
+		fixedFlight.t = 0;
+		syncFixed();
+	}
+}
+
+void Bird::checkObstacle(bool touching, bool& collided, float cx, float cy){
+	float theta_old,vel_old,vel_new,theta_new,alpha=0.8;
+	if(touching && integrated()){
+		// Reflected about the normal where it hit, only while it still goes in
+		Vec2 normal = vec2(center[0] - cx, center[1] - cy);
+		float length = sqrt(dot(normal, normal)), in;
+		if(!collided && length > 0){
+			normal = (1/length)*normal;
+			in = dot(velocity, normal);
+			if(in < 0){
+				velocity = velocity - ((1 + RESTITUTION)*in)*normal;
+				dir = velocity.x < 0 ? -1 : 1;
+				t = 0;
+			}
+			collided = true;
+		}
+	}
+	else if(touching && flight.model == FLIGHT_FIXED){
+		if(!collided){
+			fixed turn = reboundFixed(true);
+			if(dir == 1 && fixedFlight.t == 0){
+				fixedFlight.theta = 180*FIXED_ONE - turn;
+				dir = -1;
+				collided = true;
+			}
+			else if(dir == -1 && fixedFlight.t == 0){
+				fixedFlight.theta = turn;
+				dir = 1;
+				collided = true;
+			}
+			fixedFlight.t = 0;
+			syncFixed();
+		}
+	}
+	else if(touching){
+		if(!collided){
+			initX = initX + posx;
+			initY = initY + posy;
+			posx = posy = 0;	// a second bounce in the same step must not add it again
+			theta_old = theta;
+			vel_old = vel;
+
+			vel_new = sqrt(pow(alpha*vel_old*cos(theta_old*M_PI/180.0f),2)+pow(vel_old*sin(theta_old*M_PI/180.0f),2));
+
+			theta_new = theta_old;	// only turned around when the bounce starts the trajectory
+			if(dir == 1 && t== 0){
+				theta_new = 180 - atan(sin(theta_old*M_PI/180.0f)/(alpha*cos(theta*M_PI/180.0f)));
+				dir = -1;
+				collided = true;
+			}
+			else if(dir == -1 && t== 0){
+				theta_new = atan(sin(theta_old*M_PI/180.0f)/(alpha*cos(theta*M_PI/180.0f)));
+				dir = 1;
+				collided = true;
+			}
+			t=0;
+			vel = vel_new;
+			theta = theta_new;
+		}
+
+	}
+	else
+		collided = false;
+
+}
+
+/* The borders are found by the caller, these only bounce the bird off them. An integrated
+   bird keeps going along the border and comes away from it with part of its speed across. */
+void Bird::bounceRoof(){
+	float theta_old,vel_old,vel_new,theta_new,alpha=0.8;
+	if(integrated()){
+		velocity = vec2(RESTITUTION*velocity.x, -fabs(velocity.y));
+		t=0;
+		return;
+	}
+	if(flight.model == FLIGHT_FIXED){
+		fixedFlight.theta = -reboundFixed(true);
+		fixedFlight.t = 0;
+		syncFixed();
+		return;
+	}
+	initX = initX + posx;
+	initY = initY + posy;
+	posx = posy = 0;
+	t=0;
+	theta_old = theta;
+	vel_old = vel;
+	vel_new = sqrt(((alpha*vel_old*cos(theta_old*M_PI/180.0f))*(alpha*vel_old*cos(theta_old*M_PI/180.0f)))+(vel_old*sin(theta_old*M_PI/180.0f)*(vel_old*sin(theta_old*M_PI/180.0f))));
+	theta_new = -1*(atan(sin(theta_old*M_PI/180.0f)/(alpha*cos(theta*M_PI/180.0f))));
+	vel = vel_new;
+	theta = theta_new;
+}
+
+void Bird::bounceWall(bool right){
+	float theta_old,vel_old,vel_new,theta_new,alpha=0.8;
+	if(integrated()){
+		velocity.x = (right ? -RESTITUTION : RESTITUTION)*fabs(velocity.x);
+		dir = right ? -1 : 1;
+		t=0;
+		return;
+	}
+	if(flight.model == FLIGHT_FIXED){
+		fixed turn = reboundFixed(true);
+		fixedFlight.theta = right ? 180*FIXED_ONE - turn : turn;
+		fixedFlight.t = 0;
+		dir = fixedFlight.theta < 90*FIXED_ONE ? 1 : -1;
+		syncFixed();
+		return;
+	}
+	if(right){
+		initX = initX + posx;
+		initY = initY + posy;
+		posx = posy = 0;
+		t=0;
+		theta_old = theta;
+		vel_old = vel;
+		vel_new = sqrt(((alpha*vel_old*cos(theta_old*M_PI/180.0f))*(alpha*vel_old*cos(theta_old*M_PI/180.0f)))+(vel_old*sin(theta_old*M_PI/180.0f)*(vel_old*sin(theta_old*M_PI/180.0f))));
+		theta_new = 180 - atan(sin(theta_old*M_PI/180.0f)/(alpha*cos(theta*M_PI/180.0f)));
+		vel = vel_new;
+		theta = theta_new;
+		if(theta < 90)
+			dir = 1;
+		else
+			dir = -1;
+
+	}
+	else{
+		initX = initX + posx;
+		initY = initY + posy;
+		posx = posy = 0;
+		t=0;
+		theta_old = theta;
+		vel_old = vel;
+		vel_new = sqrt(((alpha*vel_old*cos(theta_old*M_PI/180.0f))*(alpha*vel_old*cos(theta_old*M_PI/180.0f)))+(vel_old*sin(theta_old*M_PI/180.0f)*(vel_old*sin(theta_old*M_PI/180.0f))));
+		theta_new = atan(sin(theta_old*M_PI/180.0f)/(alpha*cos(theta*M_PI/180.0f)));
+		vel = vel_new;
+		theta = theta_new;
+		if(theta < 90)
+			dir = 1;
+		else
+			dir = -1;
+
+	}
+
+}
+
+void Bird::land(){
+	float theta_old,vel_old,vel_new,theta_new,alpha=0.8;
+	if(!floor && integrated()){
+		// Rolls on at what is left of its speed along the floor
+		vel = RESTITUTION*fabs(velocity.x);
+		dir = velocity.x < 0 ? -1 : 1;
+		velocity = vec2(0, 0);
+		t = 0;
+		floor = true;
+	}
+	else if(!floor && flight.model == FLIGHT_FIXED){
+		fixedFlight.theta = reboundFixed(false);
+		fixedFlight.vel = fixedMul(fixedFlight.vel, fixedCos(fixedFlight.theta));
+		fixedFlight.t = 0;
+		floor = true;
+		syncFixed();
+	}
+	else if(!floor){
+		theta_old = theta;
+		vel_old = vel;
+		vel_new = sqrt(((alpha*vel_old*cos(theta_old*M_PI/180.0f))*(alpha*vel_old*cos(theta_old*M_PI/180.0f)))+(vel_old*sin(theta_old*M_PI/180.0f)*(vel_old*sin(theta_old*M_PI/180.0f))));
+		theta_new = atan(sin(theta_old*M_PI/180.0f)/(alpha*cos(theta*M_PI/180.0f)));
+		vel = vel_new;
+		theta = theta_new;
+		t = 0;
+		vel = vel*cos(theta*M_PI/180.0f);
+		floor = true;
+	}
+}
+
+/* Where the stars are, three strokes each */
+static const float starPosition[13][2] = {
+	{-3.0,2.6}, {-1.0,1.1}, {1.0,2.75}, {2.0,1.75}, {3.0,2.25}, {1.0,-2.75}, {-2.8,-3.1},
+	{1.4,2.5}, {3.05,-2.15}, {-1.5,-0.5}, {3.25,-3.15}, {-1.05,3.35}, {-0.75,-2.15}
+};
+
+/* By SwarmType: gnats keep close and fast around the bird near them, hornets keep apart
+   and chase it from further off */
+static const SwarmKind swarmKinds[SWARM_KINDS] = {
+	{ 0.3, 1, 2, 0.05, 1.5, 1.0, 0.3, 0.8, 3, 0.02 },
+	{ 0.5, 0.5, 1, 0.08, 1.5, 2.5, 0.4, 1.1, 2, 0.035 }
+};
+
+Game::Game()
+{
+	int i;
+	dying.reserve(MAX_ENTITIES);
+	grid.reserve(MAX_ENTITIES);
+	geometry.reserve(MAX_ENTITIES + 6);
+	shapesFound.reserve(MAX_ENTITIES + 6);
+	candidates.reserve(MAX_ENTITIES);
+	circles.reserve(MAX_ENTITIES);
+	shotGrid.reserve(MAX_ENTITIES);
+	shotHits.reserve(MAX_SHOTS);
+	shots.reserve(MAX_SHOTS);
+	shotPrevx.reserve(MAX_SHOTS);
+	shotPrevy.reserve(MAX_SHOTS);
+	blocks.reserve(MAX_BLOCKS + 3);
+	blocksFound.reserve(MAX_BLOCKS);
+	breaking.reserve(MAX_ENTITIES);
+	debris.reserve();
+	buildFracturePatterns();
+	wells.reserve(MAX_WELLS);
+	wellTree.reserve(MAX_WELLS);
+	swarm.reserve(MAX_SWARM);
+	for(i=0;i<SWARM_KINDS;i++)
+		swarm.kinds[i] = swarmKinds[i];
+	swarm.left = FIELD_LEFT;
+	swarm.right = FIELD_RIGHT;
+	swarm.bottom = FIELD_FLOOR;
+	swarm.top = FIELD_ROOF;
+	volleySize = 0;
+	workers = NULL;
+	towerBlocks = 0;
+	blockBounce = false;
+	shatter = false;
+	wellCount = 0;
+	forceCells = 0;
+	swarmSize = 0;
+	chaserCount = 0;
+	collidePasses = 0;
+	sweepFrom[0] = angryBird.getCenter()[0];
+	sweepFrom[1] = angryBird.getCenter()[1];
+	worldLag = 0;
+	tickHash = HASH_START;
+	paused = false;
+	targets = 0;
+	comet = NO_ENTITY;
+	cometY = 0;
+	portal[0].place(2.8, 1.5);
+	portal[1].place(-2.0, -2.8);
+	// Targets, obstacles and lights come with each level
+	for(i=0;i<39;i++)
+		spawnStar(starPosition[i/3][0], starPosition[i/3][1], i%3);
+	spawnVarys(0, -3.5);
+	level = 1;
+	levelUp = false;
+	goNext = false;
+	pressNext = false;
+	on = true;
+	counter = counter1 = 0;
+	num = 0;
+	deltaTime = 0;
+}
+
+/* NO_ENTITY when the pool is used up, the spawn functions then create nothing */
+Entity Game::spawn(float x, float y)
+{
+	Transform transform = { x, y, x, y, 0, 0, 1, 1 };
+	Entity e = entities.create();
+	if(e != NO_ENTITY)
+		transforms.add(e, transform);
+	return e;
+}
+
+void Game::despawn(Entity e)
+{
+	if(!entities.alive(e))
+		return;
+	if(transforms.has(e))
+		transforms.remove(e);
+	if(colliders.has(e))
+		colliders.remove(e);
+	if(meshes.has(e))
+		meshes.remove(e);
+	if(animations.has(e))
+		animations.remove(e);
+	if(pickups.has(e))
+		pickups.remove(e);
+	entities.destroy(e);
+}
+
+/* Entities are not removed while the systems walk the component arrays */
+void Game::despawnDying()
+{
+	int i;
+	for(i=0;i<(int)dying.size();i++)
+		despawn(dying[i]);
+	dying.clear();
+}
+
+Entity Game::spawnStar(float x, float y, int variant)
+{
+	Entity e = spawn(x, y);
+	if(e == NO_ENTITY)
+		return e;
+	RenderMesh mesh = { MESH_STAR, variant, 1, true };
+	Animation animation = { ANIM_TWINKLE, 0, 1, 1, 0, false };
+	meshes.add(e, mesh);
+	animations.add(e, animation);
+	return e;
+}
+
+/* Targets, obstacles and lights are placed by initLevel() */
+Entity Game::spawnTarget()
+{
+	Entity e = spawn(2, 2);
+	if(e == NO_ENTITY)
+		return e;
+	Collider collider = { 0.25, COLLIDE_SCORE, false, 0 };
+	RenderMesh mesh = { MESH_TARGET, 0, 0.25, true };
+	Animation animation = { ANIM_BOB, 0.0045, 1, 1, 0, false };
+	colliders.add(e, collider);
+	meshes.add(e, mesh);
+	animations.add(e, animation);
+	targets++;
+	return e;
+}
+
+Entity Game::spawnObstacle()
+{
+	Entity e = spawn(2, 2);
+	if(e == NO_ENTITY)
+		return e;
+	Collider collider = { 0.25, COLLIDE_BOUNCE, false, 0 };
+	RenderMesh mesh = { MESH_OBSTACLE, 0, 0.25, true };
+	Animation animation = { ANIM_SPIN, 4.725, 1, 1, 0, false };
+	colliders.add(e, collider);
+	meshes.add(e, mesh);
+	animations.add(e, animation);
+	return e;
+}
+
+Entity Game::spawnLight()
+{
+	Entity e = spawn(0, 0);
+	if(e == NO_ENTITY)
+		return e;
+	Collider collider = { 0.05, COLLIDE_PICKUP, false, 0 };
+	RenderMesh mesh = { MESH_LIGHT, 0, 1, true };
+	Animation animation = { ANIM_SPIN, 3, 1, 1, 0, false };
+	Pickup pickup = { PICKUP_IMMUNITY };
+	colliders.add(e, collider);
+	meshes.add(e, mesh);
+	animations.add(e, animation);
+	pickups.add(e, pickup);
+	return e;
+}
+
+/* Varys hurts the bird within 0.2 of its centre */
+Entity Game::spawnVarys(float x, float y)
+{
+	Entity e = spawn(x, y);
+	if(e == NO_ENTITY)
+		return e;
+	Collider collider = { 0.2, COLLIDE_HAZARD, false, 0 };
+	RenderMesh mesh = { MESH_VARYS, 0, 1, true };
+	Animation animation = { ANIM_PATROL, 0.06, 1, 1, 0, false };
+	colliders.add(e, collider);
+	meshes.add(e, mesh);
+	animations.add(e, animation);
+	return e;
+}
+
+/* A chaser hurts the bird like Varys, and looks like it */
+Entity Game::spawnChaser(float x, float y)
+{
+	Entity e = spawn(x, y);
+	if(e == NO_ENTITY)
+		return e;
+	Collider collider = { CHASE_RADIUS, COLLIDE_HAZARD, false, 0 };
+	RenderMesh mesh = { MESH_VARYS, 0, 1, true };
+	Animation animation = { ANIM_CHASE, CHASE_SPEED, 1, 1, 0, false };
+	colliders.add(e, collider);
+	meshes.add(e, mesh);
+	animations.add(e, animation);
+	return e;
+}
+
+/* The comet flies to the left and gives the bird a life when it catches it */
+Entity Game::spawnComet(float x, float y)
+{
+	Entity e = spawn(x, y);
+	if(e == NO_ENTITY)
+		return e;
+	Collider collider = { COMET_RADIUS, COLLIDE_LIFE, false, 0 };
+	RenderMesh mesh = { MESH_COMET, 0, COMET_RADIUS, true };
+	Animation animation = { ANIM_FLY, 0.09, -1, 0, 0, false };
+	colliders.add(e, collider);
+	meshes.add(e, mesh);
+	animations.add(e, animation);
+	return e;
+}
+
+void Game::start()
+{
+	num = rand()%400 + 200;
+	initLevel();
+}
+
+/* Replace the targets, obstacles and lights of the last level with new ones */
+void Game::initLevel()
+{
+	int i,n;
+	for(i=0;i<colliders.size();i++){
+		Entity e = colliders.owner[i];
+		bool chaser = animations.has(e) && animations.get(e).type == ANIM_CHASE;
+		if(colliders.data[i].response != COLLIDE_HAZARD || chaser)
+			dying.push_back(e);
+	}
+	despawnDying();
+	comet = NO_ENTITY;
+	targets = 0;
+	shots.clear();
+	debris.clear();
+	breaking.clear();
+	buildTowers();
+	buildWells();
+	buildForces();
+	buildSwarm();
+
+	// Positions are whole units
+	n = levelTargets(level);
+	for(i=0;i<n;i++){
+		Entity e = spawnTarget();
+		if(e == NO_ENTITY)
+			break;
+		Transform& transform = transforms.get(e);
+		transform.x = transform.prevx = (int)((float)(rand()%7) + (-3.2f));
+		transform.y = transform.prevy = (int)((float)(rand()%7) + (-3.2f));
+		Collider& collider = colliders.get(e);
+		collider.radius = (float)((float)((rand()%20)+35)/100);
+		meshes.get(e).size = collider.radius;
+		animations.get(e).dir = pow(-1,i%2);
+	}
+	n = levelObstacles(level);
+	for(i=0;i<n;i++){
+		Entity e = spawnObstacle();
+		if(e == NO_ENTITY)
+			break;
+		Transform& transform = transforms.get(e);
+		transform.x = transform.prevx = (int)((float)(rand()%7) + (-3.2f));
+		transform.y = transform.prevy = (int)((float)(rand()%7) + (-3.2f));
+		Collider& collider = colliders.get(e);
+		collider.radius = (float)((float)((rand()%20)+15)/100);
+		meshes.get(e).size = collider.radius;
+	}
+
+	static const int lit[13] = {1,0,1,0,1,0,1,1,0,1,1,0,1};	// per group of 3 stars
+	for(i=0,n=0;i<animations.size();i++){
+		if(animations.data[i].type == ANIM_TWINKLE){
+			meshes.get(animations.owner[i]).visible = lit[n/3];
+			n++;
+		}
+	}
+
+	n = levelLights();
+	for(i=0;i<n;i++){
+		Entity e = spawnLight();
+		if(e == NO_ENTITY)
+			break;
+		Transform& transform = transforms.get(e);
+		transform.x = transform.prevx = ((float)((float)(rand()%5) + (-2.5f)));
+		transform.y = transform.prevy = ((float)((float)(rand()%5) + (-2.5f)));
+	}
+
+	cometY = rand()%5 - 2;
+	spawnChasers();
+	buildGeometry();
+
+	goNext=false;
+	pressNext=false;
+	levelUp=false;
+}
+
+/* The borders reach far out, the bird's centre is in them once it is past the field */
+void Game::buildGeometry()
+{
+	int i;
+	const float far = 1000;
+	geometry.clear();
+	geometry.addBox(-far, -far, FIELD_LEFT, far, GEOMETRY_LEFT, NO_ENTITY);
+	geometry.addBox(FIELD_RIGHT, -far, far, far, GEOMETRY_RIGHT, NO_ENTITY);
+	geometry.addBox(-far, FIELD_ROOF, far, far, GEOMETRY_ROOF, NO_ENTITY);
+	geometry.addBox(-far, -far, far, FIELD_FLOOR, GEOMETRY_FLOOR, NO_ENTITY);
+	for(i=0;i<colliders.size();i++){
+		if(colliders.data[i].response != COLLIDE_BOUNCE)
+			continue;
+		Transform& transform = transforms.get(colliders.owner[i]);
+		geometry.addCircle(transform.x, transform.y, colliders.data[i].radius, GEOMETRY_OBSTACLE, colliders.owner[i]);
+	}
+	for(i=0;i<2;i++)
+		geometry.addCircle(portal[i].posx, portal[i].posy, portal[i].radius, GEOMETRY_PORTAL, i);
+	geometry.build();
+	blockFlow();
+}
+
+/* The chasers of the level start on the right half of the field, heading left */
+void Game::spawnChasers()
+{
+	int i;
+	if(!chaserCount || !floatWorld()){
+		flow.clear();
+		return;
+	}
+	flow.resize(FLOW_CELLS, FLOW_CELLS, FIELD_LEFT, FIELD_FLOOR, (FIELD_RIGHT - FIELD_LEFT)/FLOW_CELLS);
+	for(i=0;i<chaserCount;i++){
+		Entity e = spawnChaser((rand()%340)/100.0f, (rand()%680)/100.0f - 3.4f);
+		if(e == NO_ENTITY)
+			break;
+		transforms.get(e).rotation = transforms.get(e).prevRotation = 180;
+	}
+}
+
+/* The cells the chasers keep out of: the obstacles, grown by what a chaser needs to pass.
+   Called with the geometry, so an obstacle that shattered opens its cells. */
+void Game::blockFlow()
+{
+	int i;
+	if(flow.empty())
+		return;
+	flow.clearBlocked();
+	for(i=0;i<colliders.size();i++){
+		if(colliders.data[i].response != COLLIDE_BOUNCE)
+			continue;
+		Transform& transform = transforms.get(colliders.owner[i]);
+		flow.block(transform.x, transform.y, colliders.data[i].radius + CHASE_RADIUS + CHASE_MARGIN);
+	}
+}
+
+/* Bit GEOMETRY_LEFT etc. is set for each border the centre of the bird is in */
+int Game::bordersReached()
+{
+	int i, borders = 0;
+	float* center = angryBird.getCenter();
+	if(flight.model == FLIGHT_FIXED){
+		FixedFlight& f = angryBird.fixedFlight;
+		fixed x = f.initX + f.posx + toFixed(BIRD_OFFSET), y = f.initY + f.posy;
+		borders |= (x <= toFixed(FIELD_LEFT)) << GEOMETRY_LEFT;
+		borders |= (x >= toFixed(FIELD_RIGHT)) << GEOMETRY_RIGHT;
+		borders |= (y >= toFixed(FIELD_ROOF)) << GEOMETRY_ROOF;
+		borders |= (y <= toFixed(FIELD_FLOOR)) << GEOMETRY_FLOOR;
+		return borders;
+	}
+	geometry.queryPoint(center[0], center[1], shapesFound);
+	for(i=0;i<(int)shapesFound.size();i++){
+		int tag = geometry.shape(shapesFound[i]).tag;
+		if(tag <= GEOMETRY_FLOOR)
+			borders |= 1 << tag;
+	}
+	return borders;
+}
+
+void Game::nextLevel(){
+	goNext=false;
+	angryBird.setScore(angryBird.getScore() + angryBird.getLives()*50);
+	angryBird.reset();
+	angryBird.setStatus(false);
+	angryBird.setLives(3);
+	angryBird.hit=0;
+	level++;
+	initLevel();
+	counter1=0;
+	num = rand()%400 + 200;
+	pauseGame(true);
+	levelUp=false;
+	goNext=false;
+
+}
+
+void Game::newGame(){
+	goNext=false;
+	angryBird.setScore(0);
+	angryBird.reset();
+	angryBird.setStatus(false);
+	angryBird.setLives(3);
+	angryBird.hit=0;
+	level=1;
+	initLevel();
+	counter1=0;
+	num = rand()%400 + 200;
+	pauseGame(true);
+	levelUp=false;
+	goNext=false;
+
+}
+
+void Game::pauseGame(bool play){
+	angryBird.pause=!play;
+	paused=!play;
+}
+
+/* The colliders that move, by collider index; the obstacles are in the level geometry */
+void Game::buildGrid()
+{
+	int i;
+	grid.clear();
+	for(i=0;i<colliders.size();i++){
+		if(colliders.data[i].response == COLLIDE_BOUNCE)
+			continue;
+		Transform& transform = transforms.get(colliders.owner[i]);
+		grid.add(i, transform.x, transform.y, colliders.data[i].radius);
+	}
+	grid.build();
+}
+
+/* Continuous collision: the collision checks only look at where the bird is at each step,
+   so a fast bird can pass through things between two steps. Its circle is swept from
+   where it was checked last to where it is now, against the level geometry and the
+   colliders near the path, assuming they stand still during the step. If the first thing
+   it ran into does not overlap it any more at the end, the bird is put back where it is
+   deepest inside it, for the checks to find it there. Moves shorter than its radius
+   cannot miss anything and are left to the checks. Not done for FLIGHT_FIXED, which has
+   nothing in float that could decide where the bird is. */
+void Game::sweepBird()
+{
+	int k;
+	float* center = angryBird.getCenter();
+	float r = angryBird.getRadius();
+	float dx = center[0] - sweepFrom[0], dy = center[1] - sweepFrom[1];
+	float length = sqrt(dx*dx + dy*dy);
+	if(length <= r || flight.model == FLIGHT_FIXED)
+		return;
+
+	// The first thing hit: a circle at cx, cy of radius cr, or with cr < 0 a box
+	RayHit hit;
+	float first = 1, t, cx = 0, cy = 0, cr = 0;
+	bool found = false;
+	if(geometry.sweepCircle(sweepFrom[0], sweepFrom[1], r, dx, dy, 1, hit, true)){
+		StaticShape& shape = geometry.shape(hit.shape);
+		first = hit.t;
+		found = true;
+		cx = shape.x;
+		cy = shape.y;
+		cr = shape.kind == SHAPE_CIRCLE ? shape.r : -1;
+	}
+	grid.query(sweepFrom[0] + dx/2, sweepFrom[1] + dy/2, length/2 + r, candidates);
+	for(k=0;k<(int)candidates.size();k++){
+		Collider& collider = colliders.data[candidates[k]];
+		if(collider.response == COLLIDE_LIFE || collider.collided)
+			continue;
+		Transform& transform = transforms.get(colliders.owner[candidates[k]]);
+		if(!circleTimeOfImpact(sweepFrom[0], sweepFrom[1], dx, dy, transform.x, transform.y, r + collider.radius, first, t) || t == 0)
+			continue;	// missed, or it was in it already
+		first = t;
+		found = true;
+		cx = transform.x;
+		cy = transform.y;
+		cr = collider.radius;
+	}
+	if(!found)
+		return;
+
+	if(cr < 0){
+		// Only boxes of the geometry; just past where it went in
+		geometry.queryCircle(center[0], center[1], r, shapesFound);
+		for(k=0;k<(int)shapesFound.size();k++)
+			if(shapesFound[k] == hit.shape)
+				return;
+		t = min(first + 0.001f*r/length, 1.0f);
+	}
+	else{
+		float ex = center[0] - cx, ey = center[1] - cy;
+		if(ex*ex + ey*ey <= (r + cr)*(r + cr))
+			return;
+		// Closest to the centre along the path
+		t = ((cx - sweepFrom[0])*dx + (cy - sweepFrom[1])*dy) / (length*length);
+		t = min(max(t, first), 1.0f);
+	}
+	angryBird.moveTo(sweepFrom[0] + t*dx, sweepFrom[1] + t*dy);
+}
+
+/* Collision system: the bird against the colliders near it. The grid gives the moving
+   candidates and the level geometry the obstacles, their overlaps are found all at once
+   in circles, then the responses are applied in collider order. */
+void Game::collide()
+{
+	collidePasses++;
+	collideFrom(0);
+}
+
+/* The colliders from index first on. With FLIGHT_FIXED the queries look a little further
+   and the bird touches what Bird::touches() says in fixed point, so that no float rounding
+   decides a hit. */
+void Game::collideFrom(int first)
+{
+	int i,k;
+	float* center = angryBird.getCenter();
+	bool exact = flight.model == FLIGHT_FIXED;
+	float reach = angryBird.getRadius() + (exact ? 0.01f : 0);
+	grid.query(center[0], center[1], reach, candidates);
+	geometry.queryCircle(center[0], center[1], reach, shapesFound);
+	for(k=0;k<(int)shapesFound.size();k++){
+		StaticShape& shape = geometry.shape(shapesFound[k]);
+		if(shape.tag == GEOMETRY_OBSTACLE)
+			candidates.push_back(colliders.index[entitySlot(shape.id)]);
+	}
+	sort(candidates.begin(), candidates.end());
+	circles.clear();
+	for(k=0;k<(int)candidates.size();k++){
+		Transform& transform = transforms.get(colliders.owner[candidates[k]]);
+		circles.add(transform.x, transform.y, colliders.data[candidates[k]].radius);
+	}
+	circles.overlap(center[0], center[1], angryBird.getRadius());
+
+	for(k=0;k<(int)candidates.size();k++){
+		i = candidates[k];
+		if(i < first)
+			continue;
+		bool touching = circles.hit(k);
+		if(exact){
+			Transform& transform = transforms.get(colliders.owner[i]);
+			touching = angryBird.touches(transform.x, transform.y, colliders.data[i].radius);
+		}
+		if(respond(i, touching)){
+			// The rest is tested where the bird is now
+			collideFrom(i+1);
+			return;
+		}
+	}
+}
+
+/* What collider i does to the bird, true when it sent the bird back */
+bool Game::respond(int i, bool touching)
+{
+	Collider& collider = colliders.data[i];
+	Transform& transform = transforms.get(colliders.owner[i]);
+	switch (collider.response) {
+		case COLLIDE_SCORE:
+			if(touching && !collider.collided)
+				scoreTarget(i);
+			break;
+		case COLLIDE_BOUNCE:
+			// Far from the bird last time, so not inside it
+			if(collider.pass != collidePasses-1)
+				collider.collided = false;
+			collider.pass = collidePasses;
+			if(shatter && floatWorld() && touching && !collider.collided){
+				float vx, vy;
+				birdVelocity(vx, vy);
+				breakObstacle(colliders.owner[i], vx, vy);
+			}
+			angryBird.checkObstacle(touching, collider.collided, transform.x, transform.y);
+			break;
+		case COLLIDE_PICKUP:
+			if(touching && !collider.collided){
+				if(pickups.get(colliders.owner[i]).effect == PICKUP_IMMUNITY)
+					angryBird.immune=true;
+				collider.collided = true;
+				dying.push_back(colliders.owner[i]);
+			}
+			break;
+		case COLLIDE_HAZARD:
+			if(!angryBird.immune && touching){
+				angryBird.setScore(angryBird.getScore() - (10*level));
+				angryBird.reset();
+				return true;
+			}
+			break;
+		case COLLIDE_LIFE:
+			// Checked in step(), the comet can be caught before the launch
+			break;
+	}
+	return false;
+}
+
+/* Target i is hit: it scores and shrinks away */
+void Game::scoreTarget(int i)
+{
+	Collider& collider = colliders.data[i];
+	Transform& transform = transforms.get(colliders.owner[i]);
+	float r = collider.radius;
+	angryBird.setScore(angryBird.getScore() + (int)((1/r)*4 + abs(transform.x*4) + level*5));
+	collider.collided = true;
+	collider.radius = 0;
+	animations.get(colliders.owner[i]).shrink = true;
+	angryBird.hit++;
+}
+
+int Game::fireVolley(float x, float y, float speed, float angle, float spread, int count)
+{
+	int k, fired;
+	for(k=0,fired=0;k<count && shots.count<MAX_SHOTS;k++,fired++){
+		float a = angle;
+		if(count > 1)
+			a += spread*(2.0f*k/(count-1) - 1);
+		a *= M_PI/180;
+		int i = shots.add(vec2(x, y), vec2(speed*cos(a), speed*sin(a)));
+		if(i == (int)shotPrevx.size()){
+			shotPrevx.push_back(0);
+			shotPrevy.push_back(0);
+		}
+		shotPrevx[i] = x;
+		shotPrevy[i] = y;
+	}
+	return fired;
+}
+
+/* Where the bird heads and how fast, however it flies */
+void Game::birdVelocity(float& vx, float& vy)
+{
+	float ax, ay;
+	if(integrated()){
+		vx = angryBird.velocity.x;
+		vy = angryBird.velocity.y;
+	}
+	else
+		angryBird.motion(vx, vy, ax, ay);
+}
+
+/* The towers of the level, of towerBlocks bricks, standing on the floor of the field
+   between its walls; the level's targets and obstacles are placed without regard to them */
+void Game::buildTowers()
+{
+	int i, t, course;
+	blocks.clear();
+	blockBounce = false;
+	if(!towerBlocks || !floatWorld())
+		return;
+	blocks.gravity = gravity;
+	blocks.addBox(0, FIELD_FLOOR - 0.5f, 5, 0.5f, 0, 0, BLOCK_FRICTION);
+	blocks.addBox(FIELD_LEFT - 0.5f, 0, 0.5f, 5, 0, 0, BLOCK_FRICTION);
+	blocks.addBox(FIELD_RIGHT + 0.5f, 0, 0.5f, 5, 0, 0, BLOCK_FRICTION);
+	int total = min(towerBlocks, MAX_BLOCKS);
+	for(t=0;t<TOWERS;t++){
+		float x = TOWERS_LEFT + (t + 0.5f)*(TOWERS_RIGHT - TOWERS_LEFT)/TOWERS;
+		int n = (t + 1)*total/TOWERS - t*total/TOWERS;
+		for(course=0;n>0;course++){
+			float y = FIELD_FLOOR + (course + 0.5f)*BLOCK_HEIGHT;
+			bool planks = course%PLANK_COURSES == PLANK_COURSES - 1;
+			float width = planks ? PLANK_BRICKS*BLOCK_WIDTH : BLOCK_WIDTH;
+			int columns = planks ? TOWER_COLUMNS/PLANK_BRICKS : TOWER_COLUMNS - course%2;
+			// A little narrower than the room they get, so neighbours start apart
+			for(i=0;i<columns && n>0;i++,n--)
+				blocks.addBox(x + (i - (columns - 1)/2.0f)*width, y, 0.49f*width, BLOCK_HEIGHT/2, 0, 1, BLOCK_FRICTION);
+		}
+	}
+}
+
+/* The bird bounces off the blocks it touches like off an obstacle, and knocks each of them
+   with a share of its momentum into it */
+void Game::hitBlocks()
+{
+	int k;
+	float px, py, nx, ny, vx, vy, bx = 0, by = 0;
+	float* center = angryBird.getCenter();
+	float r = angryBird.getRadius();
+	if(!towerBlocks || blocks.queryCircle(center[0], center[1], r, blocksFound) == 0){
+		blockBounce = false;
+		return;
+	}
+	birdVelocity(vx, vy);
+	int n = blocksFound.size();
+	for(k=0;k<n;k++){
+		if(!blocks.circleContact(blocksFound[k], center[0], center[1], r, px, py, nx, ny))
+			continue;
+		if(k == 0){
+			bx = px;
+			by = py;
+		}
+		float in = vx*nx + vy*ny;
+		if(in < 0)
+			blocks.applyImpulse(blocksFound[k], px, py, BIRD_MASS*in*nx/n, BIRD_MASS*in*ny/n);
+	}
+	angryBird.checkObstacle(true, blockBounce, bx, by);
+}
+
+/* Obstacle e shatters at the end of the step, once however often it is hit until then */
+void Game::breakObstacle(Entity e, float vx, float vy)
+{
+	int k;
+	for(k=0;k<(int)breaking.size();k++)
+		if(breaking[k].obstacle == e)
+			return;
+	ObstacleBreak hit = { e, vx, vy };
+	breaking.push_back(hit);
+}
+
+/* The obstacles hit in this step fall apart along a fracture pattern picked by their slot,
+   the pieces turned as the obstacle was; those that find no room in the pool are left
+   out. The level geometry is built again without them. */
+void Game::shatterObstacles()
+{
+	int i, k;
+	if(breaking.empty())
+		return;
+	for(i=0;i<(int)breaking.size();i++){
+		Entity e = breaking[i].obstacle;
+		if(!colliders.has(e))
+			continue;
+		Transform& transform = transforms.get(e);
+		float size = meshes.get(e).size;	// as it is drawn
+		float a = transform.rotation*M_PI/180, c = cos(a), s = sin(a);
+		int pattern = entitySlot(e)%FRACTURE_PATTERNS;
+		for(k=0;k<FRACTURE_PIECES;k++){
+			FracturePiece& piece = fracturePatterns[pattern].pieces[k];
+			Debris* d = debris.spawn();
+			if(d == NULL)
+				break;
+			float ox = c*piece.cx - s*piece.cy, oy = s*piece.cx + c*piece.cy;
+			float length = max(sqrt(ox*ox + oy*oy), 0.01f);
+			d->x = d->prevx = transform.x + size*ox;
+			d->y = d->prevy = transform.y + size*oy;
+			d->vx = DEBRIS_BURST*ox/length + DEBRIS_KICK*breaking[i].vx;
+			d->vy = DEBRIS_BURST*oy/length + DEBRIS_KICK*breaking[i].vy;
+			d->angle = d->prevAngle = transform.rotation;
+			d->spin = DEBRIS_SPIN*(k%2 ? 1 : -1)*(k + 1)/FRACTURE_PIECES;
+			d->size = size;
+			d->pattern = pattern;
+			d->piece = k;
+			d->rest = d->age = 0;
+		}
+		despawn(e);
+	}
+	breaking.clear();
+	buildGeometry();
+}
+
+/* The planets of the level, placed clear of the launch, and wellCount minus them moons
+   spread over them, each going round its planet at the speed of a circular orbit */
+void Game::buildWells()
+{
+	int i;
+	wells.clear();
+	wellTree.clear();
+	int n = floatWorld() ? min(wellCount, MAX_WELLS) : 0;
+	for(i=0;i<n;i++){
+		Well well;
+		if(i < WELL_PLANETS){
+			well.x = (rand()%400)/100.0f - 1.5f;
+			well.y = (rand()%500)/100.0f - 2.5f;
+			well.mass = PLANET_MASS;
+			well.radius = PLANET_RADIUS;
+			well.planet = -1;
+			well.distance = well.angle = well.speed = 0;
+		}
+		else{
+			Well& planet = wells[i%WELL_PLANETS];
+			well.mass = MOON_MASS;
+			well.radius = MOON_RADIUS;
+			well.planet = i%WELL_PLANETS;
+			well.distance = PLANET_RADIUS + 0.1f + (rand()%100)/100.0f;
+			well.angle = (rand()%628)/100.0f;
+			well.speed = sqrt(wellTree.strength*planet.mass/pow(well.distance, 3))*(i%2 ? 1 : -1);
+			well.x = planet.x + well.distance*cos(well.angle);
+			well.y = planet.y + well.distance*sin(well.angle);
+		}
+		well.prevx = well.x;
+		well.prevy = well.y;
+		wells.push_back(well);
+	}
+	moveWells();
+}
+
+/* The moons go on round their planets, and the tree is built again over where they are */
+void Game::moveWells()
+{
+	int i;
+	if(wells.empty())
+		return;
+	wellTree.clear();
+	for(i=0;i<(int)wells.size();i++){
+		Well& well = wells[i];
+		if(well.planet >= 0){
+			Well& planet = wells[well.planet];
+			well.angle += well.speed*SIM_DT;
+			well.x = planet.x + well.distance*cos(well.angle);
+			well.y = planet.y + well.distance*sin(well.angle);
+		}
+		wellTree.add(well.x, well.y, well.mass);
+	}
+	wellTree.build();
+}
+
+/* The force field of the level, sampled at the nodes of forceCells by forceCells cells */
+void Game::buildForces()
+{
+	int i, j, k;
+	float vortexX[FORCE_VORTICES], vortexY[FORCE_VORTICES];
+	forces.clear();
+	if(!forceCells || !floatWorld())
+		return;
+	forces.resize(forceCells, forceCells, GRID_MIN, GRID_MIN, (GRID_MAX - GRID_MIN)/forceCells);
+	float wind = WIND_SPEED*(level%3 - 1);
+	for(k=0;k<FORCE_VORTICES;k++){
+		vortexX[k] = (rand()%600)/100.0f - 3;
+		vortexY[k] = (rand()%600)/100.0f - 3;
+	}
+	float updraft = (rand()%600)/100.0f - 3;
+	for(j=0;j<forces.nodeRows();j++){
+		for(i=0;i<forces.nodeColumns();i++){
+			float x = forces.nodeX(i), y = forces.nodeY(j);
+			float ax = wind, ay = UPDRAFT_STRENGTH*exp(-(x - updraft)*(x - updraft)/(UPDRAFT_WIDTH*UPDRAFT_WIDTH));
+			// Swirling the other way round each
+			for(k=0;k<FORCE_VORTICES;k++){
+				float dx = x - vortexX[k], dy = y - vortexY[k];
+				float swirl = (k%2 ? -VORTEX_STRENGTH : VORTEX_STRENGTH)*exp(-(dx*dx + dy*dy)/(VORTEX_SIZE*VORTEX_SIZE));
+				ax -= swirl*dy;
+				ay += swirl*dx;
+			}
+			forces.setNode(i, j, ax, ay);
+		}
+	}
+}
+
+bool Game::birdFeelsForces()
+{
+	return (wellTree.size() || !forces.empty()) && integrated();
+}
+
+/* The acceleration the wells and the force field give at x, y */
+static void environment(const GravityTree& wells, const ForceField& forces, float x, float y, float& ax, float& ay)
+{
+	float fx, fy;
+	wells.field(x, y, ax, ay);
+	forces.sample(x, y, fx, fy);
+	ax += fx;
+	ay += fy;
+}
+
+/* The wells and the force field pull the debris, and the bird when it feels them; the
+   shots get their pull in updateShotChunk() */
+void Game::applyForces()
+{
+	int i;
+	float ax, ay;
+	if(!wellTree.size() && forces.empty())
+		return;
+	for(i=0;i<debris.count();i++){
+		Debris& d = debris.pieces[i];
+		environment(wellTree, forces, d.x, d.y, ax, ay);
+		d.vx += ax*SIM_DT;
+		d.vy += ay*SIM_DT;
+	}
+	if(birdFeelsForces() && angryBird.getStatus() && !angryBird.floor){
+		float* center = angryBird.getCenter();
+		environment(wellTree, forces, center[0], center[1], ax, ay);
+		angryBird.velocity.x += ax*SIM_DT;
+		angryBird.velocity.y += ay*SIM_DT;
+	}
+}
+
+/* The wells and the field pull before each step of the flight, as in applyForces() and
+   Bird::update() */
+void Game::aimPath(float interval, int n, float* x, float* y)
+{
+	int k, steps = 0;
+	float ax, ay;
+	float a = angryBird.getAngle()*M_PI/180;
+	Vec2 p = vec2(angryBird.initX, angryBird.initY);
+	Vec2 v = vec2(angryBird.getVel()*cos(a), angryBird.getVel()*sin(a));
+	for(k=0;k<n;k++){
+		for(;steps*SIM_DT < (k + 1)*interval - SIM_DT/2;steps++){
+			environment(wellTree, forces, p.x, p.y, ax, ay);
+			v.x += ax*SIM_DT;
+			v.y += ay*SIM_DT;
+			advanceProjectiles(&p.x, &p.y, &v.x, &v.y, 1, SIM_DT, flight);
+		}
+		x[k] = p.x;
+		y[k] = p.y;
+	}
+}
+
+/* The swarms of the level, swarmSize agents in clouds around random points, setting off
+   at their slowest in random directions */
+void Game::buildSwarm()
+{
+	int i, last = -1;
+	float cx = 0, cy = 0;
+	swarm.clear();
+	if(!floatWorld())
+		return;
+	for(i=0;i<swarmSize;i++){
+		int cloud = i*SWARM_CLOUDS/swarmSize;
+		if(cloud != last){
+			last = cloud;
+			cx = (rand()%500)/100.0f - 2.5f;
+			cy = (rand()%500)/100.0f - 2.5f;
+		}
+		int kind = cloud%2 ? SWARM_HORNETS : SWARM_GNATS;
+		float x = cx + SWARM_SPREAD*((rand()%1000)/1000.0f - 0.5f);
+		float y = cy + SWARM_SPREAD*((rand()%1000)/1000.0f - 0.5f);
+		float a = (rand()%360)*M_PI/180, speed = swarm.kinds[kind].minSpeed;
+		if(swarm.add(x, y, speed*cos(a), speed*sin(a), kind) < 0)
+			break;
+	}
+	swarm.build();
+}
+
+/* The swarms go for the bird while it flies */
+void Game::moveSwarm()
+{
+	float* center = angryBird.getCenter();
+	swarm.step(SIM_DT, center[0], center[1], angryBird.getStatus() && !angryBird.floor, workers);
+}
+
+/* The flow field follows the bird, a share of its search each step */
+void Game::moveFlow()
+{
+	float* center = angryBird.getCenter();
+	if(flow.empty())
+		return;
+	flow.setTarget(center[0], center[1]);
+	flow.update(FLOW_BUDGET);
+}
+
+/* A chaser heads along the flow field, or straight for the bird where the field leads
+   nowhere, turning at most CHASE_TURN degrees a step; the heading is its rotation */
+void Game::chase(Transform& transform, Animation& animation)
+{
+	float dx, dy;
+	float* center = angryBird.getCenter();
+	float tx = center[0] - transform.x, ty = center[1] - transform.y;
+	if(!angryBird.getStatus() && tx*tx + ty*ty < CHASE_HOLD*CHASE_HOLD)
+		return;
+	if(!flow.direction(transform.x, transform.y, dx, dy)){
+		dx = tx;
+		dy = ty;
+	}
+	float turn = atan2(dy, dx)*180/M_PI - transform.rotation;
+	turn -= 360*floor((turn + 180)/360);
+	transform.rotation += min(max(turn, (float)-CHASE_TURN), (float)CHASE_TURN);
+	transform.rotation -= 360*floor((transform.rotation + 180)/360);
+	float heading = transform.rotation*M_PI/180;
+	transform.x = min(max(transform.x + animation.speed*cos(heading), (float)FIELD_LEFT), (float)FIELD_RIGHT);
+	transform.y = min(max(transform.y + animation.speed*sin(heading), (float)FIELD_FLOOR), (float)FIELD_ROOF);
+}
+
+/* An agent hurts the bird as Varys does */
+void Game::hitSwarm()
+{
+	float* center = angryBird.getCenter();
+	if(!swarm.count || angryBird.immune || !angryBird.getStatus())
+		return;
+	if(swarm.firstTouching(center[0], center[1], angryBird.getRadius()) < 0)
+		return;
+	angryBird.setScore(angryBird.getScore() - (10*level));
+	angryBird.reset();
+}
+
+/* Power-up: once per flight the bird splits into volleySize shots fanned around where it
+   heads, and flies on itself */
+void Game::splitBird()
+{
+	float vx, vy;
+	if(!volleySize || !floatWorld() || angryBird.split || angryBird.floor || !angryBird.getStatus() || angryBird.pause)
+		return;
+	birdVelocity(vx, vy);
+	angryBird.split = true;
+	float* center = angryBird.getCenter();
+	fireVolley(center[0], center[1], sqrt(vx*vx + vy*vy), atan2(vy, vx)*180/M_PI, SPLIT_SPREAD, volleySize);
+}
+
+/* What a shot at x, y runs into: the collider with the lowest index it touches, else
+   SHOT_BLOCK + the block with the lowest index, else SHOT_SWARM + the agent with the
+   lowest index, SHOT_GONE once it left the field to the side or through the floor, else
+   SHOT_FLYING. It comes back from above the roof. Only
+   reads the game, the chunks run at the same time. */
+int Game::shotHit(float x, float y)
+{
+	int k, hit = SHOT_FLYING;
+	if(x < FIELD_LEFT || x > FIELD_RIGHT || y < FIELD_FLOOR)
+		return SHOT_GONE;
+	int c = shotGrid.cellAt(x, y);
+	for(k=shotGrid.cellStart[c];k<shotGrid.cellStart[c+1];k++){
+		int i = shotGrid.cellItems[k];
+		if(hit != SHOT_FLYING && i > hit)
+			continue;
+		Transform& transform = transforms.get(colliders.owner[i]);
+		float dx = x - transform.x, dy = y - transform.y, r = colliders.data[i].radius + SHOT_RADIUS;
+		if(dx*dx + dy*dy <= r*r)
+			hit = i;
+	}
+	if(hit == SHOT_FLYING && towerBlocks){
+		int b = blocks.firstTouching(x, y, SHOT_RADIUS);
+		if(b >= 0)
+			hit = SHOT_BLOCK + b;
+	}
+	if(hit == SHOT_FLYING && swarm.count){
+		int a = swarm.firstTouching(x, y, SHOT_RADIUS);
+		if(a >= 0)
+			hit = SHOT_SWARM + a;
+	}
+	return hit;
+}
+
+/* One job of updateShots(): the shots of the chunk get the pull of the wells and the force
+   field and fly a step, and each notes what it ran into in its own slot of shotHits */
+void Game::updateShotChunk(void* game, int chunk)
+{
+	int i;
+	Game& g = *(Game*)game;
+	ProjectileSet& shots = g.shots;
+	const ForceField& forces = g.forces;
+	int first = chunk*SHOT_CHUNK, last = min(first + SHOT_CHUNK, shots.count);
+	if(g.wellTree.size()){
+		for(i=first;i<last;i++){
+			float ax, ay;
+			g.wellTree.field(shots.x[i], shots.y[i], ax, ay);
+			shots.vx[i] += ax*SIM_DT;
+			shots.vy[i] += ay*SIM_DT;
+		}
+	}
+	forces.apply(&shots.x[first], &shots.y[first], &shots.vx[first], &shots.vy[first], last - first, SIM_DT);
+	advanceProjectiles(&shots.x[first], &shots.y[first], &shots.vx[first], &shots.vy[first], last - first, SIM_DT, flight);
+	for(i=first;i<last;i++)
+		g.shotHits[i] = g.shotHit(shots.x[i], shots.y[i]);
+}
+
+/* Projectile system. The shots fly with flight's gravity and drag, integrated with RK4 for
+   FLIGHT_RK4 and semi-implicit Euler otherwise, in chunks spread over the workers. The
+   chunks only find what each shot hits; the hits are then applied here in shot order, so
+   when two shots reach a target in the same step the older one scores, however the
+   chunks were scheduled. A shot ends at whatever it hits except a target already hit, and
+   knocks the block it hits or shatters the obstacle, or kills the agent of the swarm. */
+void Game::updateShots()
+{
+	int i, n;
+	if(!shots.count || angryBird.pause)
+		return;
+	// Pickups and the comet are the bird's to catch
+	shotGrid.clear();
+	for(i=0;i<colliders.size();i++){
+		Collider& collider = colliders.data[i];
+		if(collider.response == COLLIDE_PICKUP || collider.response == COLLIDE_LIFE || (collider.collided && collider.response == COLLIDE_SCORE))
+			continue;
+		Transform& transform = transforms.get(colliders.owner[i]);
+		shotGrid.add(i, transform.x, transform.y, collider.radius + SHOT_RADIUS);
+	}
+	shotGrid.build();
+
+	shotHits.resize(shots.count);
+	int chunks = (shots.count + SHOT_CHUNK - 1)/SHOT_CHUNK;
+	if(workers)
+		workers->run(chunks, updateShotChunk, this);
+	else
+		for(i=0;i<chunks;i++)
+			updateShotChunk(this, i);
+
+	for(i=0,n=0;i<shots.count;i++){
+		int hit = shotHits[i];
+		if(hit >= SHOT_SWARM){
+			// Two shots can hit the same agent, the later flies on
+			if(swarm.dead[hit - SHOT_SWARM])
+				hit = SHOT_FLYING;
+			else{
+				swarm.kill(hit - SHOT_SWARM);
+				angryBird.setScore(angryBird.getScore() + SWARM_SCORE);
+			}
+		}
+		else if(hit >= SHOT_BLOCK)
+			blocks.applyImpulse(hit - SHOT_BLOCK, shots.x[i], shots.y[i], SHOT_MASS*shots.vx[i], SHOT_MASS*shots.vy[i]);
+		else if(hit >= 0 && shatter && colliders.data[hit].response == COLLIDE_BOUNCE)
+			breakObstacle(colliders.owner[hit], shots.vx[i], shots.vy[i]);
+		else if(hit >= 0 && colliders.data[hit].response == COLLIDE_SCORE){
+			if(colliders.data[hit].collided)
+				hit = SHOT_FLYING;
+			else
+				scoreTarget(hit);
+		}
+		if(hit != SHOT_FLYING)
+			continue;
+		shots.x[n] = shots.x[i];
+		shots.y[n] = shots.y[i];
+		shots.vx[n] = shots.vx[i];
+		shots.vy[n] = shots.vy[i];
+		shotPrevx[n] = shotPrevx[i];
+		shotPrevy[n] = shotPrevy[i];
+		n++;
+	}
+	shots.count = n;
+}
+
+/* Animation system, one step of every animated entity */
+void Game::animate()
+{
+	int i;
+	bool twinkle = counter%10==0&&!angryBird.pause;
+	for(i=0;i<animations.size();i++){
+		Animation& animation = animations.data[i];
+		Transform& transform = transforms.get(animations.owner[i]);
+		switch (animation.type) {
+			case ANIM_BOB:
+				if(!paused){
+					transform.y+=animation.speed*animation.dir;
+					animation.count++;
+					if(animation.count%17==0)
+						animation.dir=-1*animation.dir;
+					if(transform.scale>0&&animation.shrink)
+						transform.scale-=0.009;
+					else if(animation.shrink)
+						dying.push_back(animations.owner[i]);
+				}
+				break;
+			case ANIM_SPIN:
+				if(!paused)
+					transform.rotation+=animation.speed;
+				break;
+			case ANIM_PATROL:
+				animation.count++;
+				if(animation.count%17==0)
+					animation.dir=-1*animation.dir;
+				if(transform.y > 3.5)
+					animation.up = -1;
+				if(transform.y < -3.5)
+					animation.up = 1;
+				if(!paused){
+					transform.x += animation.speed*animation.dir;
+					transform.y += animation.speed*animation.up;
+				}
+				break;
+			case ANIM_CHASE:
+				if(!paused)
+					chase(transform, animation);
+				break;
+			case ANIM_FLY:
+				if(!paused)
+					transform.x += animation.speed*animation.dir;
+				if(transform.x < COMET_GONE){
+					dying.push_back(animations.owner[i]);
+					if(animations.owner[i] == comet)
+						comet = NO_ENTITY;
+				}
+				break;
+			case ANIM_TWINKLE:
+				if(twinkle){
+					RenderMesh& mesh = meshes.get(animations.owner[i]);
+					mesh.visible = !mesh.visible;
+				}
+				break;
+		}
+	}
+}
+
+void Game::savePrevious()
+{
+	int i;
+	for(i=0;i<transforms.size();i++){
+		Transform& transform = transforms.data[i];
+		transform.prevx = transform.x;
+		transform.prevy = transform.y;
+		transform.prevRotation = transform.rotation;
+		transform.prevScale = transform.scale;
+	}
+	for(i=0;i<shots.count;i++){
+		shotPrevx[i] = shots.x[i];
+		shotPrevy[i] = shots.y[i];
+	}
+	blocks.savePrevious();
+	debris.savePrevious();
+	swarm.savePrevious();
+	for(i=0;i<(int)wells.size();i++){
+		wells[i].prevx = wells[i].x;
+		wells[i].prevy = wells[i].y;
+	}
+}
+
+/* The clocks of the step: time, the comet and how long the bird stays immune */
+void Game::tick()
+{
+	deltaTime+=SIM_DT;
+	if(!angryBird.pause){
+		counter++;
+		counter1++;
+	}
+	if(counter1 == num){
+		despawn(comet);
+		comet = spawnComet(COMET_START, cometY);
+	}
+	if(angryBird.immune&&!angryBird.pause){
+		angryBird.immuneCount++;
+		if(angryBird.immuneCount == 250){
+			angryBird.immuneCount = 0;
+			angryBird.immune = false;
+		}
+	}
+}
+
+/* Nothing here depends on how often or whether the game is drawn; the amounts per step
+   keep the speeds the game had when everything moved once per frame at 60 frames per second */
+void Game::step(){
+	angryBird.savePrevious();
+	savePrevious();
+
+	// Collisions are resolved on the positions of the last step, then everything moves on
+	if(colliders.has(comet)){
+		Transform& transform = transforms.get(comet);
+		if(angryBird.touches(transform.x, transform.y, colliders.get(comet).radius)){
+			angryBird.setLives(angryBird.getLives() + 1);
+			despawn(comet);
+			comet = NO_ENTITY;
+		}
+	}
+	if(angryBird.getStatus()){
+		buildGrid();
+		sweepBird();
+		int borders = bordersReached();
+		if(borders & 1 << GEOMETRY_RIGHT)
+			angryBird.bounceWall(true);
+		else if(borders & 1 << GEOMETRY_LEFT)
+			angryBird.bounceWall(false);
+		if(borders & 1 << GEOMETRY_FLOOR)
+			angryBird.land();
+		collide();
+		hitBlocks();
+		hitSwarm();
+		// A hazard may have sent the bird back
+		if(bordersReached() & 1 << GEOMETRY_ROOF)
+			angryBird.bounceRoof();
+		angryBird.checkPortal(portal);
+	}
+	if(angryBird.getLives() <= 0){
+		pauseGame(false);
+		levelUp=true;
+		if(goNext&&levelUp){
+			goNext=false;
+			newGame();
+		}
+	}
+	if(angryBird.hit == targets){
+		pauseGame(false);
+		levelUp=true;
+		if(goNext&&levelUp){
+			goNext=false;
+			nextLevel();
+		}
+	}
+
+	if(angryBird.getStatus()&&!angryBird.pause){
+		angryBird.t+=SIM_DT;
+		angryBird.fixedFlight.t+=toFixed(SIM_DT);
+	}
+	if(!angryBird.pause)
+		moveWells();
+	updateShots();
+	if(!angryBird.pause){
+		blocks.step(SIM_DT, workers);
+		applyForces();
+		debris.update(SIM_DT, gravity, FIELD_FLOOR, FIELD_LEFT, FIELD_RIGHT);
+		moveSwarm();
+		moveFlow();
+	}
+	tick();
+
+	// Where the next step sweeps from, unless the bird is not flying after the update
+	sweepFrom[0] = angryBird.getCenter()[0];
+	sweepFrom[1] = angryBird.getCenter()[1];
+	angryBird.update();
+	if(!angryBird.getStatus()){
+		sweepFrom[0] = angryBird.getCenter()[0];
+		sweepFrom[1] = angryBird.getCenter()[1];
+	}
+	animate();
+	despawnDying();
+	shatterObstacles();
+	if(flight.model == FLIGHT_FIXED)
+		tickHash = stateHash(tickHash);
+}
+
+/* The bird, the rules and where everything is. The floats that go in are only ever worked
+   out with exact or correctly rounded operations, so they hash the same too. The float
+   simulations only go in by how much of them there is, none with FLIGHT_FIXED. */
+unsigned long long Game::stateHash(unsigned long long hash)
+{
+	int i;
+	FixedFlight& f = angryBird.fixedFlight;
+	fixed words[7] = { f.initX, f.initY, f.posx, f.posy, f.vel, f.theta, f.t };
+	for(i=0;i<7;i++)
+		hash = hashWord(hash, words[i]);
+	hash = hashWord(hash, (int)angryBird.getScore());
+	hash = hashWord(hash, (int)angryBird.getLives());
+	hash = hashWord(hash, angryBird.hit);
+	hash = hashWord(hash, angryBird.dir);
+	hash = hashWord(hash, (angryBird.getStatus() != 0) | angryBird.floor << 1 | angryBird.immune << 2 | angryBird.allowed << 3);
+	hash = hashWord(hash, level);
+	hash = hashWord(hash, counter1);
+	hash = hashWord(hash, blocks.bodies.size());
+	hash = hashWord(hash, shots.count);
+	hash = hashWord(hash, debris.count());
+	hash = hashWord(hash, wells.size());
+	hash = hashWord(hash, swarm.count);
+	hash = hashWord(hash, forces.empty() | flow.empty() << 1);
+	for(i=0;i<transforms.size();i++){
+		Transform& transform = transforms.data[i];
+		hash = hashWord(hash, transforms.owner[i]);
+		hash = hashWord(hash, toFixed(transform.x));
+		hash = hashWord(hash, toFixed(transform.y));
+	}
+	return hash;
+}
+
+/* Event driven shots. Between two impacts the bird flies a parabola, so when it next
+   reaches a border or a collider is solved for instead of stepped to, and the bird is put
+   right there. The world still moves in whole steps behind it; within a stretch in which
+   nothing changes direction the moving colliders are taken to move in straight lines. */
+
+#define EVENT_TOLERANCE 1e-4f	// how close counts as touching
+#define EVENT_ITERATIONS 256
+#define EVENT_WINDOW 0.25f	// seconds the speed of approach is bounded over
+
+/* First t in (0, horizon] at which a*t*t + b*t + c turns from negative to positive */
+static bool firstCrossing(float a, float b, float c, float horizon, float& t)
+{
+	float roots[2];
+	int n = 0, k;
+	if(c >= 0)
+		return false;
+	if(a == 0){
+		if(b <= 0)
+			return false;
+		roots[n++] = -c/b;
+	}
+	else{
+		float disc = b*b - 4*a*c;
+		if(disc < 0)
+			return false;
+		float q = -0.5f*(b + (b < 0 ? -sqrt(disc) : sqrt(disc)));
+		if(q != 0)
+			roots[n++] = c/q;
+		roots[n++] = q/a;
+		if(n == 2 && roots[0] > roots[1])
+			swap(roots[0], roots[1]);
+	}
+	for(k=0;k<n;k++){
+		if(roots[k] > 0 && roots[k] <= horizon && 2*a*roots[k] + b > 0){
+			t = roots[k];
+			return true;
+		}
+	}
+	return false;
+}
+
+/* First t in (0, horizon] at which q + v*t + a*t*t/2 comes within r of the origin, by
+   conservative advancement: the gap left over the fastest it can close within the next
+   window is a step that cannot go past the contact. Only running into it counts, not
+   being in it already. */
+static bool firstContact(float qx, float qy, float vx, float vy, float ax, float ay, float r, float horizon, float& t)
+{
+	int k;
+	float accel = sqrt(ax*ax + ay*ay);
+	if(sqrt(qx*qx + qy*qy) - r <= EVENT_TOLERANCE)
+		return false;
+	t = 0;
+	for(k=0;k<EVENT_ITERATIONS;k++){
+		float px = qx + (vx + 0.5f*ax*t)*t, py = qy + (vy + 0.5f*ay*t)*t;
+		float gap = sqrt(px*px + py*py) - r;
+		if(gap <= EVENT_TOLERANCE)
+			return true;
+		float wx = vx + ax*t, wy = vy + ay*t;
+		float speed = sqrt(wx*wx + wy*wy) + accel*EVENT_WINDOW;
+		if(speed <= 0)
+			return false;
+		t += min(gap/speed, EVENT_WINDOW);
+		if(t > horizon)
+			return false;
+	}
+	return false;
+}
+
+/* Per second, how collider i moves while its animation keeps going the same way */
+bool Game::colliderVelocity(int i, float& vx, float& vy)
+{
+	vx = vy = 0;
+	Entity e = colliders.owner[i];
+	if(paused || !animations.has(e))
+		return false;
+	Animation& animation = animations.get(e);
+	if(animation.type == ANIM_BOB)
+		vy = animation.speed*animation.dir/SIM_DT;
+	else if(animation.type == ANIM_PATROL){
+		vx = animation.speed*animation.dir/SIM_DT;
+		vy = animation.speed*animation.up/SIM_DT;
+	}
+	else
+		return false;
+	return true;
+}
+
+/* How long from now the colliders keep moving the way they do, the bird stays immune and
+   the portals stay closed: nextEvent() looks no further than this */
+float Game::motionHorizon()
+{
+	int i, steps = 250;
+	float horizon;
+	for(i=0;i<colliders.size();i++){
+		Collider& collider = colliders.data[i];
+		if(collider.response != COLLIDE_SCORE && collider.response != COLLIDE_HAZARD)
+			continue;
+		if(collider.collided || !animations.has(colliders.owner[i]))
+			continue;
+		Animation& animation = animations.get(colliders.owner[i]);
+		if(animation.type != ANIM_BOB && animation.type != ANIM_PATROL)
+			continue;
+		// Turns around every 17 steps
+		steps = min(steps, 17 - animation.count%17);
+		if(animation.type == ANIM_PATROL){
+			float y = transforms.get(colliders.owner[i]).y;
+			float room = animation.up > 0 ? 3.5f - y : y + 3.5f;
+			steps = min(steps, max(1, (int)(room/animation.speed) + 1));
+		}
+	}
+	if(angryBird.immune)
+		steps = min(steps, max(1, 250 - angryBird.immuneCount));
+	horizon = steps*SIM_DT - worldLag;
+	if(!angryBird.allowed && angryBird.t <= 3)
+		horizon = min(horizon, 3 - angryBird.t + EVENT_TOLERANCE);
+	return horizon;
+}
+
+bool Game::nextEvent(float horizon, ShotEvent& event)
+{
+	int i;
+	float t, vx, vy, ax, ay, center[2];
+	float r = angryBird.getRadius();
+	// On the trajectory, the bird waiting to be launched sits a little off it
+	center[0] = angryBird.initX + angryBird.getX() + (0.17/3);
+	center[1] = angryBird.initY + angryBird.getY();
+	angryBird.motion(vx, vy, ax, ay);
+	event.time = horizon;
+	event.index = -1;
+
+	// The borders are crossed by the centre of the bird
+	if(firstCrossing(0.5f*ax, vx, center[0] - FIELD_RIGHT, event.time, t)){
+		event.time = t;
+		event.type = EVENT_RIGHT;
+	}
+	if(firstCrossing(-0.5f*ax, -vx, FIELD_LEFT - center[0], event.time, t)){
+		event.time = t;
+		event.type = EVENT_LEFT;
+	}
+	if(firstCrossing(0.5f*ay, vy, center[1] - FIELD_ROOF, event.time, t)){
+		event.time = t;
+		event.type = EVENT_ROOF;
+	}
+	if(firstCrossing(-0.5f*ay, -vy, FIELD_FLOOR - center[1], event.time, t)){
+		event.time = t;
+		event.type = EVENT_FLOOR;
+	}
+
+	for(i=0;i<colliders.size();i++){
+		Collider& collider = colliders.data[i];
+		if(collider.response == COLLIDE_LIFE || collider.radius <= 0)
+			continue;
+		if(collider.response != COLLIDE_BOUNCE && collider.collided)
+			continue;
+		if(collider.response == COLLIDE_HAZARD && angryBird.immune)
+			continue;
+		Transform& transform = transforms.get(colliders.owner[i]);
+		float cvx, cvy;
+		colliderVelocity(i, cvx, cvy);
+		float qx = center[0] - transform.x - cvx*worldLag, qy = center[1] - transform.y - cvy*worldLag;
+		if(firstContact(qx, qy, vx - cvx, vy - cvy, ax, ay, r + collider.radius, event.time, t)){
+			event.time = t;
+			event.type = EVENT_COLLIDER;
+			event.index = i;
+		}
+	}
+	if(angryBird.allowed){
+		for(i=0;i<2;i++){
+			if(firstContact(center[0] - portal[i].center[0], center[1] - portal[i].center[1], vx, vy, ax, ay, r + portal[i].radius, event.time, t)){
+				event.time = t;
+				event.type = EVENT_PORTAL;
+				event.index = i;
+			}
+		}
+	}
+	return event.time < horizon;
+}
+
+/* The world moves on by whole steps, as step() moves it with the bird taken out */
+void Game::advanceWorld(int steps)
+{
+	int k;
+	for(k=0;k<steps;k++){
+		savePrevious();
+		if(!angryBird.pause)
+			moveWells();
+		updateShots();
+		if(!angryBird.pause){
+			blocks.step(SIM_DT, workers);
+			applyForces();
+			debris.update(SIM_DT, gravity, FIELD_FLOOR, FIELD_LEFT, FIELD_RIGHT);
+			moveSwarm();
+			moveFlow();
+		}
+		tick();
+		angryBird.rotation+=1.5;
+		animate();
+		despawnDying();
+		shatterObstacles();
+	}
+}
+
+/* Whether the bird is in an obstacle or touches one */
+bool Game::inObstacle()
+{
+	int k;
+	float* center = angryBird.getCenter();
+	geometry.queryCircle(center[0], center[1], angryBird.getRadius() + EVENT_TOLERANCE, shapesFound);
+	for(k=0;k<(int)shapesFound.size();k++)
+		if(geometry.shape(shapesFound[k]).tag == GEOMETRY_OBSTACLE)
+			return true;
+	return false;
+}
+
+/* How long the bird surely stays clear of the blocks, the agents and the chasers, which
+   move by their own steps and so are not solved for: the gap to the nearest over the
+   fastest the two can close it, looking no further than a window ahead. A block goes at
+   most twice as fast as the fastest one now, from what contacts pass on, plus what
+   gravity adds; while shots knock the blocks about there is no such bound. */
+float Game::worldClearance()
+{
+	int i;
+	float vx, vy, ax, ay;
+	float* center = angryBird.getCenter();
+	float r = angryBird.getRadius();
+	float clearance = EVENT_WINDOW;
+	angryBird.motion(vx, vy, ax, ay);
+	float birdSpeed = sqrt(vx*vx + vy*vy) + sqrt(ax*ax + ay*ay)*EVENT_WINDOW;
+	if(towerBlocks){
+		if(shots.count)
+			return 0;
+		float fastest = 0, gap = 1e30f;
+		for(i=0;i<(int)blocks.bodies.size();i++){
+			RigidBody& b = blocks.bodies[i];
+			if(b.invMass == 0)
+				continue;
+			float dx = max(max(b.x0 - center[0], center[0] - b.x1), 0.0f);
+			float dy = max(max(b.y0 - center[1], center[1] - b.y1), 0.0f);
+			gap = min(gap, (float)sqrt(dx*dx + dy*dy) - r);
+			fastest = max(fastest, (float)(sqrt(b.vx*b.vx + b.vy*b.vy) + fabs(b.w)*sqrt(b.hx*b.hx + b.hy*b.hy)));
+		}
+		float speed = 2*fastest + blocks.gravity*EVENT_WINDOW;
+		clearance = min(clearance, (gap - speed*worldLag)/(birdSpeed + speed));
+	}
+	if(swarm.count){
+		float speed = 0, gap = 1e30f;
+		for(i=0;i<SWARM_KINDS;i++)
+			speed = max(speed, swarm.kinds[i].maxSpeed);
+		for(i=0;i<swarm.count;i++){
+			if(swarm.dead[i])
+				continue;
+			float dx = swarm.x[i] - center[0], dy = swarm.y[i] - center[1];
+			gap = min(gap, (float)sqrt(dx*dx + dy*dy) - r - swarm.kinds[swarm.kind[i]].radius);
+		}
+		clearance = min(clearance, (gap - speed*worldLag)/(birdSpeed + speed));
+	}
+	for(i=0;i<colliders.size();i++){
+		Entity e = colliders.owner[i];
+		if(!animations.has(e) || animations.get(e).type != ANIM_CHASE)
+			continue;
+		Transform& transform = transforms.get(e);
+		float speed = animations.get(e).speed/SIM_DT;
+		float dx = transform.x - center[0], dy = transform.y - center[1];
+		float gap = sqrt(dx*dx + dy*dy) - r - colliders.data[i].radius;
+		clearance = min(clearance, (gap - speed*worldLag)/(birdSpeed + speed));
+	}
+	return max(clearance, 0.0f);
+}
+
+/* Each impact gets the response the collision checks give it, right as the bird runs
+   into it, obstacles included. What is stepped is what the rules define per step: in an
+   obstacle the trajectory starts again, slower, at every step, rolling along the floor
+   loses speed per step, and an integrated or fixed point flight is its steps. Blocks,
+   agents and chasers move by their own steps too, so near them the bird steps with them;
+   until worldClearance() runs out it flies on by events. Resolved shots come out close to
+   stepped ones but not the same, and the comet is left out. */
+int Game::resolveShot(int maxEvents)
+{
+	int events = 0, steps = 0;
+	float clearance = 0;
+	ShotEvent event;
+	worldLag = 0;
+	while(angryBird.getStatus() && !angryBird.pause && !isOver() && events < maxEvents && steps < SHOT_STEPS){
+		// The checks look at where the bird starts from once, the events only at what it runs into
+		if(!steps || angryBird.floor || inObstacle() || flight.model != FLIGHT_PARABOLA || (clearance = worldClearance()) < SIM_DT){
+			sweepFrom[0] = angryBird.getCenter()[0];
+			sweepFrom[1] = angryBird.getCenter()[1];
+			step();
+			steps++;
+			continue;
+		}
+		bool found = nextEvent(min(motionHorizon(), clearance), event);
+		angryBird.flyTo(angryBird.t + event.time);
+		worldLag += event.time;
+		int n = (int)(worldLag/SIM_DT + EVENT_TOLERANCE);
+		worldLag = max(worldLag - n*SIM_DT, 0.0);
+		advanceWorld(n);
+		if(!found)
+			continue;
+		events++;
+		switch (event.type) {
+			case EVENT_LEFT:
+				angryBird.bounceWall(false);
+				break;
+			case EVENT_RIGHT:
+				angryBird.bounceWall(true);
+				break;
+			case EVENT_ROOF:
+				angryBird.bounceRoof();
+				break;
+			case EVENT_FLOOR:
+				angryBird.land();
+				break;
+			case EVENT_COLLIDER:
+				respond(event.index, true);
+				despawnDying();
+				break;
+		}
+		angryBird.checkPortal(portal);
+	}
+	worldLag = 0;
+	angryBird.savePrevious();
+	sweepFrom[0] = angryBird.getCenter()[0];
+	sweepFrom[1] = angryBird.getCenter()[1];
+	return events;
+}
+
+/* Adjust the shot, only while the bird waits to be launched; once it flies, skip to where it comes to rest */
+void Game::control(int action)
+{
+	if(action == CONTROL_RESOLVE){
+		if(angryBird.getStatus()&&!angryBird.pause)
+			resolveShot(SHOT_EVENTS);
+		return;
+	}
+	if(action == CONTROL_SPLIT){
+		splitBird();
+		return;
+	}
+	if(angryBird.getStatus()||angryBird.pause)
+		return;
+	switch (action) {
+		case CONTROL_FASTER:
+			angryBird.setVel(angryBird.getVel()+0.2);
+			break;
+		case CONTROL_SLOWER:
+			angryBird.setVel(angryBird.getVel()-0.2);
+			break;
+		case CONTROL_AIM_DOWN:
+			angryBird.setAngle(angryBird.getAngle()-5);
+			break;
+		case CONTROL_AIM_UP:
+			angryBird.setAngle(angryBird.getAngle()+5);
+			break;
+		case CONTROL_LAUNCH:
+			angryBird.launch();
+			break;
+		case CONTROL_RAISE:
+			if(angryBird.initY < 3.5)
+				angryBird.initY += 0.2;
+			angryBird.center[1] = angryBird.initY;
+			break;
+		case CONTROL_LOWER:
+			if(angryBird.initY > -3.5)
+				angryBird.initY -= 0.2;
+			angryBird.center[1] = angryBird.initY;
+			break;
+		default:
+			break;
+	}
+}
+
+void Game::togglePause()
+{
+	on=!on;
+	pauseGame(on);
+}
+
+/* Start or stop aiming with the pointer */
+void Game::grab(bool pressed)
+{
+	if(!pressed)
+		pressNext=false;
+	else if(!angryBird.pause&&!angryBird.getStatus())
+		pressNext=true;
+}
+
+void Game::aim(float angle)
+{
+	if(!angryBird.pause&&pressNext)
+		angryBird.setAngle(angle);
+}
+
+/* Go on to the next level, or a new game, once this one is over */
+void Game::accept()
+{
+	if(levelUp)
+		goNext = true;
+}
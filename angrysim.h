@@ -0,0 +1,639 @@
+#ifndef ANGRYSIM_H
+#define ANGRYSIM_H
+
+#include <vector>
+#include "collide.h"
+#include "bvh.h"
+#include "integrate.h"
+#include "fixed.h"
+#include "workers.h"
+#include "rigid.h"
+#include "fracture.h"
+#include "gravity.h"
+#include "forcefield.h"
+#include "flock.h"
+#include "flowfield.h"
+
+/* Game rules of Angry Birds: Star Wars Edition, without any rendering or windowing.
+   A Game holds the whole state of one game and is advanced with step(); it can be
+   copied freely, e.g. to hand a consistent state over to a renderer. */
+
+/* The simulation advances in fixed steps of SIM_DT seconds, independently of the frame rate */
+#define SIM_DT 0.025
+
+/* Entities of the first level, and how many more targets and obstacles each level after it brings */
+#define LEVEL_TARGETS 7
+#define LEVEL_OBSTACLES 7
+#define LEVEL_LIGHTS 2
+#define LEVEL_MORE_TARGETS 1
+#define LEVEL_MORE_OBSTACLES 1
+
+#define COMET_RADIUS 0.1
+#define COMET_START 5	// it comes in from the right
+#define COMET_GONE -4.5	// and leaves the board on the left
+
+/* Shots of the split-bird and volley power-ups */
+#define MAX_SHOTS 8192
+#define SHOT_RADIUS 0.03
+#define SHOT_CHUNK 256		// shots per job of the worker threads
+#define SPLIT_SPREAD 30		// degrees to either side of its heading the bird splits over
+
+/* What a shot ran into in the last step, when it is not a collider index */
+enum ShotOutcome { SHOT_FLYING = -1, SHOT_GONE = -2 };
+#define SHOT_BLOCK MAX_ENTITIES		// from it on, SHOT_BLOCK + the block it ran into
+#define SHOT_SWARM (SHOT_BLOCK + MAX_BLOCKS + 3)	// from it on, SHOT_SWARM + the agent of the swarm
+
+/* Towers of blocks: towerBlocks bricks spread over TOWERS towers of TOWER_COLUMNS, in courses
+   offset by half a brick, with a course of planks every PLANK_COURSES */
+#define MAX_BLOCKS 4096
+#define TOWERS 6
+#define TOWER_COLUMNS 16
+#define PLANK_COURSES 8
+#define PLANK_BRICKS 4		// bricks a plank is as long as
+#define TOWERS_LEFT -2.6
+#define TOWERS_RIGHT 3.6
+#define BLOCK_WIDTH 0.06
+#define BLOCK_HEIGHT 0.03
+#define BLOCK_FRICTION 0.6
+/* What the bird and the shots weigh against a brick, which weighs BLOCK_WIDTH*BLOCK_HEIGHT */
+#define BIRD_MASS 0.005
+#define SHOT_MASS 0.0005
+
+/* A shattered obstacle's pieces fly apart at DEBRIS_BURST, carrying DEBRIS_KICK of the
+   velocity of what hit it, and spin at up to DEBRIS_SPIN degrees per second */
+#define DEBRIS_BURST 0.6
+#define DEBRIS_KICK 0.3
+#define DEBRIS_SPIN 360
+
+/* Gravity wells: WELL_PLANETS planets, and moons around them for the rest of wellCount.
+   They pull the shots, the debris and a bird whose flight is integrated. */
+#define MAX_WELLS 4096
+#define WELL_PLANETS 3
+#define PLANET_MASS 0.5
+#define PLANET_RADIUS 0.3
+#define MOON_MASS 0.002
+#define MOON_RADIUS 0.03
+
+/* The force field of a level, over the area of the collision grid: a wind that blows
+   from the left, not at all or from the right by level, FORCE_VORTICES swirls and an
+   updraft. Like the wells it pulls the shots, the debris and an integrated bird. */
+#define MAX_FORCE_CELLS 1024	// per side
+#define WIND_SPEED 0.15
+#define FORCE_VORTICES 2
+#define VORTEX_STRENGTH 0.8
+#define VORTEX_SIZE 0.6
+#define UPDRAFT_STRENGTH 0.5
+#define UPDRAFT_WIDTH 0.3
+
+/* Swarms of swarmSize agents in SWARM_CLOUDS clouds of SWARM_SPREAD across, every other
+   one of gnats and of hornets. They chase the flying bird, which they hurt like Varys
+   does, and a shot kills the agent it hits for SWARM_SCORE. */
+#define MAX_SWARM 16384
+#define SWARM_CLOUDS 4
+#define SWARM_SPREAD 1.2
+#define SWARM_SCORE 1
+enum SwarmType { SWARM_GNATS, SWARM_HORNETS };
+
+/* Chasers: chaserCount hazards like Varys that make for the flying bird along a flow field
+   of FLOW_CELLS by FLOW_CELLS cells over the field, around the obstacles and CHASE_MARGIN
+   clear of them; while the bird is not flying they wait CHASE_HOLD from it */
+#define MAX_CHASERS 1024
+#define FLOW_CELLS 64
+#define FLOW_BUDGET 1024	// cells the search settles per step
+#define CHASE_SPEED 0.03	// per step
+#define CHASE_TURN 10		// degrees per step
+#define CHASE_RADIUS 0.15
+#define CHASE_MARGIN 0.1
+#define CHASE_HOLD 1.5
+
+/* Where the centre of the bird bounces off the borders of the field */
+#define FIELD_LEFT -3.65
+#define FIELD_RIGHT 3.65
+#define FIELD_ROOF 3.6
+#define FIELD_FLOOR -3.6
+
+/* What a shape of the level geometry is; borders have no entity */
+enum GeometryTag { GEOMETRY_LEFT, GEOMETRY_RIGHT, GEOMETRY_ROOF, GEOMETRY_FLOOR, GEOMETRY_OBSTACLE, GEOMETRY_PORTAL };
+
+extern float gravity, airDrag, friction, groundDrag;
+/* How the bird flies, by default the closed form trajectory */
+extern FlightParams flight;
+
+/* Entity handles: the slot in the low ENTITY_SLOT_BITS, the generation of the slot above.
+   A slot gets a new generation each time it is freed, so a handle kept after its entity
+   was despawned never matches the entity that reuses the slot. */
+typedef unsigned int Entity;
+
+#define ENTITY_SLOT_BITS 12
+#define MAX_ENTITIES (1 << ENTITY_SLOT_BITS)
+#define NO_ENTITY 0xffffffffu
+
+inline int entitySlot(Entity e){
+	return e & (MAX_ENTITIES - 1);
+}
+inline unsigned int entityGeneration(Entity e){
+	return e >> ENTITY_SLOT_BITS;
+}
+
+/* Hands out entity handles from MAX_ENTITIES slots, freed slots are used again first.
+   All the memory is taken up front, spawning and despawning never allocate. */
+struct EntityPool {
+	std::vector<unsigned int> generation;
+	std::vector<int> freeSlots;
+	int used;		// slots handed out at least once
+
+	EntityPool(){
+		generation.assign(MAX_ENTITIES, 0);
+		freeSlots.reserve(MAX_ENTITIES);
+		used = 0;
+	}
+	/* NO_ENTITY when all the slots are taken */
+	Entity create(){
+		int slot;
+		if(!freeSlots.empty()){
+			slot = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else if(used < MAX_ENTITIES)
+			slot = used++;
+		else
+			return NO_ENTITY;
+		return generation[slot] << ENTITY_SLOT_BITS | slot;
+	}
+	void destroy(Entity e){
+		int slot = entitySlot(e);
+		// Wraps before the generation of NO_ENTITY
+		generation[slot] = (generation[slot] + 1) % ((1u << (32 - ENTITY_SLOT_BITS)) - 1);
+		freeSlots.push_back(slot);
+	}
+	bool alive(Entity e){
+		return e != NO_ENTITY && generation[entitySlot(e)] == entityGeneration(e);
+	}
+	int count(){
+		return used - freeSlots.size();
+	}
+};
+
+/* Components of one type, packed so that systems walk them linearly: data[i] belongs to
+   entity owner[i], index[slot] is where the entity in that slot has its component or -1.
+   Room for MAX_ENTITIES is reserved up front, so adding and removing never allocate. */
+template <class T> struct ComponentArray {
+	std::vector<T> data;
+	std::vector<Entity> owner;
+	std::vector<int> index;
+
+	ComponentArray(){
+		data.reserve(MAX_ENTITIES);
+		owner.reserve(MAX_ENTITIES);
+		index.assign(MAX_ENTITIES, -1);
+	}
+	T& add(Entity e, const T& component){
+		index[entitySlot(e)] = data.size();
+		data.push_back(component);
+		owner.push_back(e);
+		return data.back();
+	}
+	/* The last component takes the free slot, so the order of the others changes */
+	void remove(Entity e){
+		int i = index[entitySlot(e)];
+		data[i] = data.back();
+		owner[i] = owner.back();
+		index[entitySlot(owner[i])] = i;
+		data.pop_back();
+		owner.pop_back();
+		index[entitySlot(e)] = -1;
+	}
+	bool has(Entity e){
+		if(e == NO_ENTITY)
+			return false;
+		int i = index[entitySlot(e)];
+		return i >= 0 && owner[i] == e;
+	}
+	T& get(Entity e){
+		return data[index[entitySlot(e)]];
+	}
+	int size(){
+		return data.size();
+	}
+};
+
+/* Position and orientation, with the state of the step before to draw in between */
+struct Transform {
+	float x, y;
+	float prevx, prevy;
+	float rotation, prevRotation;	// degrees
+	float scale, prevScale;
+};
+
+enum CollisionResponse { COLLIDE_SCORE, COLLIDE_BOUNCE, COLLIDE_HAZARD, COLLIDE_PICKUP, COLLIDE_LIFE };
+
+/* Circle the bird collides with, centred on the transform */
+struct Collider {
+	float radius;
+	int response;
+	bool collided;	// scored, or bird still inside after a bounce
+	int pass;	// last collide() that tested it; if older than the one before, the bird has not been inside since
+};
+
+/* An obstacle that is hit with shattering on, and the velocity of what hit it */
+struct ObstacleBreak {
+	Entity obstacle;
+	float vx, vy;
+};
+
+/* A planet, or a moon going round one on a circle */
+struct Well {
+	float x, y, prevx, prevy;
+	float mass, radius;
+	int planet;		// of a moon, -1 for a planet
+	float distance, angle;	// from the planet
+	float speed;		// radians per second, counterclockwise
+};
+
+/* Also the drawing order, later kinds are drawn over earlier ones */
+enum MeshKind { MESH_STAR, MESH_TARGET, MESH_OBSTACLE, MESH_LIGHT, MESH_VARYS, MESH_COMET, MESH_KINDS };
+
+/* What the renderer draws for the entity, at size times the transform scale */
+struct RenderMesh {
+	int mesh;
+	int variant;
+	float size;
+	bool visible;
+};
+
+enum AnimationType { ANIM_BOB, ANIM_SPIN, ANIM_PATROL, ANIM_TWINKLE, ANIM_FLY, ANIM_CHASE };
+
+struct Animation {
+	int type;
+	float speed;	// per step: units for ANIM_BOB, ANIM_PATROL and ANIM_FLY, degrees for ANIM_SPIN
+	int dir;
+	int up;
+	int count;
+	bool shrink;	// ANIM_BOB: scale down to nothing, then despawn
+};
+
+enum PickupEffect { PICKUP_IMMUNITY };
+
+struct Pickup {
+	int effect;
+};
+
+class Portal{
+	public:
+		float posx;
+		float posy;
+		float radius;
+		float center[2];
+		Portal(){
+			posx = 3.2;
+			posy = 1.5;
+			radius = 0.4;
+			center[0]=posx;
+			center[1]=posy;
+		}
+		void place(float x,float y){
+			posx = center[0] = x;
+			posy = center[1] = y;
+		}
+};
+
+/* The flight of the bird in fixed point, what FLIGHT_FIXED works on; the float state of
+   the bird is only set from it */
+struct FixedFlight {
+	fixed initX, initY;
+	fixed posx, posy;
+	fixed vel, theta;
+	fixed t;
+};
+
+class Bird{
+	int lives;
+	int score;
+	float posx;
+	float posy;
+	float vel;
+	float theta;
+	bool isMoving;
+	float radius;
+
+	void syncFixed();
+	fixed reboundFixed(bool anchor);
+	void updateFixed();
+	public:
+	bool immune;
+	int immuneCount;	// steps since the bird became immune
+	bool pause;
+	int hit;
+	bool allowed;
+	float center[2];
+	float initX;
+	float initY;
+	float t;	// time since the launch or the last bounce, the trajectory starts again from initX/initY
+	Vec2 velocity;	// when the flight is integrated, see flight
+	FixedFlight fixedFlight;
+	float prevx;
+	float prevy;
+	float rotation;
+	float prevRotation;
+	bool floor;
+	bool flag;
+	int dir;
+	bool split;	// split into a volley on this flight
+	Bird(){
+		immune=false;
+		immuneCount=0;
+		lives = 3;
+		score = 0;
+		allowed=true;
+		isMoving = false;
+		vel = 1.2;
+		theta = 45;
+		posx = 0;
+		posy = 0;
+		radius = 0.12;
+		initX = -3.5;
+		initY = 0;
+		t = 0;
+		center[0] = 0.05 + initX;
+		center[1] = 0 + initY;
+		prevx = initX;
+		prevy = initY;
+		velocity = vec2(0, 0);
+		fixedFlight.initX = fixedFlight.initY = fixedFlight.posx = fixedFlight.posy = 0;
+		fixedFlight.vel = fixedFlight.theta = fixedFlight.t = 0;
+		rotation = prevRotation = 0;
+		floor = false;
+		flag = true;
+		dir = 1;
+		split = false;
+		hit=0;
+		pause=false;
+	}
+
+	float getLives(){
+		return lives;
+	}
+	float getScore(){
+		return score;
+	}
+	float getX(){
+		return posx;
+	}
+	float getY(){
+		return posy;
+	}
+	float getVel(){
+		return vel;
+	}
+	float getAngle(){
+		return theta;
+	}
+	float getStatus(){
+		return isMoving;
+	}
+	float *getCenter(){
+		return center;
+	}
+	float getRadius(){
+		return radius;
+	}
+
+	void setStatus(bool st){
+		isMoving = st;
+	}
+
+	void setLives(float l){
+		lives = l;
+	}
+	void setScore(float s){
+		score = s;
+	}
+	void setX(float x){
+		posx = x;
+	}
+	void setY(float y){
+		posy = y;
+	}
+	void setVel(float v){
+		vel = v;
+	}
+	void setAngle(float ang){
+		theta = ang;
+	}
+	void setCenter(float cx,float cy){
+		center[0] = cx;
+		center[1] = cy;
+	}
+	void setRadius(float r){
+		radius = r;
+	}
+
+	/* Must be called before the collision checks, which move initX/initY */
+	void savePrevious(){
+		prevx = initX + posx;
+		prevy = initY + posy;
+		prevRotation = rotation;
+	}
+
+	bool touches(float cx, float cy, float r);
+	void moveTo(float x, float y);
+	void reset();
+	void launch();
+	void update();
+	void flyTo(float time);
+	void motion(float& vx, float& vy, float& ax, float& ay);
+	void checkPortal(Portal portal[2]);
+	/* Bounce off the obstacle at cx, cy, touching tells whether the bird overlaps it */
+	void checkObstacle(bool touching, bool& collided, float cx, float cy);
+	void bounceRoof();
+	void bounceWall(bool right);
+	void land();
+};
+
+/* What can be done with the bird before it is launched, and once it flies CONTROL_RESOLVE and CONTROL_SPLIT */
+enum GameControl { CONTROL_FASTER, CONTROL_SLOWER, CONTROL_AIM_DOWN, CONTROL_AIM_UP, CONTROL_LAUNCH, CONTROL_RAISE, CONTROL_LOWER, CONTROL_RESOLVE, CONTROL_SPLIT };
+
+/* Most impacts, and steps, resolveShot() goes through before it leaves the rest to step() */
+#define SHOT_EVENTS 1000
+#define SHOT_STEPS 20000
+
+enum ShotEventType { EVENT_LEFT, EVENT_RIGHT, EVENT_ROOF, EVENT_FLOOR, EVENT_COLLIDER, EVENT_PORTAL };
+
+/* The next thing the flying bird runs into */
+struct ShotEvent {
+	int type;
+	float time;	// from now
+	int index;	// EVENT_COLLIDER: the collider, EVENT_PORTAL: the portal
+};
+
+class Game{
+	EntityPool entities;
+	std::vector<Entity> dying;	// despawned at the end of the step
+	SpatialGrid grid;	// the moving colliders by collider index, rebuilt for each collide()
+	std::vector<int> shapesFound;
+	std::vector<int> candidates;	// colliders near the bird
+	CircleSet circles;	// the candidates, in the same order
+	int collidePasses;
+	float sweepFrom[2];	// centre of the bird at the last collision checks
+	float worldLag;		// how far the bird is ahead of the last step of the world, in resolveShot()
+	bool paused;		// animations stopped
+	SpatialGrid shotGrid;	// the colliders shots run into, grown by SHOT_RADIUS
+	std::vector<int> shotHits;	// per shot: the collider it ran into, or a ShotOutcome
+	std::vector<int> blocksFound;
+	bool blockBounce;	// the bird touched a block the step before
+	std::vector<ObstacleBreak> breaking;	// shattered at the end of the step
+
+	Entity spawn(float x, float y);
+	void despawnDying();
+	void initLevel();
+	void nextLevel();
+	void newGame();
+	void pauseGame(bool play);
+	void buildGeometry();
+	void buildGrid();
+	void sweepBird();
+	int bordersReached();
+	void collide();
+	void collideFrom(int first);
+	bool respond(int i, bool touching);
+	void scoreTarget(int i);
+	void birdVelocity(float& vx, float& vy);
+	void splitBird();
+	void buildTowers();
+	void hitBlocks();
+	void breakObstacle(Entity e, float vx, float vy);
+	void shatterObstacles();
+	void buildWells();
+	void moveWells();
+	void buildForces();
+	void applyForces();
+	void buildSwarm();
+	void moveSwarm();
+	void hitSwarm();
+	void spawnChasers();
+	void blockFlow();
+	void moveFlow();
+	void chase(Transform& transform, Animation& animation);
+	void updateShots();
+	int shotHit(float x, float y);
+	static void updateShotChunk(void* game, int chunk);
+	void animate();
+	void savePrevious();
+	void tick();
+	void advanceWorld(int steps);
+	bool colliderVelocity(int i, float& vx, float& vy);
+	float motionHorizon();
+	float worldClearance();
+	bool inObstacle();
+
+	public:
+	Bird angryBird;
+	Portal portal[2];
+	Entity comet;		// NO_ENTITY while there is none
+	StaticBVH geometry;	// borders, obstacles and portals of the level, for queries
+	float cometY;		// height of the comet of this level
+
+	ComponentArray<Transform> transforms;
+	ComponentArray<Collider> colliders;
+	ComponentArray<RenderMesh> meshes;
+	ComponentArray<Animation> animations;
+	ComponentArray<Pickup> pickups;
+	int targets;		// spawned this level, it is won when they are all hit
+
+	ProjectileSet shots;	// split-bird and volley shots, in flight
+	std::vector<float> shotPrevx, shotPrevy;	// where they were the step before
+	int volleySize;		// shots the bird splits into, 0 without the power-up
+	WorkerPool* workers;	// for the shots and the blocks, NULL to do everything on the calling thread; copies share it
+	RigidWorld blocks;	// the towers, and the floor and walls they stand between
+	int towerBlocks;	// bricks the levels are built with, 0 for none
+	bool shatter;		// obstacles break when hit
+	DebrisPool debris;	// of the obstacles that broke
+	int wellCount;		// planets and moons the levels have, 0 for none
+	std::vector<Well> wells;
+	GravityTree wellTree;	// over the wells where they are now
+	int forceCells;		// per side of the force field, 0 for none
+	ForceField forces;
+	int swarmSize;		// agents of the swarms the levels have, 0 for none
+	Flock swarm;
+	int chaserCount;	// chasers the levels have, 0 for none
+	FlowField flow;		// to the bird, for the chasers
+
+	int level;
+	bool levelUp;		// level won or lost, waiting for accept()
+	bool goNext;
+	bool pressNext;		// aiming with the mouse
+	bool on;		// not paused
+	int counter,counter1;
+	int num;		// step of the level the comet comes in at
+	float deltaTime;	// simulated time since the start
+	unsigned long long tickHash;	// with FLIGHT_FIXED, of the states after all the steps so far
+
+	Game();
+
+	/* Place the first level */
+	void start();
+	/* Advance the game by one fixed step of SIM_DT seconds */
+	void step();
+	/* Event driven instead of stepped: the first impact of the flying bird within horizon
+	   seconds, solved for on its trajectory */
+	bool nextEvent(float horizon, ShotEvent& event);
+	/* Fly the bird straight from one impact to the next until the shot is over, or until
+	   maxEvents impacts, stepping only where the rules are per step; returns how many
+	   impacts there were */
+	int resolveShot(int maxEvents);
+	/* count shots from x, y at speed, fanned evenly over angle +- spread degrees; returns how
+	   many there was room for */
+	int fireVolley(float x, float y, float speed, float angle, float spread, int count);
+	/* Whether the wells and the force field pull the bird, which needs an integrated flight */
+	bool birdFeelsForces();
+	/* For the aim preview: where the bird launched as aimed now is after each of n
+	   intervals, flown the way it will fly with the wells standing where they are and
+	   the force field */
+	void aimPath(float interval, int n, float* x, float* y);
+
+	/* Input, applied between two steps */
+	void control(int action);
+	void togglePause();
+	void grab(bool pressed);
+	void aim(float angle);
+	void accept();
+
+	float getScore(){
+		return angryBird.getScore();
+	}
+	int getLevel(){
+		return level;
+	}
+	/* Hash of the state of the game, to check that two runs went the same */
+	unsigned long long stateHash(unsigned long long hash);
+
+	/* Out of lives or all the targets hit */
+	bool isOver(){
+		return angryBird.getLives() <= 0 || angryBird.hit == targets;
+	}
+
+	Entity spawnStar(float x, float y, int variant);
+	Entity spawnTarget();
+	Entity spawnObstacle();
+	Entity spawnLight();
+	Entity spawnVarys(float x, float y);
+	Entity spawnComet(float x, float y);
+	Entity spawnChaser(float x, float y);
+	/* Remove the entity and all its components, its handle is no longer alive */
+	void despawn(Entity e);
+	bool alive(Entity e){
+		return entities.alive(e);
+	}
+	/* Entities of each kind the level starts with; the lights are the same on every level */
+	int levelTargets(int lvl){
+		return LEVEL_TARGETS + (lvl-1)*LEVEL_MORE_TARGETS;
+	}
+	int levelObstacles(int lvl){
+		return LEVEL_OBSTACLES + (lvl-1)*LEVEL_MORE_OBSTACLES;
+	}
+	int levelLights(){
+		return LEVEL_LIGHTS;
+	}
+};
+
+#endif
@@ -0,0 +1,263 @@
+#include <cmath>
+#include <algorithm>
+#include "bvh.h"
+#include "collide.h"
+
+using namespace std;
+
+#define BVH_LEAF_SHAPES 2
+
+StaticBVH::StaticBVH()
+{
+}
+
+void StaticBVH::reserve(int n)
+{
+	shapes.reserve(n);
+	nodes.reserve(2*n);
+	stack.reserve(64);
+}
+
+void StaticBVH::clear()
+{
+	shapes.clear();
+	nodes.clear();
+}
+
+int StaticBVH::addCircle(float x, float y, float r, int tag, unsigned int id)
+{
+	StaticShape s = { SHAPE_CIRCLE, x-r, y-r, x+r, y+r, x, y, r, tag, id };
+	shapes.push_back(s);
+	return shapes.size() - 1;
+}
+
+int StaticBVH::addBox(float x0, float y0, float x1, float y1, int tag, unsigned int id)
+{
+	StaticShape s = { SHAPE_BOX, x0, y0, x1, y1, (x0+x1)/2, (y0+y1)/2, 0, tag, id };
+	shapes.push_back(s);
+	return shapes.size() - 1;
+}
+
+struct CentreLess {
+	int axis;
+	bool operator()(const StaticShape& a, const StaticShape& b) const {
+		return axis ? a.y0 + a.y1 < b.y0 + b.y1 : a.x0 + a.x1 < b.x0 + b.x1;
+	}
+};
+
+/* Top down, splitting at the median centre along the longer side. The children of a
+   node are next to each other, so only the first one is stored. */
+void StaticBVH::buildNode(int n, int first, int count)
+{
+	int i;
+	BVHNode node = { shapes[first].x0, shapes[first].y0, shapes[first].x1, shapes[first].y1, 0, first, count };
+	for(i=first+1;i<first+count;i++){
+		node.x0 = min(node.x0, shapes[i].x0);
+		node.y0 = min(node.y0, shapes[i].y0);
+		node.x1 = max(node.x1, shapes[i].x1);
+		node.y1 = max(node.y1, shapes[i].y1);
+	}
+	if(count > BVH_LEAF_SHAPES){
+		CentreLess less;
+		less.axis = node.y1 - node.y0 > node.x1 - node.x0;
+		int half = count/2;
+		nth_element(shapes.begin()+first, shapes.begin()+first+half, shapes.begin()+first+count, less);
+		node.left = nodes.size();
+		node.count = 0;
+		nodes.resize(nodes.size() + 2);
+		buildNode(node.left, first, half);
+		buildNode(node.left+1, first+half, count-half);
+	}
+	nodes[n] = node;
+}
+
+void StaticBVH::build()
+{
+	nodes.clear();
+	if(shapes.empty())
+		return;
+	nodes.resize(1);
+	buildNode(0, 0, shapes.size());
+}
+
+static bool boxContains(float x0, float y0, float x1, float y1, float x, float y)
+{
+	return x >= x0 && x <= x1 && y >= y0 && y <= y1;
+}
+
+int StaticBVH::queryPoint(float x, float y, vector<int>& out)
+{
+	out.clear();
+	if(nodes.empty())
+		return 0;
+	stack.clear();
+	stack.push_back(0);
+	while(!stack.empty()){
+		BVHNode& node = nodes[stack.back()];
+		stack.pop_back();
+		if(!boxContains(node.x0, node.y0, node.x1, node.y1, x, y))
+			continue;
+		if(!node.count){
+			stack.push_back(node.left);
+			stack.push_back(node.left+1);
+			continue;
+		}
+		for(int i=node.first;i<node.first+node.count;i++){
+			StaticShape& s = shapes[i];
+			if(s.kind == SHAPE_BOX ? boxContains(s.x0, s.y0, s.x1, s.y1, x, y) : (x-s.x)*(x-s.x) + (y-s.y)*(y-s.y) <= s.r*s.r)
+				out.push_back(i);
+		}
+	}
+	return out.size();
+}
+
+static bool overlaps(const StaticShape& s, float x, float y, float r)
+{
+	float dx, dy, reach;
+	if(s.kind == SHAPE_BOX){
+		dx = x - min(max(x, s.x0), s.x1);
+		dy = y - min(max(y, s.y0), s.y1);
+		reach = r;
+	}
+	else{
+		dx = x - s.x;
+		dy = y - s.y;
+		reach = r + s.r;
+	}
+	return dx*dx + dy*dy <= reach*reach;
+}
+
+int StaticBVH::queryCircle(float x, float y, float r, vector<int>& out)
+{
+	out.clear();
+	if(nodes.empty())
+		return 0;
+	stack.clear();
+	stack.push_back(0);
+	while(!stack.empty()){
+		BVHNode& node = nodes[stack.back()];
+		stack.pop_back();
+		if(!boxContains(node.x0 - r, node.y0 - r, node.x1 + r, node.y1 + r, x, y))
+			continue;
+		if(!node.count){
+			stack.push_back(node.left);
+			stack.push_back(node.left+1);
+			continue;
+		}
+		for(int i=node.first;i<node.first+node.count;i++)
+			if(overlaps(shapes[i], x, y, r))
+				out.push_back(i);
+	}
+	return out.size();
+}
+
+/* Ray against the box, slab method: the range of t inside it, false when it is empty */
+static bool rayBox(float ox, float oy, float dx, float dy, float x0, float y0, float x1, float y1, float& tmin, float& tmax)
+{
+	float o[2] = { ox, oy }, d[2] = { dx, dy }, lo[2] = { x0, y0 }, hi[2] = { x1, y1 };
+	for(int a=0;a<2;a++){
+		if(d[a] == 0){
+			if(o[a] < lo[a] || o[a] > hi[a])
+				return false;
+			continue;
+		}
+		float t0 = (lo[a] - o[a]) / d[a], t1 = (hi[a] - o[a]) / d[a];
+		if(t0 > t1)
+			swap(t0, t1);
+		tmin = max(tmin, t0);
+		tmax = min(tmax, t1);
+		if(tmin > tmax)
+			return false;
+	}
+	return true;
+}
+
+/* Against a box the moving circle sweeps the box grown by r with rounded corners */
+bool StaticBVH::sweepShape(const StaticShape& s, float ox, float oy, float r, float dx, float dy, float maxT, bool entering, RayHit& hit)
+{
+	float t, cx, cy;
+	if(entering && overlaps(s, ox, oy, r))
+		return false;
+	if(s.kind == SHAPE_CIRCLE){
+		if(!circleTimeOfImpact(ox, oy, dx, dy, s.x, s.y, s.r + r, maxT, t))
+			return false;
+		cx = s.x;
+		cy = s.y;
+	}
+	else{
+		float best = maxT;
+		bool found = false;
+		float tmin, tmax;
+		tmin = 0; tmax = maxT;
+		if(rayBox(ox, oy, dx, dy, s.x0 - r, s.y0, s.x1 + r, s.y1, tmin, tmax)){
+			best = tmin;
+			found = true;
+		}
+		tmin = 0; tmax = best;
+		if(rayBox(ox, oy, dx, dy, s.x0, s.y0 - r, s.x1, s.y1 + r, tmin, tmax)){
+			best = tmin;
+			found = true;
+		}
+		float corners[4][2] = { {s.x0, s.y0}, {s.x1, s.y0}, {s.x0, s.y1}, {s.x1, s.y1} };
+		for(int k=0;k<4;k++){
+			if(circleTimeOfImpact(ox, oy, dx, dy, corners[k][0], corners[k][1], r, best, t) && t <= best){
+				best = t;
+				found = true;
+			}
+		}
+		if(!found)
+			return false;
+		t = best;
+		cx = min(max(ox + t*dx, s.x0), s.x1);
+		cy = min(max(oy + t*dy, s.y0), s.y1);
+	}
+	if(t > hit.t)
+		return false;
+	hit.t = t;
+	float nx = ox + t*dx - cx, ny = oy + t*dy - cy, len = sqrt(nx*nx + ny*ny);
+	if(len > 0){
+		hit.nx = nx/len;
+		hit.ny = ny/len;
+	}
+	else{
+		len = sqrt(dx*dx + dy*dy);
+		hit.nx = len > 0 ? -dx/len : 0;
+		hit.ny = len > 0 ? -dy/len : 0;
+	}
+	return true;
+}
+
+bool StaticBVH::sweepCircle(float ox, float oy, float r, float dx, float dy, float maxT, RayHit& hit, bool entering)
+{
+	bool found = false;
+	hit.t = maxT;
+	hit.shape = -1;
+	if(nodes.empty())
+		return false;
+	stack.clear();
+	stack.push_back(0);
+	while(!stack.empty()){
+		BVHNode& node = nodes[stack.back()];
+		stack.pop_back();
+		float tmin = 0, tmax = hit.t;
+		if(!rayBox(ox, oy, dx, dy, node.x0 - r, node.y0 - r, node.x1 + r, node.y1 + r, tmin, tmax))
+			continue;
+		if(!node.count){
+			stack.push_back(node.left);
+			stack.push_back(node.left+1);
+			continue;
+		}
+		for(int i=node.first;i<node.first+node.count;i++){
+			if(sweepShape(shapes[i], ox, oy, r, dx, dy, hit.t, entering, hit)){
+				hit.shape = i;
+				found = true;
+			}
+		}
+	}
+	return found;
+}
+
+bool StaticBVH::raycast(float ox, float oy, float dx, float dy, float maxT, RayHit& hit)
+{
+	return sweepCircle(ox, oy, 0, dx, dy, maxT, hit);
+}
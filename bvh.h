@@ -0,0 +1,70 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <vector>
+
+enum ShapeKind { SHAPE_CIRCLE, SHAPE_BOX };
+
+/* A piece of level geometry that does not move while the level is played */
+struct StaticShape {
+	int kind;
+	float x0, y0, x1, y1;	// the box, or the bounds of the circle
+	float x, y, r;		// SHAPE_CIRCLE
+	int tag;		// what kind of thing the shape is and which one, for the caller
+	unsigned int id;
+};
+
+/* Leaves hold shapes first .. first+count-1, inner nodes have count 0 and their
+   children at left and left+1 */
+struct BVHNode {
+	float x0, y0, x1, y1;
+	int left;
+	int first, count;
+};
+
+struct RayHit {
+	float t;	// along the direction, which need not be normalized
+	int shape;
+	float nx, ny;	// unit normal of the shape where it was hit
+};
+
+/* Bounding volume hierarchy over the static shapes of a level, built once when the
+   level is loaded. Queries visit only the nodes whose boxes they touch, so they take
+   logarithmic time in the number of shapes. Shape indices returned by the queries
+   refer to shape(), which is in tree order after build(). */
+class StaticBVH {
+	std::vector<StaticShape> shapes;
+	std::vector<BVHNode> nodes;
+	std::vector<int> stack;
+
+	void buildNode(int n, int first, int count);
+	bool sweepShape(const StaticShape& s, float ox, float oy, float r, float dx, float dy, float maxT, bool entering, RayHit& hit);
+
+	public:
+	StaticBVH();
+	void reserve(int n);
+	void clear();
+	int addCircle(float x, float y, float r, int tag, unsigned int id);
+	int addBox(float x0, float y0, float x1, float y1, int tag, unsigned int id);
+	void build();
+
+	int size(){
+		return shapes.size();
+	}
+	StaticShape& shape(int i){
+		return shapes[i];
+	}
+
+	/* The shapes containing the point, boxes include their edges */
+	int queryPoint(float x, float y, std::vector<int>& out);
+	/* The shapes the circle overlaps */
+	int queryCircle(float x, float y, float r, std::vector<int>& out);
+	/* The first shape hit by o + t*d with 0 <= t <= maxT */
+	bool raycast(float ox, float oy, float dx, float dy, float maxT, RayHit& hit);
+	/* The first shape a circle of radius r moving along o + t*d touches, t = 0 when it
+	   already overlaps one. With entering, shapes it overlaps at the start are skipped,
+	   only those it runs into count. */
+	bool sweepCircle(float ox, float oy, float r, float dx, float dy, float maxT, RayHit& hit, bool entering = false);
+};
+
+#endif
@@ -0,0 +1,578 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstdarg>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "collide.h"
+#include "bvh.h"
+#include "angrysim.h"
+
+using namespace std;
+
+/* Compares the SIMD kernels and the accelerated queries of the simulation with plain
+   loops over random inputs, the game played with and without workers, and the comet
+   crossing the field. make check builds it once per instruction set; it prints what
+   differs and fails. */
+
+#define CHECK_ROUNDS 200
+/* Comparisons this close to the edge are left out, fused multiply-adds may tip them */
+#define CHECK_MARGIN 1e-4f
+
+static int failures;
+
+static void fail(const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	if(failures < 20){
+		vfprintf(stdout, format, args);
+		printf("\n");
+	}
+	va_end(args);
+	failures++;
+}
+
+/* Uniform in [lo, hi) */
+static float uniform(float lo, float hi)
+{
+	return lo + (hi - lo)*(rand()/(RAND_MAX + 1.0f));
+}
+
+/* Every lane width against the plain test, with counts around the lanes and a set that
+   held more circles before, whose stale lanes must not hit */
+static void checkCircleSet()
+{
+	int round, i;
+	CircleSet set;
+	for(round=0;round<CHECK_ROUNDS;round++){
+		int n = rand()%(3*CIRCLE_LANES + 40);
+		if(round%4 == 0){
+			set.clear();
+			for(i=0;i<n + 2*CIRCLE_LANES;i++)
+				set.add(0, 0, 10);
+		}
+		set.clear();
+		for(i=0;i<n;i++)
+			set.add(uniform(-4, 4), uniform(-4, 4), uniform(0, 0.5));
+		float cx = uniform(-4, 4), cy = uniform(-4, 4), cr = uniform(0, 2);
+		int overlaps = set.overlap(cx, cy, cr), expected = 0, unsure = 0;
+		for(i=0;i<n;i++){
+			float dx = set.x[i] - cx, dy = set.y[i] - cy, s = set.r[i] + cr;
+			float d2 = dx*dx + dy*dy;
+			if(fabs(d2 - s*s) <= CHECK_MARGIN*s*s){
+				unsure++;
+				expected += set.hit(i);
+				continue;
+			}
+			expected += d2 <= s*s;
+			if(set.hit(i) != (d2 <= s*s))
+				fail("CircleSet::overlap: circle %d of %d is %s", i, n, set.hit(i) ? "hit" : "missed");
+		}
+		if(overlaps != expected)
+			fail("CircleSet::overlap: %d overlaps of %d, the loop finds %d", overlaps, n, expected);
+	}
+}
+
+/* The cell of a coordinate as SpatialGrid puts it, clamped to the border cells */
+static int referenceCell(float v)
+{
+	int c = (int)floor((v - GRID_MIN)/(GRID_MAX - GRID_MIN)*GRID_CELLS);
+	return min(max(c, 0), GRID_CELLS - 1);
+}
+
+/* Each item whose cells the circle's cells meet, in ascending order and once, and so
+   every item the circle overlaps; some reach past the grid into the border cells */
+static void checkSpatialGrid()
+{
+	int round, i, k;
+	SpatialGrid grid;
+	vector<int> found;
+	vector<float> x, y, r;
+	grid.reserve(300);
+	for(round=0;round<CHECK_ROUNDS;round++){
+		int n = rand()%300;
+		grid.clear();
+		x.resize(n);
+		y.resize(n);
+		r.resize(n);
+		for(i=0;i<n;i++){
+			x[i] = uniform(-5, 5);
+			y[i] = uniform(-5, 5);
+			r[i] = uniform(0, 1);
+			grid.add(i, x[i], y[i], r[i]);
+		}
+		grid.build();
+		float qx = uniform(-5, 5), qy = uniform(-5, 5), qr = uniform(0, 2);
+		grid.query(qx, qy, qr, found);
+		for(k=1;k<(int)found.size();k++)
+			if(found[k-1] >= found[k])
+				fail("SpatialGrid::query: ids %d, %d out of order", found[k-1], found[k]);
+		for(i=0,k=0;i<n;i++){
+			bool meet = referenceCell(x[i] - r[i]) <= referenceCell(qx + qr) && referenceCell(qx - qr) <= referenceCell(x[i] + r[i])
+				&& referenceCell(y[i] - r[i]) <= referenceCell(qy + qr) && referenceCell(qy - qr) <= referenceCell(y[i] + r[i]);
+			bool returned = k < (int)found.size() && found[k] == i;
+			if(returned)
+				k++;
+			if(meet != returned)
+				fail("SpatialGrid::query: item %d of %d %s", i, n, returned ? "returned, its cells are apart" : "left out");
+			float dx = x[i] - qx, dy = y[i] - qy;
+			if(!returned && dx*dx + dy*dy <= (r[i] + qr)*(r[i] + qr))
+				fail("SpatialGrid::query: item %d overlaps the circle and was left out", i);
+		}
+		if(k != (int)found.size())
+			fail("SpatialGrid::query: %d ids returned that were never added", (int)found.size() - k);
+	}
+}
+
+/* Against the roots of |o + t*d - c| = r in doubles; grazing paths and impacts right at
+   maxT are left out, rounding may decide those either way */
+static void checkTimeOfImpact()
+{
+	int round;
+	for(round=0;round<100*CHECK_ROUNDS;round++){
+		float ox = uniform(-4, 4), oy = uniform(-4, 4), dx = uniform(-8, 8), dy = uniform(-8, 8);
+		float cx = uniform(-4, 4), cy = uniform(-4, 4), r = uniform(0, 1), maxT = uniform(0, 1), t;
+		if(round%10 == 0)
+			dx = dy = 0;
+		double px = ox - cx, py = oy - cy;
+		double a = (double)dx*dx + (double)dy*dy, b = px*dx + py*dy, c = px*px + py*py - (double)r*r;
+		double expected = -1;
+		if(c <= 0)
+			expected = 0;
+		else if(a > 0 && b < 0 && b*b - a*c >= 0){
+			double disc = b*b - a*c;
+			if(disc <= 1e-4*b*b)
+				continue;
+			expected = (-b - sqrt(disc))/a;
+		}
+		if(fabs(c) <= CHECK_MARGIN || fabs(expected - maxT) <= CHECK_MARGIN)
+			continue;
+		bool hit = circleTimeOfImpact(ox, oy, dx, dy, cx, cy, r, maxT, t);
+		bool expectHit = expected >= 0 && expected <= maxT;
+		if(hit != expectHit)
+			fail("circleTimeOfImpact: %s, the roots say %g within %g", hit ? "hit" : "no hit", expected, maxT);
+		else if(hit && fabs(t - expected) > CHECK_MARGIN*(1 + expected))
+			fail("circleTimeOfImpact: at %g, the roots say %g", t, expected);
+	}
+}
+
+/* How far the point is outside the shape, negative inside a circle and 0 inside a box */
+static float shapeDistance(const StaticShape& s, float x, float y)
+{
+	if(s.kind == SHAPE_CIRCLE)
+		return sqrt((x - s.x)*(x - s.x) + (y - s.y)*(y - s.y)) - s.r;
+	float dx = x - min(max(x, s.x0), s.x1), dy = y - min(max(y, s.y0), s.y1);
+	return sqrt(dx*dx + dy*dy);
+}
+
+/* The tree's point and circle queries against testing every shape, and its sweeps
+   against sweeping a tree of each shape on its own; the shape hit must be touched at
+   the time given and not before it */
+static void checkBVH()
+{
+	int round, i, k, entering;
+	StaticBVH bvh;
+	vector<StaticBVH> alone;
+	vector<int> found;
+	for(round=0;round<CHECK_ROUNDS;round++){
+		int n = rand()%60 + 1;
+		bvh.clear();
+		alone.assign(n, StaticBVH());
+		for(i=0;i<n;i++){
+			float x = uniform(-4, 4), y = uniform(-4, 4);
+			if(rand()%2){
+				float r = uniform(0.05, 0.5);
+				bvh.addCircle(x, y, r, i, i);
+				alone[i].addCircle(x, y, r, i, i);
+			}
+			else{
+				float w = uniform(0.05, 1), h = uniform(0.05, 1);
+				bvh.addBox(x, y, x + w, y + h, i, i);
+				alone[i].addBox(x, y, x + w, y + h, i, i);
+			}
+			alone[i].build();
+		}
+		bvh.build();
+
+		float px = uniform(-4, 4), py = uniform(-4, 4), pr = uniform(0, 0.5);
+		vector<bool> in(n, false);
+		bvh.queryPoint(px, py, found);
+		for(k=0;k<(int)found.size();k++)
+			in[bvh.shape(found[k]).tag] = true;
+		for(i=0;i<n;i++){
+			float d = shapeDistance(alone[i].shape(0), px, py);
+			if(fabs(d) > CHECK_MARGIN && in[i] != (d <= 0))
+				fail("StaticBVH::queryPoint: shape %d of %d %s", i, n, in[i] ? "returned" : "left out");
+		}
+		in.assign(n, false);
+		bvh.queryCircle(px, py, pr, found);
+		for(k=0;k<(int)found.size();k++)
+			in[bvh.shape(found[k]).tag] = true;
+		for(i=0;i<n;i++){
+			float d = shapeDistance(alone[i].shape(0), px, py) - pr;
+			if(fabs(d) > CHECK_MARGIN && in[i] != (d <= 0))
+				fail("StaticBVH::queryCircle: shape %d of %d %s", i, n, in[i] ? "returned" : "left out");
+		}
+
+		float dx = uniform(-8, 8), dy = uniform(-8, 8), maxT = uniform(0.1, 1.5), r = rand()%3 ? uniform(0, 0.3) : 0;
+		for(entering=0;entering<2;entering++){
+			RayHit hit, best;
+			bool any = false;
+			best.t = maxT;
+			best.shape = -1;
+			for(i=0;i<n;i++){
+				if(alone[i].sweepCircle(px, py, r, dx, dy, best.t, hit, entering) && (!any || hit.t < best.t)){
+					best = hit;
+					best.shape = i;
+					any = true;
+				}
+			}
+			if(!r && entering)
+				continue;
+			bool swept = r ? bvh.sweepCircle(px, py, r, dx, dy, maxT, hit, entering) : bvh.raycast(px, py, dx, dy, maxT, hit);
+			if(swept != any){
+				fail("StaticBVH::sweepCircle: %s, sweeping every shape %s", swept ? "hit" : "no hit", any ? "hits" : "does not");
+				continue;
+			}
+			if(!swept)
+				continue;
+			int tag = bvh.shape(hit.shape).tag;
+			if(hit.t != best.t)
+				fail("StaticBVH::sweepCircle: shape %d at %g, sweeping every shape shape %d at %g", tag, hit.t, best.shape, best.t);
+			const StaticShape& s = alone[tag].shape(0);
+			float at = shapeDistance(s, px + hit.t*dx, py + hit.t*dy) - r;
+			if(hit.t > 0 && fabs(at) > 1e-3f)
+				fail("StaticBVH::sweepCircle: %g from shape %d at the time of the hit", at, tag);
+			for(k=0;k<64 && hit.t>0;k++){
+				float t = hit.t*k/64;
+				if(shapeDistance(s, px + t*dx, py + t*dy) - r < -1e-3f)
+					fail("StaticBVH::sweepCircle: shape %d touched at %g, before the hit at %g", tag, t, hit.t);
+			}
+		}
+	}
+}
+
+/* The sorted sweep of queryCircle() and firstTouching() against asking every moving
+   body, over a pile of boxes that fell and turned */
+static void checkRigidQueries()
+{
+	int round, i, k;
+	float px, py, nx, ny;
+	vector<int> found, expected;
+	for(round=0;round<CHECK_ROUNDS/10;round++){
+		RigidWorld world;
+		world.addBox(0, -4.5, 10, 0.5, 0, 0, 0.5);
+		int n = rand()%150 + 1;
+		for(i=0;i<n;i++)
+			world.addBox(uniform(-4, 4), uniform(-3.5, 4), uniform(0.02, 0.4), uniform(0.02, 0.4), uniform(0, 3.14), 1, 0.5);
+		for(i=0;i<rand()%40 + 1;i++)
+			world.step(SIM_DT, NULL);
+		for(k=0;k<50;k++){
+			float x = uniform(-5, 5), y = uniform(-5, 5), r = uniform(0, 0.6);
+			expected.clear();
+			for(i=0;i<(int)world.bodies.size();i++)
+				if(world.bodies[i].invMass > 0 && world.circleContact(i, x, y, r, px, py, nx, ny))
+					expected.push_back(i);
+			world.queryCircle(x, y, r, found);
+			if(found != expected)
+				fail("RigidWorld::queryCircle: %d bodies of %d, asking every body %d", (int)found.size(), n, (int)expected.size());
+			int first = world.firstTouching(x, y, r);
+			if(first != (expected.empty() ? -1 : expected[0]))
+				fail("RigidWorld::firstTouching: body %d, asking every body %d", first, expected.empty() ? -1 : expected[0]);
+		}
+	}
+}
+
+/* Bilinear interpolation of the nodes as set, against sample() and the lanes of apply(),
+   with points off the grid too and counts that leave a tail after the lanes */
+static void checkForceField()
+{
+	int round, i, j;
+	ForceField field;
+	for(round=0;round<CHECK_ROUNDS;round++){
+		int columns = rand()%20 + 1, rows = rand()%20 + 1, n = rand()%100;
+		float x0 = uniform(-4, 0), y0 = uniform(-4, 0), cell = uniform(0.1, 0.5), dt = uniform(0, 0.1);
+		field.resize(columns, rows, x0, y0, cell);
+		vector<float> nodeX((columns + 1)*(rows + 1)), nodeY((columns + 1)*(rows + 1));
+		for(j=0;j<=rows;j++){
+			for(i=0;i<=columns;i++){
+				nodeX[j*(columns + 1) + i] = uniform(-2, 2);
+				nodeY[j*(columns + 1) + i] = uniform(-2, 2);
+				field.setNode(i, j, nodeX[j*(columns + 1) + i], nodeY[j*(columns + 1) + i]);
+			}
+		}
+		vector<float> x(n), y(n), vx(n), vy(n);
+		for(i=0;i<n;i++){
+			x[i] = uniform(x0 - 1, x0 + columns*cell + 1);
+			y[i] = uniform(y0 - 1, y0 + rows*cell + 1);
+			vx[i] = uniform(-1, 1);
+			vy[i] = uniform(-1, 1);
+		}
+		vector<float> ux = vx, uy = vy;
+		field.apply(&x[0], &y[0], &ux[0], &uy[0], n, dt);
+		for(i=0;i<n;i++){
+			float gx = min(max((x[i] - x0)/cell, 0.0f), (float)columns), gy = min(max((y[i] - y0)/cell, 0.0f), (float)rows);
+			int cx = min((int)gx, columns - 1), cy = min((int)gy, rows - 1);
+			float fx = gx - cx, fy = gy - cy;
+			int n00 = cy*(columns + 1) + cx, n10 = n00 + 1, n01 = n00 + columns + 1, n11 = n01 + 1;
+			float ax = (1 - fx)*(1 - fy)*nodeX[n00] + fx*(1 - fy)*nodeX[n10] + (1 - fx)*fy*nodeX[n01] + fx*fy*nodeX[n11];
+			float ay = (1 - fx)*(1 - fy)*nodeY[n00] + fx*(1 - fy)*nodeY[n10] + (1 - fx)*fy*nodeY[n01] + fx*fy*nodeY[n11];
+			float sx, sy;
+			field.sample(x[i], y[i], sx, sy);
+			if(fabs(sx - ax) > 1e-4f || fabs(sy - ay) > 1e-4f)
+				fail("ForceField::sample: %g, %g at %g, %g, the nodes give %g, %g", sx, sy, x[i], y[i], ax, ay);
+			if(fabs(ux[i] - (vx[i] + ax*dt)) > 1e-5f || fabs(uy[i] - (vy[i] + ay*dt)) > 1e-5f)
+				fail("ForceField::apply: point %d of %d at %g, %g pushed to %g, %g, the nodes give %g, %g", i, n, x[i], y[i], ux[i], uy[i], vx[i] + ax*dt, vy[i] + ay*dt);
+		}
+	}
+}
+
+/* firstTouching() through the hash against asking every living agent, over a swarm
+   that flew a while and lost some of its agents */
+static void checkFlock()
+{
+	int round, i, k, kind;
+	for(round=0;round<CHECK_ROUNDS/10;round++){
+		Flock flock;
+		int n = rand()%3000 + 1;
+		flock.reserve(n);
+		flock.left = flock.bottom = -4;
+		flock.right = flock.top = 4;
+		for(kind=0;kind<SWARM_KINDS;kind++)
+			flock.kinds[kind].radius = uniform(0.01, 0.1);
+		for(i=0;i<n;i++)
+			flock.add(uniform(-4, 4), uniform(-4, 4), uniform(-1, 1), uniform(-1, 1), rand()%SWARM_KINDS);
+		flock.build();
+		for(k=0;k<10;k++){
+			for(i=0;i<n/20;i++)
+				flock.kill(rand()%flock.count);
+			flock.step(SIM_DT, 0, 0, true, NULL);
+		}
+		for(i=0;i<n/20;i++)
+			flock.kill(rand()%flock.count);
+		for(k=0;k<100;k++){
+			float x = uniform(-4.5, 4.5), y = uniform(-4.5, 4.5), r = uniform(0, 0.3);
+			int expected = -1;
+			for(i=0;i<flock.count && expected<0;i++){
+				float dx = flock.x[i] - x, dy = flock.y[i] - y, d = r + flock.kinds[flock.kind[i]].radius;
+				if(!flock.dead[i] && dx*dx + dy*dy <= d*d)
+					expected = i;
+			}
+			int first = flock.firstTouching(x, y, r);
+			if(first != expected)
+				fail("Flock::firstTouching: agent %d of %d, asking every agent %d", first, flock.count, expected);
+		}
+	}
+}
+
+/* A field repaired step by step after a wandering target against one searched from
+   nothing for where the target ends up, cell by cell */
+static void checkFlowField()
+{
+	int round, i, x, y;
+	for(round=0;round<CHECK_ROUNDS/10;round++){
+		FlowField repaired, fresh;
+		repaired.resize(64, 64, -3.65, -3.6, 7.3/64);
+		fresh.resize(64, 64, -3.65, -3.6, 7.3/64);
+		for(i=0;i<6;i++){
+			float bx = uniform(-3.5, 3.5), by = uniform(-3.5, 3.5), br = uniform(0.1, 0.7);
+			repaired.block(bx, by, br);
+			fresh.block(bx, by, br);
+		}
+		float tx = uniform(-3.5, 3.5), ty = uniform(-3.5, 3.5);
+		for(i=0;i<300;i++){
+			tx = min(max(tx + uniform(-0.1, 0.1), -3.6f), 3.6f);
+			ty = min(max(ty + uniform(-0.1, 0.1), -3.5f), 3.5f);
+			repaired.setTarget(tx, ty);
+			repaired.update(FLOW_BUDGET);
+		}
+		do
+			repaired.update(FLOW_BUDGET);
+		while(repaired.settled);
+		fresh.setTarget(tx, ty);
+		do
+			fresh.update(FLOW_BUDGET);
+		while(fresh.settled);
+		if(!repaired.repairs)
+			fail("FlowField: no repairs in %d searches", repaired.searches);
+		for(y=0;y<64;y++){
+			for(x=0;x<64;x++){
+				float px = -3.65 + (x + 0.5)*7.3/64, py = -3.6 + (y + 0.5)*7.3/64, ax, ay, bx, by;
+				bool a = repaired.direction(px, py, ax, ay), b = fresh.direction(px, py, bx, by);
+				if(a != b || (a && (ax != bx || ay != by)))
+					fail("FlowField: cell %d, %d leads %g, %g repaired and %g, %g searched afresh", x, y, a ? ax : 0, a ? ay : 0, b ? bx : 0, b ? by : 0);
+			}
+		}
+	}
+}
+
+/* Lanes of projectiles against the same flights one at a time, which take the scalar
+   code; the two may only differ by fused multiply-adds */
+static void checkProjectileLanes()
+{
+	int round, i, model;
+	for(round=0;round<CHECK_ROUNDS;round++){
+		int n = rand()%70 + 1;
+		FlightParams params = { FLIGHT_EULER, uniform(0, 1), uniform(0, 0.02), rand()%6 + 1 };
+		vector<float> x(n), y(n), vx(n), vy(n);
+		for(i=0;i<n;i++){
+			x[i] = uniform(-4, 4);
+			y[i] = uniform(-4, 4);
+			vx[i] = uniform(-6, 6);
+			vy[i] = uniform(-6, 6);
+		}
+		for(model=0;model<2;model++){
+			params.model = model ? FLIGHT_RK4 : FLIGHT_EULER;
+			vector<float> lx = x, ly = y, lvx = vx, lvy = vy;
+			advanceProjectiles(&lx[0], &ly[0], &lvx[0], &lvy[0], n, SIM_DT, params);
+			for(i=0;i<n;i++){
+				float sx = x[i], sy = y[i], svx = vx[i], svy = vy[i];
+				advanceProjectiles(&sx, &sy, &svx, &svy, 1, SIM_DT, params);
+				if(fabs(lx[i] - sx) > 1e-5f || fabs(ly[i] - sy) > 1e-5f || fabs(lvx[i] - svx) > 1e-5f || fabs(lvy[i] - svy) > 1e-5f)
+					fail("advanceProjectiles: projectile %d of %d at %g, %g in lanes and %g, %g alone", i, n, lx[i], ly[i], sx, sy);
+			}
+		}
+	}
+}
+
+static unsigned long long hashFloats(unsigned long long hash, const float* v, int n)
+{
+	int i;
+	unsigned int word;
+	for(i=0;i<n;i++){
+		memcpy(&word, &v[i], sizeof(word));
+		hash = hashWord(hash, word);
+	}
+	return hash;
+}
+
+/* Everything the workers have a hand in, to the bit */
+static unsigned long long gameHash(Game& game)
+{
+	int i;
+	unsigned long long hash = game.stateHash(HASH_START);
+	hash = hashWord(hash, (int)game.getScore());
+	hash = hashFloats(hash, &game.shots.x[0], game.shots.count);
+	hash = hashFloats(hash, &game.shots.y[0], game.shots.count);
+	hash = hashFloats(hash, &game.shots.vx[0], game.shots.count);
+	hash = hashFloats(hash, &game.shots.vy[0], game.shots.count);
+	hash = hashFloats(hash, &game.swarm.x[0], game.swarm.count);
+	hash = hashFloats(hash, &game.swarm.y[0], game.swarm.count);
+	hash = hashFloats(hash, &game.swarm.vx[0], game.swarm.count);
+	hash = hashFloats(hash, &game.swarm.vy[0], game.swarm.count);
+	for(i=0;i<(int)game.blocks.bodies.size();i++){
+		const RigidBody& b = game.blocks.bodies[i];
+		float words[6] = { b.x, b.y, b.angle, b.vx, b.vy, b.w };
+		hash = hashFloats(hash, words, 6);
+	}
+	return hash;
+}
+
+/* Volleys fired over a level with towers, swarms, wells and wind, played with threads
+   workers (0 for none), hashed after every step */
+static unsigned long long playVolleys(int threads)
+{
+	int volley, steps;
+	unsigned long long hash = HASH_START;
+	WorkerPool* pool = threads ? new WorkerPool(threads) : NULL;
+	srand(7);
+	Game* game = new Game();
+	game->workers = pool;
+	game->towerBlocks = 600;
+	game->swarmSize = 3000;
+	game->wellCount = 4;
+	game->forceCells = 16;
+	game->start();
+	for(volley=0;volley<4;volley++){
+		game->fireVolley(-3.4, -3.0, 4.5, 30 + 10*volley, 25, MAX_SHOTS);
+		for(steps=0;game->shots.count && steps<400;steps++){
+			game->step();
+			hash = hashWord(hash, gameHash(*game));
+			hash = hashWord(hash, gameHash(*game) >> 32);
+		}
+	}
+	delete game;
+	delete pool;
+	return hash;
+}
+
+/* The workers only split the work, the game must play out the same with any number */
+static void checkWorkers()
+{
+	int i;
+	static const int threads[3] = { 0, 1, 4 };
+	unsigned long long hashes[3];
+	for(i=0;i<3;i++){
+		hashes[i] = playVolleys(threads[i]);
+		if(i && hashes[i] != hashes[0])
+			fail("Game with %d workers: hash %016llx, without workers %016llx", threads[i], hashes[i], hashes[0]);
+	}
+}
+
+/* The comet comes in on the right, flies across the field and is gone once it left it */
+static void checkComet()
+{
+	int i;
+	srand(3);
+	Game* game = new Game();
+	game->start();
+	// Out of reach of the bird waiting at the sling
+	game->cometY = FIELD_ROOF - 0.5f;
+	for(i=0;i<1000 && game->comet == NO_ENTITY;i++)
+		game->step();
+	Entity comet = game->comet;
+	if(comet == NO_ENTITY)
+		fail("Comet: none after %d steps", i);
+	else{
+		float x = game->transforms.get(comet).x, left = x;
+		for(i=0;i<1000 && game->comet == comet;i++){
+			game->step();
+			if(game->comet != comet)
+				break;
+			x = game->transforms.get(comet).x;
+			if(x >= left){
+				fail("Comet: stuck at %g after %d steps", x, i);
+				break;
+			}
+			left = x;
+		}
+		if(game->comet == comet)
+			fail("Comet: still there at %g after %d steps", x, i);
+		else if(left > FIELD_LEFT)
+			fail("Comet: gone at %g, before it crossed the field", left);
+		if(game->transforms.has(comet) || game->colliders.has(comet))
+			fail("Comet: not despawned");
+	}
+	delete game;
+}
+
+int main()
+{
+#if defined(__AVX512F__)
+	if(!__builtin_cpu_supports("avx512f")){
+		printf("skipped, no AVX-512 here\n");
+		return 0;
+	}
+#elif defined(__AVX2__)
+	if(!__builtin_cpu_supports("avx2")){
+		printf("skipped, no AVX2 here\n");
+		return 0;
+	}
+#endif
+	srand(1);
+	checkCircleSet();
+	checkSpatialGrid();
+	checkTimeOfImpact();
+	checkBVH();
+	checkRigidQueries();
+	checkForceField();
+	checkFlock();
+	checkFlowField();
+	checkProjectileLanes();
+	checkWorkers();
+	checkComet();
+	printf("%s\n", failures ? "FAILED" : "ok");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,196 @@
+#include <cmath>
+#include <algorithm>
+#include "collide.h"
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void CircleSet::reserve(int n)
+{
+	n = (n + CIRCLE_LANES - 1) / CIRCLE_LANES * CIRCLE_LANES;
+	if(n <= (int)x.size())
+		return;
+	x.resize(n, 0);
+	y.resize(n, 0);
+	r.resize(n, 0);
+	hits.resize((n + 31) / 32, 0);
+}
+
+void CircleSet::add(float cx, float cy, float cr)
+{
+	if(count == (int)x.size())
+		reserve(2*count + CIRCLE_LANES);
+	x[count] = cx;
+	y[count] = cy;
+	r[count] = cr;
+	count++;
+}
+
+/* The lanes past count hold whatever was there before, their bits are cleared at the end.
+   Overlap is dx*dx + dy*dy <= (cr + r)^2, no square root needed. */
+int CircleSet::overlap(float cx, float cy, float cr)
+{
+	int i, n, overlaps;
+	n = (count + CIRCLE_LANES - 1) / CIRCLE_LANES * CIRCLE_LANES;
+	for(i=0;i<(n + 31) / 32;i++)
+		hits[i] = 0;
+
+#if defined(__AVX512F__)
+	__m512 px = _mm512_set1_ps(cx), py = _mm512_set1_ps(cy), pr = _mm512_set1_ps(cr);
+	for(i=0;i<n;i+=16){
+		__m512 dx = _mm512_sub_ps(_mm512_loadu_ps(&x[i]), px);
+		__m512 dy = _mm512_sub_ps(_mm512_loadu_ps(&y[i]), py);
+		__m512 s = _mm512_add_ps(_mm512_loadu_ps(&r[i]), pr);
+		__m512 d2 = _mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy));
+		__mmask16 in = _mm512_cmp_ps_mask(d2, _mm512_mul_ps(s, s), _CMP_LE_OQ);
+		hits[i >> 5] |= (unsigned int)in << (i & 31);
+	}
+#elif defined(__AVX2__)
+	__m256 px = _mm256_set1_ps(cx), py = _mm256_set1_ps(cy), pr = _mm256_set1_ps(cr);
+	for(i=0;i<n;i+=8){
+		__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(&x[i]), px);
+		__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(&y[i]), py);
+		__m256 s = _mm256_add_ps(_mm256_loadu_ps(&r[i]), pr);
+		__m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+		__m256 in = _mm256_cmp_ps(d2, _mm256_mul_ps(s, s), _CMP_LE_OQ);
+		hits[i >> 5] |= (unsigned int)_mm256_movemask_ps(in) << (i & 31);
+	}
+#elif defined(__SSE2__)
+	__m128 px = _mm_set1_ps(cx), py = _mm_set1_ps(cy), pr = _mm_set1_ps(cr);
+	for(i=0;i<n;i+=4){
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(&x[i]), px);
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(&y[i]), py);
+		__m128 s = _mm_add_ps(_mm_loadu_ps(&r[i]), pr);
+		__m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+		__m128 in = _mm_cmple_ps(d2, _mm_mul_ps(s, s));
+		hits[i >> 5] |= (unsigned int)_mm_movemask_ps(in) << (i & 31);
+	}
+#else
+	for(i=0;i<n;i++){
+		float dx = x[i] - cx, dy = y[i] - cy, s = r[i] + cr;
+		if(dx*dx + dy*dy <= s*s)
+			hits[i >> 5] |= 1u << (i & 31);
+	}
+#endif
+
+	for(i=count;i<n;i++)
+		hits[i >> 5] &= ~(1u << (i & 31));
+	overlaps = 0;
+	for(i=0;i<(count + 31) / 32;i++){
+		unsigned int word = hits[i];
+		for(;word;word&=word-1)
+			overlaps++;
+	}
+	return overlaps;
+}
+
+bool circleTimeOfImpact(float ox, float oy, float dx, float dy, float cx, float cy, float r, float maxT, float& t)
+{
+	float px = ox - cx, py = oy - cy;
+	float c = px*px + py*py - r*r;
+	if(c <= 0){
+		t = 0;
+		return true;
+	}
+	float a = dx*dx + dy*dy, b = px*dx + py*dy;
+	if(a == 0 || b >= 0)
+		return false;
+	float disc = b*b - a*c;
+	if(disc < 0)
+		return false;
+	t = (-b - sqrt(disc)) / a;
+	return t <= maxT;
+}
+
+SpatialGrid::SpatialGrid()
+{
+	cellStart.assign(GRID_CELLS*GRID_CELLS + 1, 0);
+	queries = 0;
+}
+
+void SpatialGrid::reserve(int n)
+{
+	ids.reserve(n);
+	cells.reserve(4*n);
+	cellItems.reserve(4*n);
+	if(n > (int)stamp.size())
+		stamp.resize(n, 0);
+}
+
+void SpatialGrid::clear()
+{
+	ids.clear();
+	cells.clear();
+}
+
+static int gridCell(float v)
+{
+	int c = (int)((v - GRID_MIN) * (GRID_CELLS / (GRID_MAX - GRID_MIN)));
+	if(c < 0)
+		return 0;
+	if(c >= GRID_CELLS)
+		return GRID_CELLS - 1;
+	return c;
+}
+
+void SpatialGrid::add(int id, float x, float y, float r)
+{
+	ids.push_back(id);
+	cells.push_back(gridCell(x - r));
+	cells.push_back(gridCell(y - r));
+	cells.push_back(gridCell(x + r));
+	cells.push_back(gridCell(y + r));
+}
+
+void SpatialGrid::build()
+{
+	int i, cx, cy, total;
+	for(i=0;i<=GRID_CELLS*GRID_CELLS;i++)
+		cellStart[i] = 0;
+	// Count the items per cell, one past the cell so that the prefix sum gives the starts
+	for(i=0;i<(int)ids.size();i++)
+		for(cy=cells[4*i+1];cy<=cells[4*i+3];cy++)
+			for(cx=cells[4*i];cx<=cells[4*i+2];cx++)
+				cellStart[cy*GRID_CELLS + cx + 1]++;
+	for(i=0;i<GRID_CELLS*GRID_CELLS;i++)
+		cellStart[i+1] += cellStart[i];
+	total = cellStart[GRID_CELLS*GRID_CELLS];
+	cellItems.resize(total);
+	// Fill, using the starts as cursors; afterwards cellStart[c] is where cell c+1 starts
+	for(i=0;i<(int)ids.size();i++)
+		for(cy=cells[4*i+1];cy<=cells[4*i+3];cy++)
+			for(cx=cells[4*i];cx<=cells[4*i+2];cx++)
+				cellItems[cellStart[cy*GRID_CELLS + cx]++] = ids[i];
+	for(i=GRID_CELLS*GRID_CELLS;i>0;i--)
+		cellStart[i] = cellStart[i-1];
+	cellStart[0] = 0;
+}
+
+int SpatialGrid::query(float x, float y, float r, std::vector<int>& out)
+{
+	int cx, cy, k;
+	int x0 = gridCell(x - r), y0 = gridCell(y - r), x1 = gridCell(x + r), y1 = gridCell(y + r);
+	out.clear();
+	queries++;
+	for(cy=y0;cy<=y1;cy++){
+		for(cx=x0;cx<=x1;cx++){
+			int c = cy*GRID_CELLS + cx;
+			for(k=cellStart[c];k<cellStart[c+1];k++){
+				int id = cellItems[k];
+				if(stamp[id] == queries)
+					continue;
+				stamp[id] = queries;
+				out.push_back(id);
+			}
+		}
+	}
+	std::sort(out.begin(), out.end());
+	return out.size();
+}
+
+int SpatialGrid::cellAt(float x, float y) const
+{
+	return gridCell(y)*GRID_CELLS + gridCell(x);
+}
@@ -0,0 +1,67 @@
+#ifndef COLLIDE_H
+#define COLLIDE_H
+
+#include <vector>
+
+/* Widest batch any of the kernels tests at once, the arrays are padded to a multiple of it */
+#define CIRCLE_LANES 16
+
+/* Circles in structure of arrays layout, so that many of them are tested with one
+   instruction: with AVX-512 16 at a time, with AVX2 8, with SSE2 4. Build with e.g.
+   -mavx2 or -march=native to get the wider kernels. */
+struct CircleSet {
+	std::vector<float> x, y, r;
+	std::vector<unsigned int> hits;	// bit i%32 of word i/32 is set when circle i overlaps
+	int count;
+
+	CircleSet(){
+		count = 0;
+	}
+	/* Make room for n circles up front, so that filling the set does not allocate */
+	void reserve(int n);
+	void clear(){
+		count = 0;
+	}
+	void add(float cx, float cy, float cr);
+	/* Test all the circles against the given one, sets hits and returns the number of overlaps */
+	int overlap(float cx, float cy, float cr);
+	bool hit(int i){
+		return hits[i >> 5] >> (i & 31) & 1;
+	}
+};
+
+/* First t in [0, maxT] at which a circle moving along o + t*d touches a circle at c, with
+   r the sum of both radii. Same as a ray against a circle of radius r; t = 0 when they
+   already overlap. */
+bool circleTimeOfImpact(float ox, float oy, float dx, float dy, float cx, float cy, float r, float maxT, float& t);
+
+/* Play field covered by the grid, things outside of it go into the border cells */
+#define GRID_MIN -4.0f
+#define GRID_MAX 4.0f
+#define GRID_CELLS 16		// per side
+
+/* Uniform grid broadphase: items are circles given by an id, each is put into all the
+   cells its bounding box touches. Rebuilt from scratch with a counting sort, so only
+   the items near a query are looked at, however many there are elsewhere. */
+struct SpatialGrid {
+	std::vector<int> cellStart;	// items of cell c are cellItems[cellStart[c] .. cellStart[c+1]-1]
+	std::vector<int> cellItems;
+	std::vector<int> ids;		// per added item: its id and the cell rectangle it covers
+	std::vector<short> cells;	// x0, y0, x1, y1
+	std::vector<int> stamp;		// by id, the query that last returned it
+	int queries;
+
+	SpatialGrid();
+	void reserve(int n);
+	void clear();
+	/* Ids must be below the number reserved */
+	void add(int id, float x, float y, float r);
+	void build();
+	/* The ids of the items whose cells the circle touches, each once and in ascending order */
+	int query(float x, float y, float r, std::vector<int>& out);
+	/* The cell a point is in, its items are cellItems[cellStart[c] .. cellStart[c+1]-1].
+	   Only reads the grid, so several threads can look points up at once. */
+	int cellAt(float x, float y) const;
+};
+
+#endif
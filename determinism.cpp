@@ -0,0 +1,43 @@
+#include <cstdio>
+#include <cstdlib>
+#include "angrysim.h"
+
+/* Plays the same shots on a few levels with the fixed point flight and prints the tick
+   hashes, one line per seed and the hash of them all last. make determinism builds it
+   several ways and compares what each build prints. */
+
+#define DETERMINISM_SEEDS 4
+#define DETERMINISM_STEPS 100000
+
+/* The shots, aimed by hand: angle in degrees and speed */
+static const float shotAngles[] = { 10, 25, 40, 55, 70, 85, 5, 35, 60, 45 };
+static const float shotSpeeds[] = { 3.0, 2.2, 1.6, 2.6, 1.0, 3.2, 2.0, 1.4, 2.8, 1.8 };
+#define DETERMINISM_SHOTS (sizeof(shotAngles)/sizeof(shotAngles[0]))
+
+int main()
+{
+	int seed, i, shot;
+	unsigned long long all = HASH_START;
+	flight.model = FLIGHT_FIXED;
+	for(seed=1;seed<=DETERMINISM_SEEDS;seed++){
+		Game game;
+		srand(seed);
+		game.start();
+		shot = 0;
+		for(i=0;i<DETERMINISM_STEPS;i++){
+			if(game.levelUp)
+				game.accept();
+			else if(!game.angryBird.getStatus()){
+				game.angryBird.setAngle(shotAngles[shot%DETERMINISM_SHOTS]);
+				game.angryBird.setVel(shotSpeeds[shot%DETERMINISM_SHOTS]);
+				game.control(CONTROL_LAUNCH);
+				shot++;
+			}
+			game.step();
+		}
+		printf("seed %d: %d shots, score %g, level %d, tick hash %016llx\n", seed, shot, game.getScore(), game.getLevel(), game.tickHash);
+		all = hashWord(hashWord(all, game.tickHash), game.tickHash >> 32);
+	}
+	printf("all: %016llx\n", all);
+	return 0;
+}
@@ -0,0 +1,45 @@
+#ifndef FIXED_H
+#define FIXED_H
+
+/* Q16.16 fixed point. Integer arithmetic gives the same bits with any compiler, optimization
+   level or instruction set, where float results change with the libm behind sin, cos and
+   atan and with fused multiply-adds. Angles are in degrees, like the rest of the game. */
+typedef int fixed;
+
+#define FIXED_SHIFT 16
+#define FIXED_ONE (1 << FIXED_SHIFT)
+
+/* Rounded to the nearest; scaling a float by a power of two is exact */
+inline fixed toFixed(float f){
+	f = f * FIXED_ONE;
+	return (fixed)(f < 0 ? f - 0.5f : f + 0.5f);
+}
+inline float fromFixed(fixed a){
+	return a * (1.0f / FIXED_ONE);
+}
+inline fixed fixedMul(fixed a, fixed b){
+	return (fixed)(((long long)a * b) >> FIXED_SHIFT);
+}
+inline fixed fixedDiv(fixed a, fixed b){
+	return (fixed)(((long long)a << FIXED_SHIFT) / b);
+}
+
+fixed fixedSqrt(fixed a);
+/* From quarter wave tables, interpolated linearly */
+fixed fixedSin(fixed degrees);
+fixed fixedCos(fixed degrees);
+/* atan(y/x) in (-90, 90], +-90 when x is 0 */
+fixed fixedAtan(fixed y, fixed x);
+
+/* FNV-1a, to hash game states a word at a time */
+#define HASH_START 14695981039346656037ull
+
+inline unsigned long long hashWord(unsigned long long hash, unsigned int word){
+	for(int i=0;i<4;i++){
+		hash ^= (word >> 8*i) & 0xff;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+#endif
@@ -0,0 +1,305 @@
+#include <cmath>
+#include <algorithm>
+#include "flock.h"
+
+using namespace std;
+
+Flock::Flock()
+{
+	int k;
+	buckets = FLOCK_BUCKETS;
+	dt = 0;
+	targetX = targetY = 0;
+	chasing = false;
+	count = 0;
+	left = bottom = -1;
+	right = top = 1;
+	SwarmKind plain = { 1, 1, 1, 0.05, 0, 0, 0.2, 0.5, 1, 0.02 };
+	for(k=0;k<SWARM_KINDS;k++)
+		kinds[k] = plain;
+}
+
+void Flock::reserve(int n)
+{
+	unsigned int most = FLOCK_BUCKETS;
+	while(most < 2u*n)
+		most *= 2;
+	x.resize(n);
+	y.resize(n);
+	vx.resize(n);
+	vy.resize(n);
+	prevx.resize(n);
+	prevy.resize(n);
+	kind.resize(n);
+	dead.resize(n);
+	nextX.resize(n);
+	nextY.resize(n);
+	nextVx.resize(n);
+	nextVy.resize(n);
+	nextKind.resize(n);
+	agentBucket.resize(n);
+	order.resize(n);
+	bucketStart.reserve(most + 1);
+}
+
+void Flock::clear()
+{
+	count = 0;
+}
+
+int Flock::add(float ax, float ay, float avx, float avy, int k)
+{
+	if(count == (int)x.size())
+		return -1;
+	x[count] = prevx[count] = ax;
+	y[count] = prevy[count] = ay;
+	vx[count] = avx;
+	vy[count] = avy;
+	kind[count] = k;
+	dead[count] = 0;
+	return count++;
+}
+
+static inline int flockCell(float p)
+{
+	return (int)floorf(p*(1/FLOCK_SIGHT));
+}
+
+/* Cells far apart can share a bucket, the distance sorts them out */
+int Flock::bucket(int cx, int cy) const
+{
+	return ((unsigned int)cx*73856093u ^ (unsigned int)cy*19349663u) & (buckets - 1);
+}
+
+/* Gathers the agents into the order of order, through the spare array */
+template <class T> static void permute(std::vector<T>& a, std::vector<T>& spare, const std::vector<int>& order, int count)
+{
+	int i;
+	for(i=0;i<count;i++)
+		spare[i] = a[order[i]];
+	a.swap(spare);
+}
+
+void Flock::build()
+{
+	int i;
+	unsigned int b;
+	buckets = FLOCK_BUCKETS;
+	while(buckets < 2u*count)
+		buckets *= 2;
+	bucketStart.assign(buckets + 1, 0);
+	// Count the agents per bucket, one past the bucket so that the prefix sum gives the starts
+	for(i=0;i<count;i++){
+		agentBucket[i] = bucket(flockCell(x[i]), flockCell(y[i]));
+		bucketStart[agentBucket[i] + 1]++;
+	}
+	for(b=0;b<buckets;b++)
+		bucketStart[b+1] += bucketStart[b];
+	// Fill, using the starts as cursors; afterwards bucketStart[b] is where bucket b+1 starts
+	for(i=0;i<count;i++)
+		order[bucketStart[agentBucket[i]]++] = i;
+	for(b=buckets;b>0;b--)
+		bucketStart[b] = bucketStart[b-1];
+	bucketStart[0] = 0;
+	// The agents of a bucket next to each other, in the order they had
+	permute(x, nextX, order, count);
+	permute(y, nextX, order, count);
+	permute(vx, nextX, order, count);
+	permute(vy, nextX, order, count);
+	permute(prevx, nextX, order, count);
+	permute(prevy, nextX, order, count);
+	permute(kind, nextKind, order, count);
+	permute(dead, nextKind, order, count);
+}
+
+void Flock::savePrevious()
+{
+	int i;
+	for(i=0;i<count;i++){
+		prevx[i] = x[i];
+		prevy[i] = y[i];
+	}
+}
+
+int Flock::firstTouching(float px, float py, float r) const
+{
+	int cx, cy, k, a, first = -1;
+	float widest = 0;
+	if(!count)
+		return -1;
+	for(k=0;k<SWARM_KINDS;k++)
+		widest = max(widest, kinds[k].radius);
+	float reach = r + widest;
+	int x0 = flockCell(px - reach), y0 = flockCell(py - reach), x1 = flockCell(px + reach), y1 = flockCell(py + reach);
+	for(cy=y0;cy<=y1;cy++){
+		for(cx=x0;cx<=x1;cx++){
+			int b = bucket(cx, cy);
+			for(a=bucketStart[b];a<bucketStart[b+1] && (first < 0 || a < first);a++){
+				if(dead[a])
+					continue;
+				float dx = x[a] - px, dy = y[a] - py, d = r + kinds[kind[a]].radius;
+				if(dx*dx + dy*dy <= d*d)
+					first = a;
+			}
+		}
+	}
+	return first;
+}
+
+/* The three rules over the neighbours in the 3 by 3 cells around the agent, each bucket
+   once, then the chase and the bounds; the change of velocity is held to steer and the
+   speed kept between minSpeed and maxSpeed */
+void Flock::updateChunk(int chunk)
+{
+	int i, a, m, n;
+	// Its own cell first, so the nearest are among the neighbours it steers by
+	static const int around[9][2] = { {0,0}, {-1,-1}, {0,-1}, {1,-1}, {-1,0}, {1,0}, {-1,1}, {0,1}, {1,1} };
+	int first = chunk*FLOCK_CHUNK, last = min(first + FLOCK_CHUNK, count);
+	for(i=first;i<last;i++){
+		float px = x[i], py = y[i], ux = vx[i], uy = vy[i];
+		const SwarmKind& k = kinds[kind[i]];
+		if(dead[i]){
+			nextX[i] = px;
+			nextY[i] = py;
+			nextVx[i] = ux;
+			nextVy[i] = uy;
+			continue;
+		}
+		int cx = flockCell(px), cy = flockCell(py);
+		int visited[9], nv = 0, seen = 0, mates = 0;
+		float inversePersonal = 1/(k.personal*k.personal);
+		float sepX = 0, sepY = 0, alignX = 0, alignY = 0, centreX = 0, centreY = 0;
+		for(n=0;n<9;n++){
+			int b = bucket(cx + around[n][0], cy + around[n][1]);
+			for(m=0;m<nv && visited[m] != b;m++)
+				;
+			if(m < nv)
+				continue;
+			visited[nv++] = b;
+			for(a=bucketStart[b];a<bucketStart[b+1] && seen<FLOCK_NEIGHBOURS;a++){
+				if(a == i || dead[a])
+					continue;
+				float ox = x[a] - px, oy = y[a] - py, d2 = ox*ox + oy*oy;
+				if(d2 > FLOCK_SIGHT*FLOCK_SIGHT)
+					continue;
+				seen++;
+				if(d2*inversePersonal < 1){
+					// Harder the closer they are, nothing from personal on
+					float push = 1/max(d2, 1e-8f) - inversePersonal;
+					sepX -= ox*push;
+					sepY -= oy*push;
+				}
+				if(kind[a] != kind[i])
+					continue;
+				alignX += vx[a];
+				alignY += vy[a];
+				centreX += ox;
+				centreY += oy;
+				mates++;
+			}
+		}
+		float ax = k.separation*sepX, ay = k.separation*sepY;
+		if(mates){
+			ax += k.alignment*(alignX/mates - ux) + k.cohesion*centreX/mates;
+			ay += k.alignment*(alignY/mates - uy) + k.cohesion*centreY/mates;
+		}
+		if(chasing){
+			float tx = targetX - px, ty = targetY - py, d = sqrt(tx*tx + ty*ty);
+			if(d > 0 && d < k.range){
+				ax += k.chase*(tx/d*k.maxSpeed - ux);
+				ay += k.chase*(ty/d*k.maxSpeed - uy);
+			}
+		}
+		if(px < left + FLOCK_MARGIN)
+			ax += k.steer;
+		else if(px > right - FLOCK_MARGIN)
+			ax -= k.steer;
+		if(py < bottom + FLOCK_MARGIN)
+			ay += k.steer;
+		else if(py > top - FLOCK_MARGIN)
+			ay -= k.steer;
+		float a = sqrt(ax*ax + ay*ay);
+		if(a > k.steer){
+			ax *= k.steer/a;
+			ay *= k.steer/a;
+		}
+		ux += ax*dt;
+		uy += ay*dt;
+		float speed = sqrt(ux*ux + uy*uy);
+		if(speed > k.maxSpeed){
+			ux *= k.maxSpeed/speed;
+			uy *= k.maxSpeed/speed;
+		}
+		else if(speed < k.minSpeed){
+			if(speed > 0){
+				ux *= k.minSpeed/speed;
+				uy *= k.minSpeed/speed;
+			}
+			else
+				ux = k.minSpeed;
+		}
+		px += ux*dt;
+		py += uy*dt;
+		// Never out of the bounds, whatever the rules say
+		if(px < left || px > right){
+			px = min(max(px, left), right);
+			ux = -ux;
+		}
+		if(py < bottom || py > top){
+			py = min(max(py, bottom), top);
+			uy = -uy;
+		}
+		nextX[i] = px;
+		nextY[i] = py;
+		nextVx[i] = ux;
+		nextVy[i] = uy;
+	}
+}
+
+void Flock::updateChunkJob(void* flock, int index)
+{
+	((Flock*)flock)->updateChunk(index);
+}
+
+/* The living keep their order */
+void Flock::removeDead()
+{
+	int i, n;
+	for(i=0,n=0;i<count;i++){
+		if(dead[i])
+			continue;
+		x[n] = x[i];
+		y[n] = y[i];
+		vx[n] = vx[i];
+		vy[n] = vy[i];
+		prevx[n] = prevx[i];
+		prevy[n] = prevy[i];
+		kind[n] = kind[i];
+		dead[n] = 0;
+		n++;
+	}
+	count = n;
+}
+
+void Flock::step(float h, float tx, float ty, bool chase, WorkerPool* workers)
+{
+	int i;
+	if(!count)
+		return;
+	dt = h;
+	targetX = tx;
+	targetY = ty;
+	chasing = chase;
+	int chunks = (count + FLOCK_CHUNK - 1)/FLOCK_CHUNK;
+	if(workers)
+		workers->run(chunks, updateChunkJob, this);
+	else
+		for(i=0;i<chunks;i++)
+			updateChunk(i);
+	x.swap(nextX);
+	y.swap(nextY);
+	vx.swap(nextVx);
+	vy.swap(nextVy);
+	removeDead();
+	build();
+}
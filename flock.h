@@ -0,0 +1,80 @@
+#ifndef FLOCK_H
+#define FLOCK_H
+
+#include <vector>
+#include "workers.h"
+
+/* Agents see the others within FLOCK_SIGHT, which is also the size of the cells of the
+   hash; each steers by the first FLOCK_NEIGHBOURS it sees, so a dense clump costs no
+   more than a loose one */
+#define FLOCK_SIGHT 0.15f
+#define FLOCK_NEIGHBOURS 16
+#define FLOCK_CHUNK 512		// agents per job of the worker threads
+#define FLOCK_BUCKETS 1024	// fewest buckets of the hash, it has at least twice as many as agents
+#define FLOCK_MARGIN 0.3f	// from the bounds on, the agents turn back
+#define SWARM_KINDS 2
+
+/* How a kind of agent flies. The weights are of the three rules of the boids: keep apart
+   from the ones closer than personal, head the way the others of the kind head, and
+   make for the centre of those; and of chasing the target while it is within range. */
+struct SwarmKind {
+	float separation, alignment, cohesion;
+	float personal;
+	float chase, range;
+	float minSpeed, maxSpeed;
+	float steer;		// most change of velocity per second
+	float radius;		// of what touches them
+};
+
+/* A swarm of agents in structure of arrays layout. A spatial hash over where they are
+   is rebuilt with a counting sort after every step, so an agent only looks at the few
+   cells around it; the agents themselves are sorted by bucket, so those of a cell are
+   next to each other in memory and their indices change from step to step. The step
+   runs in chunks on the workers, each agent writing only its own next state from the
+   state all of them had before, so the result does not depend on the number of
+   threads. Killed agents are left out of the next step and removed at its end. */
+class Flock {
+	std::vector<int> bucketStart;	// agents of bucket b: bucketStart[b] .. bucketStart[b+1]-1
+	std::vector<int> agentBucket;
+	std::vector<int> order;		// the agents by bucket, while build() sorts them
+	unsigned int buckets;		// a power of two
+	std::vector<float> nextX, nextY, nextVx, nextVy;
+	std::vector<unsigned char> nextKind;
+	float dt;
+	float targetX, targetY;
+	bool chasing;
+
+	int bucket(int cx, int cy) const;
+	void updateChunk(int chunk);
+	static void updateChunkJob(void* flock, int index);
+	void removeDead();
+
+	public:
+	std::vector<float> x, y, vx, vy;
+	std::vector<float> prevx, prevy;
+	std::vector<unsigned char> kind;
+	std::vector<unsigned char> dead;
+	int count;
+	SwarmKind kinds[SWARM_KINDS];
+	float left, right, bottom, top;		// where they turn back
+
+	Flock();
+	/* Make room for n agents up front, so that nothing allocates after */
+	void reserve(int n);
+	void clear();
+	/* -1 once the room reserved is used up */
+	int add(float x, float y, float vx, float vy, int kind);
+	/* The hash over where the agents are now, sorting them; step() keeps it up to date */
+	void build();
+	void savePrevious();
+	/* The living agent with the lowest index the circle touches, -1 for none. Only reads
+	   the flock, several threads can ask at once. */
+	int firstTouching(float x, float y, float r) const;
+	void kill(int i){
+		dead[i] = 1;
+	}
+	/* chase tells whether the agents go for the target at targetX, targetY */
+	void step(float dt, float targetX, float targetY, bool chase, WorkerPool* workers);
+};
+
+#endif
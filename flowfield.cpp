@@ -0,0 +1,203 @@
+#include <cmath>
+#include <algorithm>
+#include "flowfield.h"
+
+using namespace std;
+
+/* The eight neighbours, counterclockwise from the right; odd ones across a corner */
+static const int stepX[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+static const int stepY[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+
+/* For the heap: the nearest first, ties by cell so the order never depends on the heap */
+struct Later {
+	bool operator()(const FlowNode& a, const FlowNode& b) const {
+		return a.distance > b.distance || (a.distance == b.distance && a.cell > b.cell);
+	}
+};
+
+FlowField::FlowField()
+{
+	columns = rows = 0;
+	x0 = y0 = 0;
+	cell = 1;
+	targetCell = searchCell = -1;
+	reblocked = false;
+	searching = false;
+	searches = repairs = settled = 0;
+}
+
+void FlowField::resize(int c, int r, float x, float y, float size)
+{
+	columns = c;
+	rows = r;
+	x0 = x;
+	y0 = y;
+	cell = size;
+	blocked.assign(c*r, 0);
+	distance.assign(c*r, FLOW_UNREACHED);
+	way.assign(c*r, -1);
+	open.clear();
+	open.reserve(8*c*r);
+	targetCell = searchCell = -1;
+	reblocked = searching = false;
+}
+
+void FlowField::clear()
+{
+	resize(0, 0, 0, 0, 1);
+}
+
+void FlowField::clearBlocked()
+{
+	fill(blocked.begin(), blocked.end(), 0);
+	reblocked = true;
+}
+
+void FlowField::block(float x, float y, float r)
+{
+	int cx, cy;
+	if(empty())
+		return;
+	int left = max((int)floor((x - r - x0)/cell), 0), right = min((int)floor((x + r - x0)/cell), columns - 1);
+	int bottom = max((int)floor((y - r - y0)/cell), 0), top = min((int)floor((y + r - y0)/cell), rows - 1);
+	for(cy=bottom;cy<=top;cy++){
+		for(cx=left;cx<=right;cx++){
+			float dx = x0 + (cx + 0.5f)*cell - x, dy = y0 + (cy + 0.5f)*cell - y;
+			if(dx*dx + dy*dy <= r*r)
+				blocked[cy*columns + cx] = 1;
+		}
+	}
+	reblocked = true;
+}
+
+/* Points off the grid are in the nearest cell on its edge */
+int FlowField::cellAt(float x, float y) const
+{
+	int cx = min(max((int)floor((x - x0)/cell), 0), columns - 1);
+	int cy = min(max((int)floor((y - y0)/cell), 0), rows - 1);
+	return cy*columns + cx;
+}
+
+/* Whether neighbour k of cell cx, cy can be stepped to */
+bool FlowField::canStep(int cx, int cy, int k) const
+{
+	int nx = cx + stepX[k], ny = cy + stepY[k];
+	if(nx < 0 || ny < 0 || nx >= columns || ny >= rows || blocked[ny*columns + nx])
+		return false;
+	if(k%2)
+		return !blocked[cy*columns + nx] && !blocked[ny*columns + cx];
+	return true;
+}
+
+void FlowField::setTarget(float x, float y)
+{
+	if(empty())
+		return;
+	targetCell = cellAt(x, y);
+}
+
+/* A path from the old target to the new one and on along the old field is a way to the
+   new target, so the old distance plus the one between the targets is never too short;
+   Dijkstra from the new target only changes the cells it finds shorter. That holds when
+   the last search was done over the same blocked cells and could be walked backwards,
+   i.e. the old target was not in a blocked cell. */
+void FlowField::start()
+{
+	int c, shift = FLOW_UNREACHED;
+	FlowNode node = { 0, targetCell };
+	if(!searching && !reblocked && searchCell >= 0 && !blocked[searchCell])
+		shift = distance[targetCell];
+	if(shift == FLOW_UNREACHED)
+		fill(distance.begin(), distance.end(), FLOW_UNREACHED);
+	else{
+		for(c=0;c<columns*rows;c++)
+			if(distance[c] != FLOW_UNREACHED)
+				distance[c] += shift;
+		repairs++;
+	}
+	distance[targetCell] = 0;
+	open.clear();
+	open.push_back(node);
+	searchCell = targetCell;
+	reblocked = false;
+	searching = true;
+	searches++;
+}
+
+/* The search spreads from the target's cell even when that is blocked, so a target just
+   inside the margin of an obstacle is still found */
+void FlowField::update(int budget)
+{
+	int k;
+	Later later;
+	settled = 0;
+	if(empty() || targetCell < 0)
+		return;
+	if(reblocked || (!searching && targetCell != searchCell))
+		start();
+	if(!searching)
+		return;
+	while(!open.empty() && settled < budget){
+		pop_heap(open.begin(), open.end(), later);
+		FlowNode node = open.back();
+		open.pop_back();
+		// Put in again since, with a shorter distance
+		if(node.distance > distance[node.cell])
+			continue;
+		settled++;
+		int cx = node.cell%columns, cy = node.cell/columns;
+		for(k=0;k<8;k++){
+			if(!canStep(cx, cy, k))
+				continue;
+			int next = (cy + stepY[k])*columns + cx + stepX[k];
+			int d = node.distance + (k%2 ? FLOW_DIAGONAL : FLOW_STRAIGHT);
+			if(d >= distance[next])
+				continue;
+			distance[next] = d;
+			FlowNode reached = { d, next };
+			open.push_back(reached);
+			push_heap(open.begin(), open.end(), later);
+		}
+	}
+	if(open.empty())
+		finish();
+}
+
+/* Each cell goes to its nearest neighbour that is nearer to the target than itself */
+void FlowField::finish()
+{
+	int c, k;
+	for(c=0;c<columns*rows;c++){
+		int cx = c%columns, cy = c/columns, best = distance[c];
+		way[c] = -1;
+		if(best == FLOW_UNREACHED)
+			continue;
+		for(k=0;k<8;k++){
+			if(!canStep(cx, cy, k))
+				continue;
+			int d = distance[(cy + stepY[k])*columns + cx + stepX[k]];
+			if(d < best){
+				best = d;
+				way[c] = k;
+			}
+		}
+	}
+	searching = false;
+}
+
+bool FlowField::direction(float x, float y, float& dx, float& dy) const
+{
+	if(empty())
+		return false;
+	int c = cellAt(x, y), k = way[c];
+	if(k < 0)
+		return false;
+	dx = x0 + (c%columns + stepX[k] + 0.5f)*cell - x;
+	dy = y0 + (c/columns + stepY[k] + 0.5f)*cell - y;
+	float length = sqrt(dx*dx + dy*dy);
+	if(length == 0)
+		return false;
+	dx /= length;
+	dy /= length;
+	return true;
+}
@@ -0,0 +1,70 @@
+#ifndef FLOWFIELD_H
+#define FLOWFIELD_H
+
+#include <vector>
+
+/* Steps between two cells cost FLOW_STRAIGHT along a side and FLOW_DIAGONAL across a
+   corner, about ten times the distance in cells */
+#define FLOW_STRAIGHT 10
+#define FLOW_DIAGONAL 14
+#define FLOW_UNREACHED 0x7fffffff
+
+/* A cell waiting to be settled, and its distance when it was put in */
+struct FlowNode {
+	int distance;
+	int cell;
+};
+
+/* Distances to a target over a grid of cells, found by Dijkstra from the target outwards,
+   and in each cell the way to the neighbour nearest to the target. Any number of chasers
+   share the field, each only looks up its own cell, and it leads them around the blocked
+   cells. A diagonal step never cuts the corner of a blocked cell.
+   The search goes on for a budget of cells per update(); until it is done the chasers
+   keep following the field the last one left, which still leads near the target. When
+   the target moves to another cell the last field is repaired rather than searched over:
+   it takes the old distances plus the distance between the two targets, which can be no
+   shorter than the new ones, and only settles the cells whose distance comes out shorter.
+   Those on the far side of the old target keep theirs untouched. A target that moves
+   while a search goes on waits for it to be done, so a bird that crosses a cell every
+   step still gets fields. When the blocked cells change the distances may grow, and the
+   search starts over from nothing. */
+class FlowField {
+	int columns, rows;
+	float x0, y0, cell;
+	std::vector<unsigned char> blocked;
+	std::vector<int> distance;	// of the search going on, or the last one done
+	std::vector<FlowNode> open;	// heap of the cells the search reached
+	std::vector<signed char> way;	// of the last search done, per cell the neighbour to go to or -1
+	int targetCell;			// where the target is
+	int searchCell;			// where it was when the search going on or the last one started
+	bool reblocked;			// the blocked cells changed since the search started
+	bool searching;
+
+	int cellAt(float x, float y) const;
+	bool canStep(int cx, int cy, int k) const;
+	void start();
+	void finish();
+
+	public:
+	int searches;		// started so far
+	int repairs;		// of them, the ones that started from the last field
+	int settled;		// cells the last update() settled
+
+	FlowField();
+	/* columns by rows cells of size cell from x0, y0, none blocked */
+	void resize(int columns, int rows, float x0, float y0, float cell);
+	void clear();
+	bool empty() const{
+		return columns == 0;
+	}
+	void clearBlocked();
+	/* Blocks the cells whose centres are within r of x, y */
+	void block(float x, float y, float r);
+	void setTarget(float x, float y);
+	void update(int budget);
+	/* From x, y towards the centre of the next cell on the way, of length 1; false in a
+	   blocked or unreached cell and in the target's, where there is no way to follow */
+	bool direction(float x, float y, float& dx, float& dy) const;
+};
+
+#endif
@@ -0,0 +1,189 @@
+#include <cstring>
+#include <algorithm>
+#include "forcefield.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#endif
+
+using namespace std;
+
+ForceField::ForceField()
+{
+	storage = cells = NULL;
+	columns = rows = 0;
+	x0 = y0 = 0;
+	cell = inverse = 1;
+}
+
+ForceField::ForceField(const ForceField& other)
+{
+	storage = cells = NULL;
+	columns = rows = 0;
+	*this = other;
+}
+
+ForceField& ForceField::operator=(const ForceField& other)
+{
+	if(this == &other)
+		return *this;
+	// The same size is copied into the cells there are
+	if(other.columns*other.rows != columns*rows)
+		allocate(other.columns*other.rows);
+	columns = other.columns;
+	rows = other.rows;
+	x0 = other.x0;
+	y0 = other.y0;
+	cell = other.cell;
+	inverse = other.inverse;
+	if(cells)
+		memcpy(cells, other.cells, sizeof(float)*FORCE_CELL_FLOATS*columns*rows);
+	return *this;
+}
+
+ForceField::~ForceField()
+{
+	delete[] storage;
+}
+
+void ForceField::allocate(int n)
+{
+	delete[] storage;
+	storage = cells = NULL;
+	if(n == 0)
+		return;
+	storage = new float[n*FORCE_CELL_FLOATS + FORCE_ALIGN/sizeof(float)];
+	size_t address = (size_t)storage;
+	cells = (float*)((address + FORCE_ALIGN - 1) & ~(size_t)(FORCE_ALIGN - 1));
+}
+
+void ForceField::resize(int columns, int rows, float x0, float y0, float cell)
+{
+	if(columns*rows != this->columns*this->rows)
+		allocate(columns*rows);
+	this->columns = columns;
+	this->rows = rows;
+	this->x0 = x0;
+	this->y0 = y0;
+	this->cell = cell;
+	inverse = 1/cell;
+	if(cells)
+		memset(cells, 0, sizeof(float)*FORCE_CELL_FLOATS*columns*rows);
+}
+
+void ForceField::clear()
+{
+	allocate(0);
+	columns = rows = 0;
+}
+
+/* Node i, j is a corner of up to four cells */
+void ForceField::setNode(int i, int j, float ax, float ay)
+{
+	int di, dj;
+	for(dj=0;dj<2;dj++){
+		for(di=0;di<2;di++){
+			int ci = i - di, cj = j - dj;
+			if(ci < 0 || cj < 0 || ci >= columns || cj >= rows)
+				continue;
+			float* c = cells + FORCE_CELL_FLOATS*(cj*columns + ci);
+			c[2*dj + di] = ax;
+			c[4 + 2*dj + di] = ay;
+		}
+	}
+}
+
+/* Where x, y is: the cell, and how far across it, clamped to the grid */
+static inline int locate(float x, float y, float x0, float y0, float inverse, int columns, int rows, float& fx, float& fy)
+{
+	float gx = min(max((x - x0)*inverse, 0.0f), (float)columns);
+	float gy = min(max((y - y0)*inverse, 0.0f), (float)rows);
+	int ix = (int)min(gx, columns - 1.0f), iy = (int)min(gy, rows - 1.0f);
+	fx = gx - ix;
+	fy = gy - iy;
+	return iy*columns + ix;
+}
+
+void ForceField::sample(float x, float y, float& ax, float& ay) const
+{
+	float fx, fy;
+	ax = ay = 0;
+	if(!columns)
+		return;
+	const float* c = cells + FORCE_CELL_FLOATS*locate(x, y, x0, y0, inverse, columns, rows, fx, fy);
+	float w00 = (1 - fx)*(1 - fy), w10 = fx*(1 - fy), w01 = (1 - fx)*fy, w11 = fx*fy;
+	ax = c[0]*w00 + c[1]*w10 + c[2]*w01 + c[3]*w11;
+	ay = c[4]*w00 + c[5]*w10 + c[6]*w01 + c[7]*w11;
+}
+
+void ForceField::apply(const float* x, const float* y, float* vx, float* vy, int n, float dt) const
+{
+	int i = 0;
+	float ax, ay;
+	if(!columns)
+		return;
+#if defined(__AVX2__)
+	__m256 origx = _mm256_set1_ps(x0), origy = _mm256_set1_ps(y0), inv = _mm256_set1_ps(inverse);
+	__m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1), step = _mm256_set1_ps(dt);
+	__m256 right = _mm256_set1_ps(columns), top = _mm256_set1_ps(rows);
+	__m256 lastx = _mm256_set1_ps(columns - 1), lasty = _mm256_set1_ps(rows - 1);
+	__m256i width = _mm256_set1_epi32(columns);
+	for(;i+8<=n;i+=8){
+		__m256 gx = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(x+i), origx), inv), zero), right);
+		__m256 gy = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(y+i), origy), inv), zero), top);
+		__m256i ix = _mm256_cvttps_epi32(_mm256_min_ps(gx, lastx)), iy = _mm256_cvttps_epi32(_mm256_min_ps(gy, lasty));
+		__m256 fx = _mm256_sub_ps(gx, _mm256_cvtepi32_ps(ix)), fy = _mm256_sub_ps(gy, _mm256_cvtepi32_ps(iy));
+		__m256 gx1 = _mm256_sub_ps(one, fx), gy1 = _mm256_sub_ps(one, fy);
+		__m256 w00 = _mm256_mul_ps(gx1, gy1), w10 = _mm256_mul_ps(fx, gy1), w01 = _mm256_mul_ps(gx1, fy), w11 = _mm256_mul_ps(fx, fy);
+		__m256i base = _mm256_slli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(iy, width), ix), 3);
+		__m256 sx = _mm256_mul_ps(_mm256_i32gather_ps(cells, base, 4), w00);
+		sx = _mm256_add_ps(sx, _mm256_mul_ps(_mm256_i32gather_ps(cells + 1, base, 4), w10));
+		sx = _mm256_add_ps(sx, _mm256_mul_ps(_mm256_i32gather_ps(cells + 2, base, 4), w01));
+		sx = _mm256_add_ps(sx, _mm256_mul_ps(_mm256_i32gather_ps(cells + 3, base, 4), w11));
+		__m256 sy = _mm256_mul_ps(_mm256_i32gather_ps(cells + 4, base, 4), w00);
+		sy = _mm256_add_ps(sy, _mm256_mul_ps(_mm256_i32gather_ps(cells + 5, base, 4), w10));
+		sy = _mm256_add_ps(sy, _mm256_mul_ps(_mm256_i32gather_ps(cells + 6, base, 4), w01));
+		sy = _mm256_add_ps(sy, _mm256_mul_ps(_mm256_i32gather_ps(cells + 7, base, 4), w11));
+		_mm256_storeu_ps(vx+i, _mm256_add_ps(_mm256_loadu_ps(vx+i), _mm256_mul_ps(sx, step)));
+		_mm256_storeu_ps(vy+i, _mm256_add_ps(_mm256_loadu_ps(vy+i), _mm256_mul_ps(sy, step)));
+	}
+#elif defined(__SSE2__)
+	int k, c[4];
+	__m128 origx = _mm_set1_ps(x0), origy = _mm_set1_ps(y0), inv = _mm_set1_ps(inverse);
+	__m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1), step = _mm_set1_ps(dt);
+	__m128 right = _mm_set1_ps(columns), top = _mm_set1_ps(rows);
+	__m128 lastx = _mm_set1_ps(columns - 1), lasty = _mm_set1_ps(rows - 1);
+	for(;i+4<=n;i+=4){
+		__m128 gx = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(x+i), origx), inv), zero), right);
+		__m128 gy = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(y+i), origy), inv), zero), top);
+		__m128i ix = _mm_cvttps_epi32(_mm_min_ps(gx, lastx)), iy = _mm_cvttps_epi32(_mm_min_ps(gy, lasty));
+		__m128 fx = _mm_sub_ps(gx, _mm_cvtepi32_ps(ix)), fy = _mm_sub_ps(gy, _mm_cvtepi32_ps(iy));
+		__m128 gx1 = _mm_sub_ps(one, fx), gy1 = _mm_sub_ps(one, fy);
+		__m128 w00 = _mm_mul_ps(gx1, gy1), w10 = _mm_mul_ps(fx, gy1), w01 = _mm_mul_ps(gx1, fy), w11 = _mm_mul_ps(fx, fy);
+		int cx[4], cy[4];
+		_mm_storeu_si128((__m128i*)cx, ix);
+		_mm_storeu_si128((__m128i*)cy, iy);
+		for(k=0;k<4;k++)
+			c[k] = FORCE_CELL_FLOATS*(cy[k]*columns + cx[k]);
+		// Four records side by side, turned into corner 00, 10, 01, 11 of all four points
+		__m128 c00 = _mm_load_ps(cells + c[0]), c10 = _mm_load_ps(cells + c[1]), c01 = _mm_load_ps(cells + c[2]), c11 = _mm_load_ps(cells + c[3]);
+		_MM_TRANSPOSE4_PS(c00, c10, c01, c11);
+		__m128 sx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c00, w00), _mm_mul_ps(c10, w10)), _mm_mul_ps(c01, w01)), _mm_mul_ps(c11, w11));
+		c00 = _mm_load_ps(cells + c[0] + 4);
+		c10 = _mm_load_ps(cells + c[1] + 4);
+		c01 = _mm_load_ps(cells + c[2] + 4);
+		c11 = _mm_load_ps(cells + c[3] + 4);
+		_MM_TRANSPOSE4_PS(c00, c10, c01, c11);
+		__m128 sy = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c00, w00), _mm_mul_ps(c10, w10)), _mm_mul_ps(c01, w01)), _mm_mul_ps(c11, w11));
+		_mm_storeu_ps(vx+i, _mm_add_ps(_mm_loadu_ps(vx+i), _mm_mul_ps(sx, step)));
+		_mm_storeu_ps(vy+i, _mm_add_ps(_mm_loadu_ps(vy+i), _mm_mul_ps(sy, step)));
+	}
+#endif
+	for(;i<n;i++){
+		sample(x[i], y[i], ax, ay);
+		vx[i] += ax*dt;
+		vy[i] += ay*dt;
+	}
+}
@@ -0,0 +1,57 @@
+#ifndef FORCEFIELD_H
+#define FORCEFIELD_H
+
+/* Cells start on FORCE_ALIGN bytes and are FORCE_CELL_FLOATS floats long, so no cell
+   straddles a cache line */
+#define FORCE_ALIGN 64
+#define FORCE_CELL_FLOATS 8
+
+/* An acceleration given at the nodes of a regular grid and interpolated bilinearly in
+   between; points off the grid get the value at the nearest edge. Each cell keeps the
+   values of its own four corners, x then y:
+	ax00 ax10 ax01 ax11 ay00 ay10 ay01 ay11
+   so one sample reads one aligned 32 byte record. apply() samples lanes of points at
+   once, as wide as the build allows (see collide.h): with AVX2 8, gathering the corners,
+   with SSE2 4, transposing four records. */
+class ForceField {
+	float* storage;		// as allocated
+	float* cells;		// aligned, rows of columns cells
+	int columns, rows;
+	float x0, y0;
+	float cell, inverse;	// size of a cell and its inverse
+
+	void allocate(int n);
+
+	public:
+	ForceField();
+	ForceField(const ForceField& other);
+	ForceField& operator=(const ForceField& other);
+	~ForceField();
+
+	/* columns by rows cells of size cell from x0, y0, all nodes at 0 */
+	void resize(int columns, int rows, float x0, float y0, float cell);
+	void clear();
+	bool empty() const{
+		return columns == 0;
+	}
+	int nodeColumns() const{
+		return columns + 1;
+	}
+	int nodeRows() const{
+		return rows + 1;
+	}
+	float nodeX(int i) const{
+		return x0 + i*cell;
+	}
+	float nodeY(int j) const{
+		return y0 + j*cell;
+	}
+	void setNode(int i, int j, float ax, float ay);
+
+	void sample(float x, float y, float& ax, float& ay) const;
+	/* Adds dt times the field at each of the n points to its velocity. Only reads the
+	   field, several threads can apply it at once. */
+	void apply(const float* x, const float* y, float* vx, float* vy, int n, float dt) const;
+};
+
+#endif
@@ -0,0 +1,161 @@
+#include <cmath>
+#include "fracture.h"
+
+using namespace std;
+
+FracturePattern fracturePatterns[FRACTURE_PATTERNS];
+
+/* A fixed sequence in [0, 1), so the patterns do not depend on rand() */
+static float nextUniform(unsigned int& seed)
+{
+	seed = seed*1664525u + 1013904223u;
+	return (seed >> 8)*(1.0f/16777216);
+}
+
+/* Sutherland-Hodgman against one half plane, the side of (x, y) where
+   nx*x + ny*y <= d; the polygon is convex, so it stays convex */
+static int clipPolygon(float* x, float* y, int n, float nx, float ny, float d)
+{
+	int i, m = 0;
+	float cx[FRACTURE_CORNERS + 1], cy[FRACTURE_CORNERS + 1];
+	for(i=0;i<n;i++){
+		int j = (i + 1)%n;
+		float a = nx*x[i] + ny*y[i] - d, b = nx*x[j] + ny*y[j] - d;
+		if(a <= 0){
+			cx[m] = x[i];
+			cy[m] = y[i];
+			m++;
+		}
+		if((a < 0 && b > 0) || (a > 0 && b < 0)){
+			float t = a/(a - b);
+			cx[m] = x[i] + t*(x[j] - x[i]);
+			cy[m] = y[i] + t*(y[j] - y[i]);
+			m++;
+		}
+	}
+	for(i=0;i<m;i++){
+		x[i] = cx[i];
+		y[i] = cy[i];
+	}
+	return m;
+}
+
+static bool inOutline(float px, float py)
+{
+	int i;
+	for(i=0;i<FRACTURE_SIDES;i++){
+		float a = (2*i + 1)*M_PI/FRACTURE_SIDES;	// the normal of side i
+		if(cos(a)*px + sin(a)*py > cos(M_PI/FRACTURE_SIDES))
+			return false;
+	}
+	return true;
+}
+
+void buildFracturePatterns()
+{
+	int p, i, j, k;
+	float sx[FRACTURE_PIECES], sy[FRACTURE_PIECES];
+	for(p=0;p<FRACTURE_PATTERNS;p++){
+		unsigned int seed = 7919*(p + 1);
+		for(i=0;i<FRACTURE_PIECES;){
+			sx[i] = 2*nextUniform(seed) - 1;
+			sy[i] = 2*nextUniform(seed) - 1;
+			if(inOutline(sx[i], sy[i]))
+				i++;
+		}
+		for(i=0;i<FRACTURE_PIECES;i++){
+			FracturePiece& piece = fracturePatterns[p].pieces[i];
+			float x[FRACTURE_CORNERS + 1], y[FRACTURE_CORNERS + 1];
+			int n = FRACTURE_SIDES;
+			for(k=0;k<n;k++){
+				x[k] = cos(2*k*M_PI/FRACTURE_SIDES);
+				y[k] = sin(2*k*M_PI/FRACTURE_SIDES);
+			}
+			// Closer to seed i than to seed j
+			for(j=0;j<FRACTURE_PIECES;j++){
+				if(j == i)
+					continue;
+				float nx = sx[j] - sx[i], ny = sy[j] - sy[i];
+				n = clipPolygon(x, y, n, nx, ny, nx*(sx[i] + sx[j])/2 + ny*(sy[i] + sy[j])/2);
+			}
+			float area = 0, cx = 0, cy = 0;
+			for(k=0;k<n;k++){
+				int l = (k + 1)%n;
+				float cross = x[k]*y[l] - x[l]*y[k];
+				area += cross;
+				cx += (x[k] + x[l])*cross;
+				cy += (y[k] + y[l])*cross;
+			}
+			piece.cx = cx/(3*area);
+			piece.cy = cy/(3*area);
+			piece.corners = n;
+			piece.radius = 0;
+			for(k=0;k<n;k++){
+				piece.x[k] = x[k] - piece.cx;
+				piece.y[k] = y[k] - piece.cy;
+				piece.radius = max(piece.radius, sqrt(piece.x[k]*piece.x[k] + piece.y[k]*piece.y[k]));
+			}
+		}
+	}
+}
+
+Debris* DebrisPool::spawn()
+{
+	if((int)pieces.size() >= MAX_DEBRIS)
+		return NULL;
+	pieces.push_back(Debris());
+	return &pieces.back();
+}
+
+void DebrisPool::savePrevious()
+{
+	int i;
+	for(i=0;i<(int)pieces.size();i++){
+		pieces[i].prevx = pieces[i].x;
+		pieces[i].prevy = pieces[i].y;
+		pieces[i].prevAngle = pieces[i].angle;
+	}
+}
+
+float DebrisPool::bottom(const Debris& d)
+{
+	int k;
+	const FracturePiece& piece = fracturePatterns[d.pattern].pieces[d.piece];
+	float s = sin(d.angle*M_PI/180), c = cos(d.angle*M_PI/180), lowest = 0;
+	for(k=0;k<piece.corners;k++)
+		lowest = min(lowest, s*piece.x[k] + c*piece.y[k]);
+	return d.y + d.size*lowest;
+}
+
+void DebrisPool::update(float dt, float gravity, float floor, float left, float right)
+{
+	int i;
+	for(i=0;i<(int)pieces.size();){
+		Debris& d = pieces[i];
+		d.vy -= gravity*dt;
+		d.x += d.vx*dt;
+		d.y += d.vy*dt;
+		d.angle += d.spin*dt;
+		d.age += dt;
+		float r = d.size*fracturePatterns[d.pattern].pieces[d.piece].radius;
+		if((d.x - r < left && d.vx < 0) || (d.x + r > right && d.vx > 0))
+			d.vx = -DEBRIS_BOUNCE*d.vx;
+		float low = bottom(d);
+		bool still = false;
+		if(low < floor){
+			d.y += floor - low;
+			if(d.vy < 0)
+				d.vy = -DEBRIS_BOUNCE*d.vy;
+			d.vx *= DEBRIS_FRICTION;
+			d.spin *= DEBRIS_FRICTION;
+			still = fabs(d.vx) + fabs(d.vy) < DEBRIS_REST_SPEED;
+		}
+		d.rest = still ? d.rest + dt : 0;
+		if(d.rest >= DEBRIS_SETTLE || d.age >= DEBRIS_LIFETIME){
+			pieces[i] = pieces.back();
+			pieces.pop_back();
+			continue;
+		}
+		i++;
+	}
+}
@@ -0,0 +1,74 @@
+#ifndef FRACTURE_H
+#define FRACTURE_H
+
+#include <vector>
+
+/* An obstacle shatters along one of FRACTURE_PATTERNS patterns, cut once at load time: the
+   Voronoi cells of FRACTURE_PIECES points scattered over its outline, the regular
+   pentagon of radius 1 with a corner on the x axis that the renderer draws */
+#define FRACTURE_PATTERNS 4
+#define FRACTURE_PIECES 6
+#define FRACTURE_SIDES 5
+#define FRACTURE_CORNERS (FRACTURE_SIDES + FRACTURE_PIECES - 1)	// most a cell can have
+
+/* A cell, in units of the obstacle's radius, its corners counterclockwise around its centroid */
+struct FracturePiece {
+	float cx, cy;		// the centroid, from the centre of the obstacle
+	float radius;		// to the farthest corner
+	int corners;
+	float x[FRACTURE_CORNERS], y[FRACTURE_CORNERS];
+};
+
+struct FracturePattern {
+	FracturePiece pieces[FRACTURE_PIECES];
+};
+
+/* The same on every run; built by buildFracturePatterns(), once is enough */
+extern FracturePattern fracturePatterns[FRACTURE_PATTERNS];
+void buildFracturePatterns();
+
+/* A loose piece of a shattered obstacle */
+struct Debris {
+	float x, y, prevx, prevy;
+	float vx, vy;		// per second
+	float angle, prevAngle;	// degrees, like Transform
+	float spin;		// degrees per second
+	float size;		// radius of the obstacle it came from
+	int pattern, piece;
+	float rest;		// seconds it has lain still
+	float age;
+};
+
+/* The debris flies with gravity, bounces off the floor and the walls and nothing else, and
+   is recycled once it lay still for DEBRIS_SETTLE seconds, or at the latest after
+   DEBRIS_LIFETIME */
+#define MAX_DEBRIS 1024
+#define DEBRIS_BOUNCE 0.3
+#define DEBRIS_FRICTION 0.6	// of the speed along the floor and the spin kept at a bounce
+#define DEBRIS_REST_SPEED 0.05
+#define DEBRIS_SETTLE 0.5
+#define DEBRIS_LIFETIME 10
+
+/* Pieces in a pool of fixed size: the live ones are packed at the front, one that is
+   recycled is replaced by the last. Nothing is allocated after reserve(); spawn() gives
+   NULL while the pool is full. */
+struct DebrisPool {
+	std::vector<Debris> pieces;
+
+	void reserve(){
+		pieces.reserve(MAX_DEBRIS);
+	}
+	void clear(){
+		pieces.clear();
+	}
+	int count(){
+		return pieces.size();
+	}
+	Debris* spawn();
+	void savePrevious();
+	void update(float dt, float gravity, float floor, float left, float right);
+	/* Height of the lowest corner of the piece, as it is turned now */
+	float bottom(const Debris& d);
+};
+
+#endif
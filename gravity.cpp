@@ -0,0 +1,134 @@
+#include <cmath>
+#include <algorithm>
+#include "gravity.h"
+
+using namespace std;
+
+GravityTree::GravityTree()
+{
+	strength = 1;
+	softening = 0.2;
+	theta = GRAVITY_THETA;
+}
+
+void GravityTree::reserve(int n)
+{
+	masses.reserve(n);
+	nodes.reserve(2*n + 1);
+}
+
+void GravityTree::clear()
+{
+	masses.clear();
+	nodes.clear();
+}
+
+void GravityTree::add(float x, float y, float mass)
+{
+	GravityMass m = { x, y, mass };
+	masses.push_back(m);
+}
+
+struct LeftOf {
+	float x;
+	bool operator()(const GravityMass& m) const {
+		return m.x < x;
+	}
+};
+
+struct Below {
+	float y;
+	bool operator()(const GravityMass& m) const {
+		return m.y < y;
+	}
+};
+
+/* The masses of the cell are split into its quadrants in place: left below, left above,
+   right below, right above. The children of a node are next to each other. */
+void GravityTree::buildNode(int n, int first, int count, float x0, float y0, float size, int depth)
+{
+	int i;
+	GravityNode node = { 0, 0, 0, size, 0, first, count };
+	for(i=first;i<first+count;i++){
+		node.x += masses[i].mass*masses[i].x;
+		node.y += masses[i].mass*masses[i].y;
+		node.mass += masses[i].mass;
+	}
+	if(node.mass > 0){
+		node.x /= node.mass;
+		node.y /= node.mass;
+	}
+	if(count > GRAVITY_LEAF && depth < GRAVITY_DEPTH){
+		float half = size/2;
+		LeftOf left = { x0 + half };
+		Below lower = { y0 + half };
+		vector<GravityMass>::iterator begin = masses.begin() + first, end = begin + count;
+		vector<GravityMass>::iterator mid = partition(begin, end, left);
+		vector<GravityMass>::iterator leftMid = partition(begin, mid, lower);
+		vector<GravityMass>::iterator rightMid = partition(mid, end, lower);
+		int a = leftMid - begin, b = mid - begin, c = rightMid - begin;
+		node.child = nodes.size();
+		node.count = 0;
+		nodes.resize(nodes.size() + 4);
+		buildNode(node.child, first, a, x0, y0, half, depth + 1);
+		buildNode(node.child + 1, first + a, b - a, x0, y0 + half, half, depth + 1);
+		buildNode(node.child + 2, first + b, c - b, x0 + half, y0, half, depth + 1);
+		buildNode(node.child + 3, first + c, count - c, x0 + half, y0 + half, half, depth + 1);
+	}
+	nodes[n] = node;
+}
+
+void GravityTree::build()
+{
+	int i;
+	nodes.clear();
+	if(masses.empty())
+		return;
+	float x0 = masses[0].x, y0 = masses[0].y, x1 = x0, y1 = y0;
+	for(i=1;i<(int)masses.size();i++){
+		x0 = min(x0, masses[i].x);
+		y0 = min(y0, masses[i].y);
+		x1 = max(x1, masses[i].x);
+		y1 = max(y1, masses[i].y);
+	}
+	// A little larger, so the masses on the far sides fall inside
+	float size = max(x1 - x0, y1 - y0)*1.001f + 1e-4f;
+	nodes.resize(1);
+	buildNode(0, 0, masses.size(), x0, y0, size, 0);
+}
+
+void GravityTree::field(float x, float y, float& ax, float& ay) const
+{
+	int i, top = 0;
+	int stack[3*GRAVITY_DEPTH + 4];
+	float e2 = softening*softening, t2 = theta*theta;
+	ax = ay = 0;
+	if(nodes.empty())
+		return;
+	stack[top++] = 0;
+	while(top){
+		const GravityNode& node = nodes[stack[--top]];
+		if(node.mass == 0)
+			continue;
+		float dx = node.x - x, dy = node.y - y, d2 = dx*dx + dy*dy;
+		if(node.child && node.size*node.size >= t2*d2){
+			for(i=0;i<4;i++)
+				stack[top++] = node.child + i;
+			continue;
+		}
+		if(node.child){
+			float r2 = d2 + e2, pull = strength*node.mass/(r2*sqrt(r2));
+			ax += pull*dx;
+			ay += pull*dy;
+			continue;
+		}
+		for(i=node.first;i<node.first+node.count;i++){
+			const GravityMass& m = masses[i];
+			dx = m.x - x;
+			dy = m.y - y;
+			float r2 = dx*dx + dy*dy + e2, pull = strength*m.mass/(r2*sqrt(r2));
+			ax += pull*dx;
+			ay += pull*dy;
+		}
+	}
+}
@@ -0,0 +1,54 @@
+#ifndef GRAVITY_H
+#define GRAVITY_H
+
+#include <vector>
+
+/* A cell whose size is below GRAVITY_THETA times its distance pulls as one mass from its
+   centre of mass. Leaves hold up to GRAVITY_LEAF masses, the tree is no deeper than
+   GRAVITY_DEPTH however close the masses are. */
+#define GRAVITY_THETA 0.5
+#define GRAVITY_LEAF 4
+#define GRAVITY_DEPTH 24
+
+struct GravityMass {
+	float x, y;
+	float mass;
+};
+
+/* Square cells; inner nodes have their four children at child .. child+3, leaves have
+   child 0 and the masses first .. first+count-1 */
+struct GravityNode {
+	float x, y;		// centre of mass
+	float mass;
+	float size;
+	int child;
+	int first, count;
+};
+
+/* Barnes-Hut quadtree over point masses. Built in O(n log n), after which the pull at a
+   point sums O(log n) cells instead of all n masses. The pull is softened as if each mass
+   were spread over softening around it, so it stays finite at and near the masses. */
+class GravityTree {
+	std::vector<GravityMass> masses;	// in tree order after build()
+	std::vector<GravityNode> nodes;
+
+	void buildNode(int n, int first, int count, float x0, float y0, float size, int depth);
+
+	public:
+	float strength;		// the gravitational constant
+	float softening;
+	float theta;
+
+	GravityTree();
+	void reserve(int n);
+	void clear();
+	void add(float x, float y, float mass);
+	void build();
+	int size() const{
+		return masses.size();
+	}
+	/* The acceleration at x, y. Only reads the tree, any number of threads can ask at once. */
+	void field(float x, float y, float& ax, float& ay) const;
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include <cmath>
+#include "integrate.h"
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void ProjectileSet::reserve(int n)
+{
+	x.reserve(n);
+	y.reserve(n);
+	vx.reserve(n);
+	vy.reserve(n);
+}
+
+int ProjectileSet::add(Vec2 position, Vec2 velocity)
+{
+	if(count == (int)x.size()){
+		x.push_back(0);
+		y.push_back(0);
+		vx.push_back(0);
+		vy.push_back(0);
+	}
+	x[count] = position.x;
+	y[count] = position.y;
+	vx[count] = velocity.x;
+	vy[count] = velocity.y;
+	return count++;
+}
+
+/* The arithmetic the integrators need, for one float and for a register of them, so that
+   the same code does a whole lane of projectiles and the ones left over */
+template <class V> static inline V splat(float a);
+template <class V> static inline V load(const float* p);
+
+template <> inline float splat<float>(float a){ return a; }
+template <> inline float load<float>(const float* p){ return *p; }
+static inline void store(float* p, float a){ *p = a; }
+static inline float add(float a, float b){ return a + b; }
+static inline float sub(float a, float b){ return a - b; }
+static inline float mul(float a, float b){ return a * b; }
+static inline float root(float a){ return sqrtf(a); }
+
+#if defined(__AVX512F__)
+#define PROJECTILE_LANES 16
+typedef __m512 Lanes;
+template <> inline Lanes splat<Lanes>(float a){ return _mm512_set1_ps(a); }
+template <> inline Lanes load<Lanes>(const float* p){ return _mm512_loadu_ps(p); }
+static inline void store(float* p, Lanes a){ _mm512_storeu_ps(p, a); }
+static inline Lanes add(Lanes a, Lanes b){ return _mm512_add_ps(a, b); }
+static inline Lanes sub(Lanes a, Lanes b){ return _mm512_sub_ps(a, b); }
+static inline Lanes mul(Lanes a, Lanes b){ return _mm512_mul_ps(a, b); }
+static inline Lanes root(Lanes a){ return _mm512_sqrt_ps(a); }
+#elif defined(__AVX2__)
+#define PROJECTILE_LANES 8
+typedef __m256 Lanes;
+template <> inline Lanes splat<Lanes>(float a){ return _mm256_set1_ps(a); }
+template <> inline Lanes load<Lanes>(const float* p){ return _mm256_loadu_ps(p); }
+static inline void store(float* p, Lanes a){ _mm256_storeu_ps(p, a); }
+static inline Lanes add(Lanes a, Lanes b){ return _mm256_add_ps(a, b); }
+static inline Lanes sub(Lanes a, Lanes b){ return _mm256_sub_ps(a, b); }
+static inline Lanes mul(Lanes a, Lanes b){ return _mm256_mul_ps(a, b); }
+static inline Lanes root(Lanes a){ return _mm256_sqrt_ps(a); }
+#elif defined(__SSE2__)
+#define PROJECTILE_LANES 4
+typedef __m128 Lanes;
+template <> inline Lanes splat<Lanes>(float a){ return _mm_set1_ps(a); }
+template <> inline Lanes load<Lanes>(const float* p){ return _mm_loadu_ps(p); }
+static inline void store(float* p, Lanes a){ _mm_storeu_ps(p, a); }
+static inline Lanes add(Lanes a, Lanes b){ return _mm_add_ps(a, b); }
+static inline Lanes sub(Lanes a, Lanes b){ return _mm_sub_ps(a, b); }
+static inline Lanes mul(Lanes a, Lanes b){ return _mm_mul_ps(a, b); }
+static inline Lanes root(Lanes a){ return _mm_sqrt_ps(a); }
+#endif
+
+/* Acceleration at velocity v: gravity g down and drag k*|v|*v against it */
+template <class V> static inline void accelerate(V vx, V vy, V g, V k, V& ax, V& ay)
+{
+	V s = mul(k, root(add(mul(vx, vx), mul(vy, vy))));
+	ax = sub(splat<V>(0), mul(s, vx));
+	ay = sub(splat<V>(0), add(g, mul(s, vy)));
+}
+
+/* substeps of h each; the acceleration depends on the velocity only, so the stages of
+   RK4 need no positions */
+template <class V> static inline void integrate(float* px, float* py, float* pvx, float* pvy, float dt, const FlightParams& params)
+{
+	int i;
+	int substeps = params.substeps > 0 ? params.substeps : 1;
+	V x = load<V>(px), y = load<V>(py), vx = load<V>(pvx), vy = load<V>(pvy);
+	V h = splat<V>(dt / substeps), g = splat<V>(params.gravity), k = splat<V>(params.drag);
+	V ax, ay;
+	if(params.model == FLIGHT_RK4){
+		V half = splat<V>(0.5f*dt / substeps), sixth = splat<V>(dt / substeps / 6), two = splat<V>(2);
+		for(i=0;i<substeps;i++){
+			V k1x, k1y, k2x, k2y, k3x, k3y, k4x, k4y;
+			accelerate(vx, vy, g, k, k1x, k1y);
+			V v2x = add(vx, mul(half, k1x)), v2y = add(vy, mul(half, k1y));
+			accelerate(v2x, v2y, g, k, k2x, k2y);
+			V v3x = add(vx, mul(half, k2x)), v3y = add(vy, mul(half, k2y));
+			accelerate(v3x, v3y, g, k, k3x, k3y);
+			V v4x = add(vx, mul(h, k3x)), v4y = add(vy, mul(h, k3y));
+			accelerate(v4x, v4y, g, k, k4x, k4y);
+			x = add(x, mul(sixth, add(add(vx, v4x), mul(two, add(v2x, v3x)))));
+			y = add(y, mul(sixth, add(add(vy, v4y), mul(two, add(v2y, v3y)))));
+			vx = add(vx, mul(sixth, add(add(k1x, k4x), mul(two, add(k2x, k3x)))));
+			vy = add(vy, mul(sixth, add(add(k1y, k4y), mul(two, add(k2y, k3y)))));
+		}
+	}
+	else{
+		for(i=0;i<substeps;i++){
+			accelerate(vx, vy, g, k, ax, ay);
+			vx = add(vx, mul(h, ax));
+			vy = add(vy, mul(h, ay));
+			x = add(x, mul(h, vx));
+			y = add(y, mul(h, vy));
+		}
+	}
+	store(px, x);
+	store(py, y);
+	store(pvx, vx);
+	store(pvy, vy);
+}
+
+void advanceProjectiles(float* x, float* y, float* vx, float* vy, int n, float dt, const FlightParams& params)
+{
+	int i = 0;
+#ifdef PROJECTILE_LANES
+	for(;i+PROJECTILE_LANES<=n;i+=PROJECTILE_LANES)
+		integrate<Lanes>(x+i, y+i, vx+i, vy+i, dt, params);
+#endif
+	for(;i<n;i++)
+		integrate<float>(x+i, y+i, vx+i, vy+i, dt, params);
+}
@@ -0,0 +1,64 @@
+#ifndef INTEGRATE_H
+#define INTEGRATE_H
+
+#include <vector>
+
+struct Vec2 {
+	float x, y;
+};
+
+inline Vec2 vec2(float x, float y){
+	Vec2 v = { x, y };
+	return v;
+}
+inline Vec2 operator+(Vec2 a, Vec2 b){
+	return vec2(a.x + b.x, a.y + b.y);
+}
+inline Vec2 operator-(Vec2 a, Vec2 b){
+	return vec2(a.x - b.x, a.y - b.y);
+}
+inline Vec2 operator*(float s, Vec2 a){
+	return vec2(s*a.x, s*a.y);
+}
+inline float dot(Vec2 a, Vec2 b){
+	return a.x*b.x + a.y*b.y;
+}
+
+/* FLIGHT_PARABOLA is the closed form trajectory the game always had, FLIGHT_FIXED the same
+   in fixed point (see fixed.h). The others integrate position and velocity: semi-implicit
+   Euler updates the velocity first and moves with the new one, RK4 is the classic fourth
+   order Runge-Kutta. */
+enum FlightModel { FLIGHT_PARABOLA, FLIGHT_EULER, FLIGHT_RK4, FLIGHT_FIXED };
+
+/* Gravity pulls down, drag pulls against the velocity with drag*|v|*v */
+struct FlightParams {
+	int model;
+	float gravity;
+	float drag;
+	int substeps;	// per advance, each of dt/substeps
+};
+
+/* Advance n projectiles by dt, positions x, y and velocities vx, vy in place. Lanes of
+   projectiles are done at once, as wide as the build allows (see collide.h). */
+void advanceProjectiles(float* x, float* y, float* vx, float* vy, int n, float dt, const FlightParams& params);
+
+/* Projectiles in structure of arrays layout, for advanceProjectiles() */
+struct ProjectileSet {
+	std::vector<float> x, y, vx, vy;
+	int count;
+
+	ProjectileSet(){
+		count = 0;
+	}
+	void reserve(int n);
+	void clear(){
+		count = 0;
+	}
+	int add(Vec2 position, Vec2 velocity);
+	void advance(float dt, const FlightParams& params){
+		if(count)
+			advanceProjectiles(&x[0], &y[0], &vx[0], &vy[0], count, dt, params);
+	}
+};
+
+#endif
@@ -0,0 +1,722 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include "render_vulkan.h"
+
+using namespace std;
+
+/* Vertices per memory chunk, meshes are packed in chunks to stay far below maxMemoryAllocationCount */
+#define CHUNK_VERTICES 65536
+
+static VkPrimitiveTopology topology(int primitive_mode)
+{
+	switch (primitive_mode) {
+		case VK_GL_LINES:        return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+		case VK_GL_LINE_STRIP:   return VK_PRIMITIVE_TOPOLOGY_LINE_STRIP;
+		case VK_GL_TRIANGLE_FAN: return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN;
+		default:                 return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	}
+}
+
+VulkanRenderer::VulkanRenderer()
+{
+	width = height = 0;
+	clearColor[0] = clearColor[1] = clearColor[2] = 0;
+	instance = VK_NULL_HANDLE;
+	physicalDevice = VK_NULL_HANDLE;
+	device = VK_NULL_HANDLE;
+	fillModeNonSolid = false;
+	colorImage = depthImage = VK_NULL_HANDLE;
+	colorMemory = depthMemory = VK_NULL_HANDLE;
+	colorView = depthView = VK_NULL_HANDLE;
+	renderPass = VK_NULL_HANDLE;
+	framebuffer = VK_NULL_HANDLE;
+	vertexShader = fragmentShader = VK_NULL_HANDLE;
+	pipelineLayout = VK_NULL_HANDLE;
+	for (int i=0; i<8; i++)
+		pipelines[i][0] = pipelines[i][1] = VK_NULL_HANDLE;
+	commandPool = VK_NULL_HANDLE;
+	primary = VK_NULL_HANDLE;
+	fence = VK_NULL_HANDLE;
+	readbackBuffer = VK_NULL_HANDLE;
+	readbackMemory = VK_NULL_HANDLE;
+	readbackPixels = NULL;
+	memset(&transient, 0, sizeof(transient));
+	for (int i=0; i<VK_STATIC_LAYERS; i++) {
+		layers[i].commands = VK_NULL_HANDLE;
+		layers[i].recorded = false;
+	}
+	dynamicUsed = 0;
+	recording = VK_NULL_HANDLE;
+	recordingLayer = -1;
+	boundPipeline = VK_NULL_HANDLE;
+	boundBuffer = VK_NULL_HANDLE;
+	draws = replayedLayers = 0;
+}
+
+VulkanRenderer::~VulkanRenderer()
+{
+	destroy();
+}
+
+int VulkanRenderer::findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties)
+{
+	for (uint32_t i=0; i<memoryProperties.memoryTypeCount; i++)
+		if ((typeBits & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+			return i;
+	return -1;
+}
+
+bool VulkanRenderer::createImage(VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect, VkImage* image, VkDeviceMemory* memory, VkImageView* view)
+{
+	VkImageCreateInfo imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = format;
+	imageInfo.extent.width = width;
+	imageInfo.extent.height = height;
+	imageInfo.extent.depth = 1;
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = usage;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	if (vkCreateImage(device, &imageInfo, NULL, image) != VK_SUCCESS)
+		return false;
+
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(device, *image, &requirements);
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = requirements.size;
+	int type = findMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	if (type < 0)
+		type = findMemoryType(requirements.memoryTypeBits, 0);
+	allocInfo.memoryTypeIndex = type;
+	if (type < 0 || vkAllocateMemory(device, &allocInfo, NULL, memory) != VK_SUCCESS)
+		return false;
+	vkBindImageMemory(device, *image, *memory, 0);
+
+	VkImageViewCreateInfo viewInfo = {};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = *image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = format;
+	viewInfo.subresourceRange.aspectMask = aspect;
+	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.layerCount = 1;
+	return vkCreateImageView(device, &viewInfo, NULL, view) == VK_SUCCESS;
+}
+
+bool VulkanRenderer::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer* buffer, VkDeviceMemory* memory, void** mapped)
+{
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	if (vkCreateBuffer(device, &bufferInfo, NULL, buffer) != VK_SUCCESS)
+		return false;
+
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(device, *buffer, &requirements);
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = requirements.size;
+	int type = findMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	allocInfo.memoryTypeIndex = type;
+	if (type < 0 || vkAllocateMemory(device, &allocInfo, NULL, memory) != VK_SUCCESS)
+		return false;
+	vkBindBufferMemory(device, *buffer, *memory, 0);
+	return vkMapMemory(device, *memory, 0, size, 0, mapped) == VK_SUCCESS;
+}
+
+bool VulkanRenderer::createChunk(int capacity, VulkanChunk* chunk)
+{
+	chunk->used = 0;
+	chunk->capacity = capacity;
+	return createBuffer(6*capacity*sizeof(float), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &chunk->buffer, &chunk->memory, (void**)&chunk->mapped);
+}
+
+VkShaderModule VulkanRenderer::loadShader(const char* path)
+{
+	ifstream file(path, ios::binary | ios::ate);
+	if (!file.is_open()) {
+		fprintf(stderr, "Error: cannot open %s\n", path);
+		return VK_NULL_HANDLE;
+	}
+	vector<uint32_t> code(((size_t)file.tellg() + 3)/4);
+	file.seekg(0);
+	file.read((char*)&code[0], code.size()*4);
+
+	VkShaderModuleCreateInfo moduleInfo = {};
+	moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	moduleInfo.codeSize = code.size()*4;
+	moduleInfo.pCode = &code[0];
+	VkShaderModule module = VK_NULL_HANDLE;
+	vkCreateShaderModule(device, &moduleInfo, NULL, &module);
+	return module;
+}
+
+bool VulkanRenderer::init(int w, int h, int streamVertices)
+{
+	width = w;
+	height = h;
+
+	VkApplicationInfo appInfo = {};
+	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	appInfo.pApplicationName = "Angry Birds";
+	appInfo.apiVersion = VK_API_VERSION_1_0;
+	VkInstanceCreateInfo instanceInfo = {};
+	instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	instanceInfo.pApplicationInfo = &appInfo;
+	if (vkCreateInstance(&instanceInfo, NULL, &instance) != VK_SUCCESS) {
+		fprintf(stderr, "Error: no Vulkan driver\n");
+		return false;
+	}
+
+	// First device with a graphics queue, VK_ICD_FILENAMES picks lavapipe if needed
+	uint32_t count = 0;
+	vkEnumeratePhysicalDevices(instance, &count, NULL);
+	vector<VkPhysicalDevice> devices(count);
+	if (count)
+		vkEnumeratePhysicalDevices(instance, &count, &devices[0]);
+	for (uint32_t i=0; i<count && physicalDevice == VK_NULL_HANDLE; i++) {
+		uint32_t families = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(devices[i], &families, NULL);
+		vector<VkQueueFamilyProperties> properties(families);
+		vkGetPhysicalDeviceQueueFamilyProperties(devices[i], &families, &properties[0]);
+		for (uint32_t j=0; j<families; j++) {
+			if (properties[j].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+				physicalDevice = devices[i];
+				queueFamily = j;
+				break;
+			}
+		}
+	}
+	if (physicalDevice == VK_NULL_HANDLE) {
+		fprintf(stderr, "Error: no Vulkan device with graphics support\n");
+		return false;
+	}
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+	fprintf(stderr, "Vulkan device: %s\n", deviceProperties.deviceName);
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	VkPhysicalDeviceFeatures supported, features = {};
+	vkGetPhysicalDeviceFeatures(physicalDevice, &supported);
+	fillModeNonSolid = supported.fillModeNonSolid == VK_TRUE;
+	features.fillModeNonSolid = supported.fillModeNonSolid;
+
+	float priority = 1.0f;
+	VkDeviceQueueCreateInfo queueInfo = {};
+	queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+	queueInfo.queueFamilyIndex = queueFamily;
+	queueInfo.queueCount = 1;
+	queueInfo.pQueuePriorities = &priority;
+	VkDeviceCreateInfo deviceInfo = {};
+	deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	deviceInfo.queueCreateInfoCount = 1;
+	deviceInfo.pQueueCreateInfos = &queueInfo;
+	deviceInfo.pEnabledFeatures = &features;
+	if (vkCreateDevice(physicalDevice, &deviceInfo, NULL, &device) != VK_SUCCESS)
+		return false;
+	vkGetDeviceQueue(device, queueFamily, 0, &queue);
+
+	// Render targets
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_D32_SFLOAT, &formatProperties);
+	depthFormat = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) ? VK_FORMAT_D32_SFLOAT : VK_FORMAT_D16_UNORM;
+	if (!createImage(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT, &colorImage, &colorMemory, &colorView))
+		return false;
+	if (!createImage(depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, &depthImage, &depthMemory, &depthView))
+		return false;
+
+	VkAttachmentDescription attachments[2] = {};
+	attachments[0].format = VK_FORMAT_R8G8B8A8_UNORM;
+	attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+	attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	attachments[0].finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	attachments[1].format = depthFormat;
+	attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+	attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+	VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &colorReference;
+	subpass.pDepthStencilAttachment = &depthReference;
+	// The previous frame's copy to the readback buffer must be done before the image is cleared
+	VkSubpassDependency dependencies[2] = {};
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	dependencies[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	VkRenderPassCreateInfo renderPassInfo = {};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = 2;
+	renderPassInfo.pAttachments = attachments;
+	renderPassInfo.subpassCount = 1;
+	renderPassInfo.pSubpasses = &subpass;
+	renderPassInfo.dependencyCount = 2;
+	renderPassInfo.pDependencies = dependencies;
+	if (vkCreateRenderPass(device, &renderPassInfo, NULL, &renderPass) != VK_SUCCESS)
+		return false;
+
+	VkImageView views[2] = { colorView, depthView };
+	VkFramebufferCreateInfo framebufferInfo = {};
+	framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferInfo.renderPass = renderPass;
+	framebufferInfo.attachmentCount = 2;
+	framebufferInfo.pAttachments = views;
+	framebufferInfo.width = width;
+	framebufferInfo.height = height;
+	framebufferInfo.layers = 1;
+	if (vkCreateFramebuffer(device, &framebufferInfo, NULL, &framebuffer) != VK_SUCCESS)
+		return false;
+
+	// Shaders, compiled from Sample_VK.vert / Sample_VK.frag by the Makefile
+	vertexShader = loadShader("Sample_VK.vert.spv");
+	fragmentShader = loadShader("Sample_VK.frag.spv");
+	if (vertexShader == VK_NULL_HANDLE || fragmentShader == VK_NULL_HANDLE)
+		return false;
+
+	// The MVP matrix is the only per draw state: 64 bytes of push constants
+	VkPushConstantRange pushRange = { VK_SHADER_STAGE_VERTEX_BIT, 0, 16*sizeof(float) };
+	VkPipelineLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushRange;
+	if (vkCreatePipelineLayout(device, &layoutInfo, NULL, &pipelineLayout) != VK_SUCCESS)
+		return false;
+
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.queueFamilyIndex = queueFamily;
+	if (vkCreateCommandPool(device, &poolInfo, NULL, &commandPool) != VK_SUCCESS)
+		return false;
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = commandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+	if (vkAllocateCommandBuffers(device, &allocInfo, &primary) != VK_SUCCESS)
+		return false;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+	for (int i=0; i<VK_STATIC_LAYERS; i++)
+		if (vkAllocateCommandBuffers(device, &allocInfo, &layers[i].commands) != VK_SUCCESS)
+			return false;
+
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	if (vkCreateFence(device, &fenceInfo, NULL, &fence) != VK_SUCCESS)
+		return false;
+
+	if (!createBuffer(width*height*4, VK_BUFFER_USAGE_TRANSFER_DST_BIT, &readbackBuffer, &readbackMemory, (void**)&readbackPixels))
+		return false;
+	if (!createChunk(streamVertices, &transient))
+		return false;
+	return true;
+}
+
+void VulkanRenderer::destroy()
+{
+	if (device == VK_NULL_HANDLE) {
+		if (instance != VK_NULL_HANDLE)
+			vkDestroyInstance(instance, NULL);
+		instance = VK_NULL_HANDLE;
+		return;
+	}
+	vkDeviceWaitIdle(device);
+
+	chunks.push_back(transient);
+	for (size_t i=0; i<chunks.size(); i++) {
+		if (chunks[i].buffer == VK_NULL_HANDLE)
+			continue;
+		vkDestroyBuffer(device, chunks[i].buffer, NULL);
+		vkFreeMemory(device, chunks[i].memory, NULL);
+	}
+	chunks.clear();
+	meshes.clear();
+	if (readbackBuffer != VK_NULL_HANDLE) {
+		vkDestroyBuffer(device, readbackBuffer, NULL);
+		vkFreeMemory(device, readbackMemory, NULL);
+	}
+	if (fence != VK_NULL_HANDLE)
+		vkDestroyFence(device, fence, NULL);
+	if (commandPool != VK_NULL_HANDLE)
+		vkDestroyCommandPool(device, commandPool, NULL);
+	for (int i=0; i<8; i++)
+		for (int j=0; j<2; j++)
+			if (pipelines[i][j] != VK_NULL_HANDLE)
+				vkDestroyPipeline(device, pipelines[i][j], NULL);
+	if (pipelineLayout != VK_NULL_HANDLE)
+		vkDestroyPipelineLayout(device, pipelineLayout, NULL);
+	if (vertexShader != VK_NULL_HANDLE)
+		vkDestroyShaderModule(device, vertexShader, NULL);
+	if (fragmentShader != VK_NULL_HANDLE)
+		vkDestroyShaderModule(device, fragmentShader, NULL);
+	if (framebuffer != VK_NULL_HANDLE)
+		vkDestroyFramebuffer(device, framebuffer, NULL);
+	if (renderPass != VK_NULL_HANDLE)
+		vkDestroyRenderPass(device, renderPass, NULL);
+	VkImageView views[2] = { colorView, depthView };
+	VkImage images[2] = { colorImage, depthImage };
+	VkDeviceMemory memories[2] = { colorMemory, depthMemory };
+	for (int i=0; i<2; i++) {
+		if (views[i] != VK_NULL_HANDLE)
+			vkDestroyImageView(device, views[i], NULL);
+		if (images[i] != VK_NULL_HANDLE)
+			vkDestroyImage(device, images[i], NULL);
+		if (memories[i] != VK_NULL_HANDLE)
+			vkFreeMemory(device, memories[i], NULL);
+	}
+	vkDestroyDevice(device, NULL);
+	vkDestroyInstance(instance, NULL);
+	device = VK_NULL_HANDLE;
+	instance = VK_NULL_HANDLE;
+}
+
+VkPipeline VulkanRenderer::getPipeline(int primitive_mode, int fill_mode)
+{
+	// Fill mode only changes triangles, and needs fillModeNonSolid
+	int fill = (fill_mode == VK_GL_LINE && fillModeNonSolid && primitive_mode >= VK_GL_TRIANGLES) ? 0 : 1;
+	VkPipeline &pipeline = pipelines[primitive_mode & 7][fill];
+	if (pipeline != VK_NULL_HANDLE)
+		return pipeline;
+
+	VkPipelineShaderStageCreateInfo stages[2] = {};
+	stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	stages[0].module = vertexShader;
+	stages[0].pName = "main";
+	stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	stages[1].module = fragmentShader;
+	stages[1].pName = "main";
+
+	VkVertexInputBindingDescription binding = { 0, 6*sizeof(float), VK_VERTEX_INPUT_RATE_VERTEX };
+	VkVertexInputAttributeDescription attributes[2] = {
+		{ 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 },                 // x,y,z
+		{ 1, 0, VK_FORMAT_R32G32B32_SFLOAT, 3*sizeof(float) },   // r,g,b
+	};
+	VkPipelineVertexInputStateCreateInfo vertexInput = {};
+	vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInput.vertexBindingDescriptionCount = 1;
+	vertexInput.pVertexBindingDescriptions = &binding;
+	vertexInput.vertexAttributeDescriptionCount = 2;
+	vertexInput.pVertexAttributeDescriptions = attributes;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = topology(primitive_mode);
+
+	VkViewport viewport = { 0, 0, (float)width, (float)height, 0, 1 };
+	VkRect2D scissor = {};
+	scissor.extent.width = width;
+	scissor.extent.height = height;
+	VkPipelineViewportStateCreateInfo viewportState = {};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.pViewports = &viewport;
+	viewportState.scissorCount = 1;
+	viewportState.pScissors = &scissor;
+
+	VkPipelineRasterizationStateCreateInfo rasterization = {};
+	rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterization.polygonMode = fill ? VK_POLYGON_MODE_FILL : VK_POLYGON_MODE_LINE;
+	rasterization.cullMode = VK_CULL_MODE_NONE;
+	rasterization.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterization.lineWidth = 1.0f;
+
+	VkPipelineMultisampleStateCreateInfo multisample = {};
+	multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	// Same as glDepthFunc (GL_LEQUAL): layers drawn later in the same plane win
+	VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable = VK_TRUE;
+	depthStencil.depthWriteEnable = VK_TRUE;
+	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+	VkPipelineColorBlendAttachmentState blendAttachment = {};
+	blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	VkPipelineColorBlendStateCreateInfo colorBlend = {};
+	colorBlend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlend.attachmentCount = 1;
+	colorBlend.pAttachments = &blendAttachment;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = 2;
+	pipelineInfo.pStages = stages;
+	pipelineInfo.pVertexInputState = &vertexInput;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterization;
+	pipelineInfo.pMultisampleState = &multisample;
+	pipelineInfo.pDepthStencilState = &depthStencil;
+	pipelineInfo.pColorBlendState = &colorBlend;
+	pipelineInfo.layout = pipelineLayout;
+	pipelineInfo.renderPass = renderPass;
+	pipelineInfo.subpass = 0;
+	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &pipeline) != VK_SUCCESS) {
+		fprintf(stderr, "Error: cannot create the pipeline for primitive mode %d\n", primitive_mode);
+		pipeline = VK_NULL_HANDLE;
+	}
+	return pipeline;
+}
+
+int VulkanRenderer::createMesh(int primitive_mode, int fill_mode, int numVertices, const float* vertices, const float* colors)
+{
+	if (chunks.empty() || chunks.back().used + numVertices > chunks.back().capacity) {
+		VulkanChunk chunk;
+		if (!createChunk(max(numVertices, CHUNK_VERTICES), &chunk)) {
+			fprintf(stderr, "Error: out of vertex memory\n");
+			return -1;
+		}
+		chunks.push_back(chunk);
+	}
+	VulkanChunk &chunk = chunks.back();
+	VulkanMesh mesh;
+	mesh.chunk = chunks.size() - 1;
+	mesh.first = chunk.used;
+	mesh.count = numVertices;
+	mesh.pipeline = getPipeline(primitive_mode, fill_mode);
+
+	float* out = chunk.mapped + 6*chunk.used;
+	for (int i=0; i<numVertices; i++) {
+		memcpy(out + 6*i, vertices + 3*i, 3*sizeof(float));
+		memcpy(out + 6*i + 3, colors + 3*i, 3*sizeof(float));
+	}
+	chunk.used += numVertices;
+	meshes.push_back(mesh);
+	return meshes.size() - 1;
+}
+
+void VulkanRenderer::setClearColor(float r, float g, float b)
+{
+	clearColor[0] = r;
+	clearColor[1] = g;
+	clearColor[2] = b;
+}
+
+VkCommandBuffer VulkanRenderer::beginSecondary()
+{
+	VkCommandBufferInheritanceInfo inheritance = {};
+	inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritance.renderPass = renderPass;
+	inheritance.subpass = 0;
+	inheritance.framebuffer = framebuffer;
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = &inheritance;
+
+	VkCommandBuffer commands;
+	if (recordingLayer >= 0) {
+		commands = layers[recordingLayer].commands;
+	}
+	else {
+		if (dynamicUsed == (int)dynamicPool.size()) {
+			VkCommandBufferAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = commandPool;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandBufferCount = 1;
+			vkAllocateCommandBuffers(device, &allocInfo, &commands);
+			dynamicPool.push_back(commands);
+		}
+		commands = dynamicPool[dynamicUsed++];
+	}
+	vkBeginCommandBuffer(commands, &beginInfo);
+	boundPipeline = VK_NULL_HANDLE;
+	boundBuffer = VK_NULL_HANDLE;
+	return commands;
+}
+
+/* End the secondary being recorded and queue it for this frame */
+void VulkanRenderer::closeSegment()
+{
+	if (recording == VK_NULL_HANDLE)
+		return;
+	vkEndCommandBuffer(recording);
+	frameCommands.push_back(recording);
+	recording = VK_NULL_HANDLE;
+}
+
+void VulkanRenderer::beginFrame()
+{
+	frameCommands.clear();
+	dynamicUsed = 0;
+	transient.used = 0;
+	recording = VK_NULL_HANDLE;
+	recordingLayer = -1;
+}
+
+void VulkanRenderer::record(VkPipeline pipeline, VkBuffer buffer, int first, int count, const float mvp[16])
+{
+	if (pipeline == VK_NULL_HANDLE)
+		return;
+	if (recording == VK_NULL_HANDLE)
+		recording = beginSecondary();
+	if (pipeline != boundPipeline) {
+		vkCmdBindPipeline(recording, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		boundPipeline = pipeline;
+	}
+	if (buffer != boundBuffer) {
+		VkDeviceSize offset = 0;
+		vkCmdBindVertexBuffers(recording, 0, 1, &buffer, &offset);
+		boundBuffer = buffer;
+	}
+	vkCmdPushConstants(recording, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, 16*sizeof(float), mvp);
+	vkCmdDraw(recording, count, 1, first, 0);
+	draws++;
+}
+
+void VulkanRenderer::draw(int mesh, const float mvp[16])
+{
+	if (mesh < 0)
+		return;
+	VulkanMesh &m = meshes[mesh];
+	record(m.pipeline, chunks[m.chunk].buffer, m.first, m.count, mvp);
+}
+
+void VulkanRenderer::drawTransient(int primitive_mode, int fill_mode, int numVertices, const float* interleaved, const float mvp[16])
+{
+	if (transient.used + numVertices > transient.capacity) {
+		fprintf(stderr, "Transient vertex buffer overflow: %d vertices requested\n", numVertices);
+		return;
+	}
+	memcpy(transient.mapped + 6*transient.used, interleaved, 6*numVertices*sizeof(float));
+	record(getPipeline(primitive_mode, fill_mode), transient.buffer, transient.used, numVertices, mvp);
+	transient.used += numVertices;
+}
+
+bool VulkanRenderer::beginStaticLayer(int layer, const float key[16])
+{
+	closeSegment();
+	VulkanLayer &l = layers[layer];
+	if (l.recorded && !memcmp(l.key, key, sizeof(l.key))) {
+		frameCommands.push_back(l.commands);
+		replayedLayers++;
+		return false;
+	}
+	memcpy(l.key, key, sizeof(l.key));
+	recordingLayer = layer;
+	recording = beginSecondary();
+	return true;
+}
+
+void VulkanRenderer::endStaticLayer()
+{
+	if (recordingLayer < 0)
+		return;
+	layers[recordingLayer].recorded = true;
+	recordingLayer = -1;
+	closeSegment();
+}
+
+/* The meshes a layer refers to were replaced */
+void VulkanRenderer::invalidateStaticLayers()
+{
+	for (int i=0; i<VK_STATIC_LAYERS; i++)
+		layers[i].recorded = false;
+}
+
+void VulkanRenderer::endFrame(bool readback)
+{
+	closeSegment();
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(primary, &beginInfo);
+
+	VkClearValue clearValues[2];
+	clearValues[0].color.float32[0] = clearColor[0];
+	clearValues[0].color.float32[1] = clearColor[1];
+	clearValues[0].color.float32[2] = clearColor[2];
+	clearValues[0].color.float32[3] = 1.0f;
+	clearValues[1].depthStencil.depth = 1.0f;
+	clearValues[1].depthStencil.stencil = 0;
+	VkRenderPassBeginInfo renderPassBegin = {};
+	renderPassBegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassBegin.renderPass = renderPass;
+	renderPassBegin.framebuffer = framebuffer;
+	renderPassBegin.renderArea.extent.width = width;
+	renderPassBegin.renderArea.extent.height = height;
+	renderPassBegin.clearValueCount = 2;
+	renderPassBegin.pClearValues = clearValues;
+	// All the draws live in secondary command buffers, the primary only stitches them together
+	vkCmdBeginRenderPass(primary, &renderPassBegin, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+	if (!frameCommands.empty())
+		vkCmdExecuteCommands(primary, frameCommands.size(), &frameCommands[0]);
+	vkCmdEndRenderPass(primary);
+
+	if (readback) {
+		VkBufferImageCopy region = {};
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent.width = width;
+		region.imageExtent.height = height;
+		region.imageExtent.depth = 1;
+		vkCmdCopyImageToBuffer(primary, colorImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer, 1, &region);
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(primary, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, NULL, 0, NULL);
+	}
+	vkEndCommandBuffer(primary);
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &primary;
+	vkQueueSubmit(queue, 1, &submitInfo, fence);
+	// One frame in flight: the secondaries and the transient vertices are reused next frame
+	vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+	vkResetFences(device, 1, &fence);
+}
+
+bool VulkanRenderer::writePPM(const char* path)
+{
+	FILE* fp = fopen(path, "wb");
+	if (fp == NULL) {
+		fprintf(stderr, "Error: cannot write %s\n", path);
+		return false;
+	}
+	// Vulkan's first row is the top of the image, like the PPM's
+	fprintf(fp, "P6\n%d %d\n255\n", width, height);
+	for (int i=0; i<width*height; i++) {
+		unsigned int c = readbackPixels[i];
+		unsigned char rgb[3] = { (unsigned char)(c & 0xff), (unsigned char)((c >> 8) & 0xff), (unsigned char)((c >> 16) & 0xff) };
+		fwrite(rgb, 1, 3, fp);
+	}
+	fclose(fp);
+	return true;
+}
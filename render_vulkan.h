@@ -0,0 +1,142 @@
+#ifndef RENDER_VULKAN_H
+#define RENDER_VULKAN_H
+
+#include <vector>
+#include <vulkan/vulkan.h>
+
+/* Primitive and fill modes, same values as the GL enums so they can be passed straight through */
+#define VK_GL_LINES          0x0001
+#define VK_GL_LINE_STRIP     0x0003
+#define VK_GL_TRIANGLES      0x0004
+#define VK_GL_TRIANGLE_FAN   0x0006
+#define VK_GL_LINE           0x1B01
+#define VK_GL_FILL           0x1B02
+
+#define VK_STATIC_LAYERS 4
+
+/* Block of host visible memory holding the vertices of many meshes, x,y,z,r,g,b interleaved */
+struct VulkanChunk {
+	VkBuffer buffer;
+	VkDeviceMemory memory;
+	float* mapped;
+	int used;
+	int capacity;
+};
+
+struct VulkanMesh {
+	int chunk;
+	int first;
+	int count;
+	VkPipeline pipeline;
+};
+
+/* Layer whose draws are recorded once into a secondary command buffer and replayed
+   every frame until its key (the view-projection matrix) changes */
+struct VulkanLayer {
+	VkCommandBuffer commands;
+	bool recorded;
+	float key[16];
+};
+
+/* Vulkan renderer drawing into an offscreen image (no swapchain, so it runs headless,
+   e.g. on lavapipe). The transform is passed as a push constant, pipelines are created
+   on demand for each primitive/fill mode pair. Draws are recorded into secondary command
+   buffers: dynamic ones every frame, static layers only when they change. */
+class VulkanRenderer{
+	int width;
+	int height;
+	float clearColor[3];
+
+	VkInstance instance;
+	VkPhysicalDevice physicalDevice;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	bool fillModeNonSolid;
+	VkDevice device;
+	uint32_t queueFamily;
+	VkQueue queue;
+
+	VkImage colorImage;
+	VkDeviceMemory colorMemory;
+	VkImageView colorView;
+	VkFormat depthFormat;
+	VkImage depthImage;
+	VkDeviceMemory depthMemory;
+	VkImageView depthView;
+	VkRenderPass renderPass;
+	VkFramebuffer framebuffer;
+
+	VkShaderModule vertexShader;
+	VkShaderModule fragmentShader;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipelines[8][2];   // [primitive mode][line, fill]
+
+	VkCommandPool commandPool;
+	VkCommandBuffer primary;
+	VkFence fence;
+	VkBuffer readbackBuffer;
+	VkDeviceMemory readbackMemory;
+	unsigned int* readbackPixels;
+
+	std::vector<VulkanChunk> chunks;
+	std::vector<VulkanMesh> meshes;
+	VulkanChunk transient;        // vertices streamed this frame
+	VulkanLayer layers[VK_STATIC_LAYERS];
+
+	std::vector<VkCommandBuffer> dynamicPool;
+	int dynamicUsed;
+	std::vector<VkCommandBuffer> frameCommands;  // secondaries to execute this frame, in order
+	VkCommandBuffer recording;                   // secondary currently being recorded, or null
+	int recordingLayer;
+	VkPipeline boundPipeline;
+	VkBuffer boundBuffer;
+
+	public:
+	long draws;
+	long replayedLayers;  // static layers executed from their recorded commands
+
+	private:
+	int findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties);
+	bool createImage(VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect, VkImage* image, VkDeviceMemory* memory, VkImageView* view);
+	bool createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer* buffer, VkDeviceMemory* memory, void** mapped);
+	bool createChunk(int capacity, VulkanChunk* chunk);
+	VkShaderModule loadShader(const char* path);
+	VkPipeline getPipeline(int primitive_mode, int fill_mode);
+	VkCommandBuffer beginSecondary();
+	void closeSegment();
+	void record(VkPipeline pipeline, VkBuffer buffer, int first, int count, const float mvp[16]);
+
+	public:
+	VulkanRenderer();
+	~VulkanRenderer();
+
+	int getWidth(){
+		return width;
+	}
+	int getHeight(){
+		return height;
+	}
+
+	/* streamVertices: the most vertices drawTransient() is given in one frame */
+	bool init(int w, int h, int streamVertices);
+	void destroy();
+
+	/* Upload a mesh once and return its handle. vertices and colors are xyz / rgb triplets */
+	int createMesh(int primitive_mode, int fill_mode, int numVertices, const float* vertices, const float* colors);
+	void setClearColor(float r, float g, float b);
+	void beginFrame();
+	void draw(int mesh, const float mvp[16]);
+	/* Draw vertices that live only for this frame, 6 floats each */
+	void drawTransient(int primitive_mode, int fill_mode, int numVertices, const float* interleaved, const float mvp[16]);
+
+	/* Returns true when the layer has to be drawn again, the draws up to endStaticLayer
+	   are then recorded. Returns false when the recorded commands were reused. */
+	bool beginStaticLayer(int layer, const float key[16]);
+	void endStaticLayer();
+	void invalidateStaticLayers();
+
+	/* Submit the frame and wait for it, reading the image back if asked */
+	void endFrame(bool readback);
+	bool writePPM(const char* path);
+};
+
+#endif
@@ -0,0 +1,728 @@
+#include <cmath>
+#include <algorithm>
+#include "rigid.h"
+#include "integrate.h"
+
+using namespace std;
+
+RigidWorld::RigidWorld()
+{
+	widest = 0;
+	dt = 0;
+	gravity = 0.6;
+	iterations = RIGID_ITERATIONS;
+	islands = islandsAwake = 0;
+}
+
+void RigidWorld::reserve(int n)
+{
+	bodies.reserve(n);
+	order.reserve(n);
+	pairs.reserve(4*n);
+	manifolds.reserve(4*n);
+	oldManifolds.reserve(4*n);
+	previous.reserve(4*n);
+	parent.reserve(n);
+	bodyIsland.reserve(n);
+	islandStart.reserve(n + 1);
+	islandBodies.reserve(n);
+	islandPairStart.reserve(n + 1);
+	islandPairs.reserve(4*n);
+	awakeIslands.reserve(n);
+}
+
+void RigidWorld::clear()
+{
+	bodies.clear();
+	order.clear();
+	statics.clear();
+	pairs.clear();
+	manifolds.clear();
+	islands = islandsAwake = 0;
+}
+
+static void updateBounds(RigidBody& b)
+{
+	float ex = fabs(b.c)*b.hx + fabs(b.s)*b.hy + RIGID_MARGIN;
+	float ey = fabs(b.s)*b.hx + fabs(b.c)*b.hy + RIGID_MARGIN;
+	b.x0 = b.x - ex;
+	b.y0 = b.y - ey;
+	b.x1 = b.x + ex;
+	b.y1 = b.y + ey;
+}
+
+int RigidWorld::addBox(float x, float y, float hx, float hy, float angle, float density, float friction)
+{
+	RigidBody b;
+	float mass = density*4*hx*hy;
+	b.x = b.prevx = x;
+	b.y = b.prevy = y;
+	b.angle = b.prevAngle = angle;
+	b.c = cos(angle);
+	b.s = sin(angle);
+	b.vx = b.vy = b.w = 0;
+	b.hx = hx;
+	b.hy = hy;
+	b.invMass = mass > 0 ? 1/mass : 0;
+	b.invInertia = mass > 0 ? 3/(mass*(hx*hx + hy*hy)) : 0;
+	b.friction = friction;
+	b.rest = 0;
+	b.awake = mass > 0;
+	updateBounds(b);
+	bodies.push_back(b);
+	if(mass > 0)
+		order.push_back(bodies.size() - 1);
+	else
+		statics.push_back(bodies.size() - 1);
+	return bodies.size() - 1;
+}
+
+void RigidWorld::savePrevious()
+{
+	int i;
+	for(i=0;i<(int)bodies.size();i++){
+		RigidBody& b = bodies[i];
+		b.prevx = b.x;
+		b.prevy = b.y;
+		b.prevAngle = b.angle;
+	}
+}
+
+/* Insertion sort: from one step to the next the order hardly changes, so this is close
+   to linear. Ties go by index, the order is the same however the bodies got there. */
+void RigidWorld::sortBodies()
+{
+	int i, j;
+	widest = 0;
+	for(i=1;i<(int)order.size();i++){
+		int k = order[i];
+		float x0 = bodies[k].x0;
+		for(j=i;j>0;j--){
+			const RigidBody& b = bodies[order[j-1]];
+			if(b.x0 < x0 || (b.x0 == x0 && order[j-1] < k))
+				break;
+			order[j] = order[j-1];
+		}
+		order[j] = k;
+	}
+	for(i=0;i<(int)order.size();i++)
+		widest = max(widest, bodies[order[i]].x1 - bodies[order[i]].x0);
+}
+
+static bool overlaps(const RigidBody& a, const RigidBody& b)
+{
+	return a.x0 <= b.x1 && b.x0 <= a.x1 && a.y0 <= b.y1 && b.y0 <= a.y1;
+}
+
+static bool pairLess(const BodyPair& p, const BodyPair& q)
+{
+	return p.a < q.a || (p.a == q.a && p.b < q.b);
+}
+
+/* Sweep and prune along x for the moving bodies, the few static ones against all of them */
+void RigidWorld::findPairs()
+{
+	int i, j, k;
+	pairs.clear();
+	for(i=0;i<(int)order.size();i++){
+		const RigidBody& a = bodies[order[i]];
+		for(j=i+1;j<(int)order.size() && bodies[order[j]].x0 <= a.x1;j++){
+			if(!overlaps(a, bodies[order[j]]))
+				continue;
+			BodyPair p = { min(order[i], order[j]), max(order[i], order[j]) };
+			pairs.push_back(p);
+		}
+	}
+	for(k=0;k<(int)statics.size();k++){
+		for(i=0;i<(int)order.size();i++){
+			if(!overlaps(bodies[statics[k]], bodies[order[i]]))
+				continue;
+			BodyPair p = { min(statics[k], order[i]), max(statics[k], order[i]) };
+			pairs.push_back(p);
+		}
+	}
+	sort(pairs.begin(), pairs.end(), pairLess);
+}
+
+/* The contacts of the step before are sorted by pair too, one pass finds them */
+void RigidWorld::matchManifolds()
+{
+	int i, j = 0;
+	manifolds.swap(oldManifolds);
+	manifolds.resize(pairs.size());
+	previous.resize(pairs.size());
+	for(i=0;i<(int)pairs.size();i++){
+		BodyPair old;
+		previous[i] = -1;
+		for(;j<(int)oldManifolds.size();j++){
+			old.a = oldManifolds[j].a;
+			old.b = oldManifolds[j].b;
+			if(!pairLess(old, pairs[i]))
+				break;
+		}
+		if(j < (int)oldManifolds.size() && oldManifolds[j].a == pairs[i].a && oldManifolds[j].b == pairs[i].b)
+			previous[i] = j;
+	}
+}
+
+int RigidWorld::root(int i)
+{
+	while(parent[i] != i){
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+/* Islands are numbered by their lowest body and list their bodies and pairs in order.
+   An island with anything awake in it is woken as a whole. */
+void RigidWorld::buildIslands()
+{
+	int i, k, n = bodies.size();
+	parent.resize(n);
+	bodyIsland.assign(n, -1);
+	for(i=0;i<n;i++)
+		parent[i] = i;
+	for(i=0;i<(int)pairs.size();i++){
+		int a = pairs[i].a, b = pairs[i].b;
+		if(bodies[a].invMass == 0 || bodies[b].invMass == 0)
+			continue;
+		a = root(a);
+		b = root(b);
+		if(a != b)
+			parent[max(a, b)] = min(a, b);
+	}
+
+	islands = 0;
+	for(i=0;i<n;i++){
+		if(bodies[i].invMass == 0)
+			continue;
+		int r = root(i);
+		if(r == i)
+			bodyIsland[i] = islands++;
+		else
+			bodyIsland[i] = bodyIsland[r];
+	}
+
+	// Counting sorts, the starts double as cursors and are shifted back after
+	islandStart.assign(islands + 1, 0);
+	islandPairStart.assign(islands + 1, 0);
+	islandBodies.resize(n);
+	islandPairs.resize(pairs.size());
+	for(i=0;i<n;i++)
+		if(bodyIsland[i] >= 0)
+			islandStart[bodyIsland[i] + 1]++;
+	for(i=0;i<(int)pairs.size();i++){
+		int a = pairs[i].a;
+		if(bodies[a].invMass == 0)
+			a = pairs[i].b;
+		islandPairStart[bodyIsland[a] + 1]++;
+	}
+	for(k=0;k<islands;k++){
+		islandStart[k+1] += islandStart[k];
+		islandPairStart[k+1] += islandPairStart[k];
+	}
+	for(i=0;i<n;i++)
+		if(bodyIsland[i] >= 0)
+			islandBodies[islandStart[bodyIsland[i]]++] = i;
+	for(i=0;i<(int)pairs.size();i++){
+		int a = pairs[i].a;
+		if(bodies[a].invMass == 0)
+			a = pairs[i].b;
+		islandPairs[islandPairStart[bodyIsland[a]]++] = i;
+	}
+	for(k=islands;k>0;k--){
+		islandStart[k] = islandStart[k-1];
+		islandPairStart[k] = islandPairStart[k-1];
+	}
+	islandStart[0] = islandPairStart[0] = 0;
+
+	awakeIslands.clear();
+	for(k=0;k<islands;k++){
+		bool awake = false;
+		for(i=islandStart[k];i<islandStart[k+1] && !awake;i++)
+			awake = bodies[islandBodies[i]].awake;
+		if(!awake)
+			continue;
+		for(i=islandStart[k];i<islandStart[k+1];i++){
+			RigidBody& b = bodies[islandBodies[i]];
+			if(!b.awake){
+				b.awake = true;
+				b.rest = 0;
+			}
+		}
+		awakeIslands.push_back(k);
+	}
+	islandsAwake = awakeIslands.size();
+}
+
+/* Box against box, after Box2D Lite: the axis of least overlap gives the reference face,
+   the edge of the other box most against it is clipped to the sides of that face */
+enum { EDGE_NONE, EDGE1, EDGE2, EDGE3, EDGE4 };
+enum { FACE_A_X, FACE_A_Y, FACE_B_X, FACE_B_Y };
+
+struct ClipVertex {
+	Vec2 v;
+	unsigned char in1, out1, in2, out2;
+};
+
+static inline Vec2 rotate(const RigidBody& b, Vec2 v){
+	return vec2(b.c*v.x - b.s*v.y, b.s*v.x + b.c*v.y);
+}
+static inline Vec2 unrotate(const RigidBody& b, Vec2 v){
+	return vec2(b.c*v.x + b.s*v.y, -b.s*v.x + b.c*v.y);
+}
+static inline float cross(Vec2 a, Vec2 b){
+	return a.x*b.y - a.y*b.x;
+}
+
+static void setClipVertex(ClipVertex& c, float x, float y, unsigned char in2, unsigned char out2)
+{
+	c.v = vec2(x, y);
+	c.in1 = c.out1 = EDGE_NONE;
+	c.in2 = in2;
+	c.out2 = out2;
+}
+
+/* The edge of box b whose normal is most against normal, in world space */
+static void incidentEdge(ClipVertex c[2], const RigidBody& b, Vec2 normal)
+{
+	Vec2 n = unrotate(b, normal);
+	float hx = b.hx, hy = b.hy;
+	n = vec2(-n.x, -n.y);
+	if(fabs(n.x) > fabs(n.y)){
+		if(n.x >= 0){
+			setClipVertex(c[0], hx, -hy, EDGE3, EDGE4);
+			setClipVertex(c[1], hx, hy, EDGE4, EDGE1);
+		}
+		else{
+			setClipVertex(c[0], -hx, hy, EDGE1, EDGE2);
+			setClipVertex(c[1], -hx, -hy, EDGE2, EDGE3);
+		}
+	}
+	else{
+		if(n.y >= 0){
+			setClipVertex(c[0], hx, hy, EDGE4, EDGE1);
+			setClipVertex(c[1], -hx, hy, EDGE1, EDGE2);
+		}
+		else{
+			setClipVertex(c[0], -hx, -hy, EDGE2, EDGE3);
+			setClipVertex(c[1], hx, -hy, EDGE3, EDGE4);
+		}
+	}
+	c[0].v = vec2(b.x, b.y) + rotate(b, c[0].v);
+	c[1].v = vec2(b.x, b.y) + rotate(b, c[1].v);
+}
+
+/* Keeps what is behind the line dot(normal, v) = offset, new points are made by edge */
+static int clipSegment(ClipVertex out[2], const ClipVertex in[2], Vec2 normal, float offset, unsigned char edge)
+{
+	int n = 0;
+	float d0 = dot(normal, in[0].v) - offset, d1 = dot(normal, in[1].v) - offset;
+	if(d0 <= 0)
+		out[n++] = in[0];
+	if(d1 <= 0)
+		out[n++] = in[1];
+	if(d0*d1 < 0){
+		Vec2 v = in[0].v + (d0/(d0 - d1))*(in[1].v - in[0].v);
+		if(d0 > 0){
+			out[n] = in[0];
+			out[n].in1 = edge;
+			out[n].in2 = EDGE_NONE;
+		}
+		else{
+			out[n] = in[1];
+			out[n].out1 = edge;
+			out[n].out2 = EDGE_NONE;
+		}
+		out[n].v = v;
+		n++;
+	}
+	return n;
+}
+
+/* New contact points for the pair, each one starting from the impulses of the point
+   with the same edges in the step before */
+void RigidWorld::collide(int pair)
+{
+	int i, j;
+	Manifold& m = manifolds[pair];
+	const RigidBody& A = bodies[pairs[pair].a];
+	const RigidBody& B = bodies[pairs[pair].b];
+	m.a = pairs[pair].a;
+	m.b = pairs[pair].b;
+	m.count = 0;
+	m.friction = sqrt(A.friction*B.friction);
+
+	Vec2 dp = vec2(B.x - A.x, B.y - A.y);
+	Vec2 dA = unrotate(A, dp), dB = unrotate(B, dp);
+	// Rotation from B to A, only its absolute values are needed
+	float rc = fabs(A.c*B.c + A.s*B.s), rs = fabs(A.c*B.s - A.s*B.c);
+	float faceAx = fabs(dA.x) - A.hx - (rc*B.hx + rs*B.hy);
+	float faceAy = fabs(dA.y) - A.hy - (rs*B.hx + rc*B.hy);
+	float faceBx = fabs(dB.x) - (rc*A.hx + rs*A.hy) - B.hx;
+	float faceBy = fabs(dB.y) - (rs*A.hx + rc*A.hy) - B.hy;
+	if(faceAx > 0 || faceAy > 0 || faceBx > 0 || faceBy > 0)
+		return;
+
+	// Faces of A are preferred, so that the reference face does not flip between steps
+	int axis = FACE_A_X;
+	float separation = faceAx;
+	Vec2 normal = dA.x > 0 ? vec2(A.c, A.s) : vec2(-A.c, -A.s);
+	if(faceAy > 0.95f*separation + 0.01f*A.hy){
+		axis = FACE_A_Y;
+		separation = faceAy;
+		normal = dA.y > 0 ? vec2(-A.s, A.c) : vec2(A.s, -A.c);
+	}
+	if(faceBx > 0.95f*separation + 0.01f*B.hx){
+		axis = FACE_B_X;
+		separation = faceBx;
+		normal = dB.x > 0 ? vec2(B.c, B.s) : vec2(-B.c, -B.s);
+	}
+	if(faceBy > 0.95f*separation + 0.01f*B.hy){
+		axis = FACE_B_Y;
+		separation = faceBy;
+		normal = dB.y > 0 ? vec2(-B.s, B.c) : vec2(B.s, -B.c);
+	}
+
+	Vec2 front, side;
+	float frontOffset, negSide, posSide;
+	unsigned char negEdge, posEdge;
+	ClipVertex incident[2];
+	switch (axis) {
+		case FACE_A_X:
+			front = normal;
+			frontOffset = dot(vec2(A.x, A.y), front) + A.hx;
+			side = vec2(-A.s, A.c);
+			negSide = -dot(vec2(A.x, A.y), side) + A.hy;
+			posSide = dot(vec2(A.x, A.y), side) + A.hy;
+			negEdge = EDGE3;
+			posEdge = EDGE1;
+			incidentEdge(incident, B, front);
+			break;
+		case FACE_A_Y:
+			front = normal;
+			frontOffset = dot(vec2(A.x, A.y), front) + A.hy;
+			side = vec2(A.c, A.s);
+			negSide = -dot(vec2(A.x, A.y), side) + A.hx;
+			posSide = dot(vec2(A.x, A.y), side) + A.hx;
+			negEdge = EDGE2;
+			posEdge = EDGE4;
+			incidentEdge(incident, B, front);
+			break;
+		case FACE_B_X:
+			front = vec2(-normal.x, -normal.y);
+			frontOffset = dot(vec2(B.x, B.y), front) + B.hx;
+			side = vec2(-B.s, B.c);
+			negSide = -dot(vec2(B.x, B.y), side) + B.hy;
+			posSide = dot(vec2(B.x, B.y), side) + B.hy;
+			negEdge = EDGE3;
+			posEdge = EDGE1;
+			incidentEdge(incident, A, front);
+			break;
+		default:
+			front = vec2(-normal.x, -normal.y);
+			frontOffset = dot(vec2(B.x, B.y), front) + B.hy;
+			side = vec2(B.c, B.s);
+			negSide = -dot(vec2(B.x, B.y), side) + B.hx;
+			posSide = dot(vec2(B.x, B.y), side) + B.hx;
+			negEdge = EDGE2;
+			posEdge = EDGE4;
+			incidentEdge(incident, A, front);
+			break;
+	}
+
+	ClipVertex clipped[2], points[2];
+	if(clipSegment(clipped, incident, vec2(-side.x, -side.y), negSide, negEdge) < 2)
+		return;
+	if(clipSegment(points, clipped, side, posSide, posEdge) < 2)
+		return;
+
+	m.nx = normal.x;
+	m.ny = normal.y;
+	const Manifold* old = previous[pair] >= 0 ? &oldManifolds[previous[pair]] : NULL;
+	for(i=0;i<2;i++){
+		float depth = dot(front, points[i].v) - frontOffset;
+		if(depth > 0)
+			continue;
+		ClipVertex& v = points[i];
+		if(axis == FACE_B_X || axis == FACE_B_Y){
+			swap(v.in1, v.in2);
+			swap(v.out1, v.out2);
+		}
+		ContactPoint& p = m.points[m.count++];
+		p.x = v.v.x - depth*front.x;
+		p.y = v.v.y - depth*front.y;
+		p.separation = depth;
+		p.feature = v.in1 | v.out1 << 8 | v.in2 << 16 | v.out2 << 24;
+		p.normalImpulse = p.tangentImpulse = 0;
+		for(j=0;old && j<old->count;j++){
+			if(old->points[j].feature == p.feature){
+				p.normalImpulse = old->points[j].normalImpulse;
+				p.tangentImpulse = old->points[j].tangentImpulse;
+			}
+		}
+	}
+}
+
+/* Static bodies are shared by the islands and never written */
+static inline void push(RigidBody& b, Vec2 r, Vec2 impulse)
+{
+	if(b.invMass == 0)
+		return;
+	b.vx += b.invMass*impulse.x;
+	b.vy += b.invMass*impulse.y;
+	b.w += b.invInertia*cross(r, impulse);
+}
+
+/* One island for a whole step: contacts, gravity, the impulses, then the new positions */
+void RigidWorld::solveIsland(int island)
+{
+	int i, k, it;
+	int firstBody = islandStart[island], lastBody = islandStart[island+1];
+	int firstPair = islandPairStart[island], lastPair = islandPairStart[island+1];
+	for(i=firstPair;i<lastPair;i++)
+		collide(islandPairs[i]);
+	for(i=firstBody;i<lastBody;i++)
+		bodies[islandBodies[i]].vy -= gravity*dt;
+
+	// Masses along the normal and the tangent, and the impulses of the step before again
+	for(i=firstPair;i<lastPair;i++){
+		Manifold& m = manifolds[islandPairs[i]];
+		RigidBody& A = bodies[m.a];
+		RigidBody& B = bodies[m.b];
+		Vec2 n = vec2(m.nx, m.ny), t = vec2(m.ny, -m.nx);
+		for(k=0;k<m.count;k++){
+			ContactPoint& p = m.points[k];
+			Vec2 r1 = vec2(p.x - A.x, p.y - A.y), r2 = vec2(p.x - B.x, p.y - B.y);
+			float rn1 = dot(r1, n), rn2 = dot(r2, n), rt1 = dot(r1, t), rt2 = dot(r2, t);
+			float kn = A.invMass + B.invMass + A.invInertia*(dot(r1, r1) - rn1*rn1) + B.invInertia*(dot(r2, r2) - rn2*rn2);
+			float kt = A.invMass + B.invMass + A.invInertia*(dot(r1, r1) - rt1*rt1) + B.invInertia*(dot(r2, r2) - rt2*rt2);
+			p.r1x = r1.x;
+			p.r1y = r1.y;
+			p.r2x = r2.x;
+			p.r2y = r2.y;
+			p.normalMass = 1/kn;
+			p.tangentMass = 1/kt;
+			p.bias = -RIGID_BIAS/dt*min(0.0f, p.separation + RIGID_SLOP);
+			Vec2 P = p.normalImpulse*n + p.tangentImpulse*t;
+			push(A, r1, vec2(-P.x, -P.y));
+			push(B, r2, P);
+		}
+	}
+
+	// The velocities of a pair are kept in registers over its points
+	for(it=0;it<iterations;it++){
+		for(i=firstPair;i<lastPair;i++){
+			Manifold& m = manifolds[islandPairs[i]];
+			if(!m.count)
+				continue;
+			RigidBody& A = bodies[m.a];
+			RigidBody& B = bodies[m.b];
+			float nx = m.nx, ny = m.ny;
+			float ma = A.invMass, ia = A.invInertia, mb = B.invMass, ib = B.invInertia;
+			float vax = A.vx, vay = A.vy, wa = A.w, vbx = B.vx, vby = B.vy, wb = B.w;
+			for(k=0;k<m.count;k++){
+				ContactPoint& p = m.points[k];
+
+				// The bodies may not go into each other, they can only be pushed apart
+				float dvx = vbx - wb*p.r2y - vax + wa*p.r1y;
+				float dvy = vby + wb*p.r2x - vay - wa*p.r1x;
+				float impulse = p.normalMass*(p.bias - (dvx*nx + dvy*ny));
+				float total = max(p.normalImpulse + impulse, 0.0f);
+				impulse = total - p.normalImpulse;
+				p.normalImpulse = total;
+				float px = impulse*nx, py = impulse*ny;
+				vax -= ma*px;
+				vay -= ma*py;
+				wa -= ia*(p.r1x*py - p.r1y*px);
+				vbx += mb*px;
+				vby += mb*py;
+				wb += ib*(p.r2x*py - p.r2y*px);
+
+				// Friction, up to friction times how hard they are pressed together
+				dvx = vbx - wb*p.r2y - vax + wa*p.r1y;
+				dvy = vby + wb*p.r2x - vay - wa*p.r1x;
+				impulse = -p.tangentMass*(dvx*ny - dvy*nx);
+				float limit = m.friction*p.normalImpulse;
+				total = min(max(p.tangentImpulse + impulse, -limit), limit);
+				impulse = total - p.tangentImpulse;
+				p.tangentImpulse = total;
+				px = impulse*ny;
+				py = -impulse*nx;
+				vax -= ma*px;
+				vay -= ma*py;
+				wa -= ia*(p.r1x*py - p.r1y*px);
+				vbx += mb*px;
+				vby += mb*py;
+				wb += ib*(p.r2x*py - p.r2y*px);
+			}
+			if(ma > 0){
+				A.vx = vax;
+				A.vy = vay;
+				A.w = wa;
+			}
+			if(mb > 0){
+				B.vx = vbx;
+				B.vy = vby;
+				B.w = wb;
+			}
+		}
+	}
+
+	float rest = RIGID_SLEEP_TIME;
+	for(i=firstBody;i<lastBody;i++){
+		RigidBody& b = bodies[islandBodies[i]];
+		b.x += dt*b.vx;
+		b.y += dt*b.vy;
+		b.angle += dt*b.w;
+		b.c = cos(b.angle);
+		b.s = sin(b.angle);
+		updateBounds(b);
+		if(b.vx*b.vx + b.vy*b.vy > RIGID_SLEEP_SPEED*RIGID_SLEEP_SPEED || b.w*b.w > RIGID_SLEEP_TURN*RIGID_SLEEP_TURN)
+			b.rest = 0;
+		else
+			b.rest += dt;
+		rest = min(rest, b.rest);
+	}
+	if(rest < RIGID_SLEEP_TIME)
+		return;
+	for(i=firstBody;i<lastBody;i++){
+		RigidBody& b = bodies[islandBodies[i]];
+		b.awake = false;
+		b.vx = b.vy = b.w = 0;
+	}
+}
+
+void RigidWorld::solveIslandJob(void* world, int index)
+{
+	RigidWorld& w = *(RigidWorld*)world;
+	w.solveIsland(w.awakeIslands[index]);
+}
+
+void RigidWorld::step(float h, WorkerPool* workers)
+{
+	int i, k;
+	dt = h;
+	// Nothing moves while everything sleeps
+	for(i=0;i<(int)order.size() && !bodies[order[i]].awake;i++)
+		;
+	if(i == (int)order.size()){
+		islandsAwake = 0;
+		return;
+	}
+	sortBodies();
+	findPairs();
+	matchManifolds();
+	buildIslands();
+
+	// Sleeping islands keep their contacts as they were
+	for(k=0;k<islands;k++){
+		int first = islandStart[k];
+		if(first == islandStart[k+1] || bodies[islandBodies[first]].awake)
+			continue;
+		for(i=islandPairStart[k];i<islandPairStart[k+1];i++){
+			int p = islandPairs[i];
+			if(previous[p] >= 0)
+				manifolds[p] = oldManifolds[previous[p]];
+			else{
+				manifolds[p].a = pairs[p].a;
+				manifolds[p].b = pairs[p].b;
+				manifolds[p].count = 0;
+			}
+		}
+	}
+
+	if(workers)
+		workers->run(awakeIslands.size(), solveIslandJob, this);
+	else
+		for(k=0;k<(int)awakeIslands.size();k++)
+			solveIsland(awakeIslands[k]);
+	sortBodies();
+}
+
+/* How many of the bodies in order have their left side at x or before it */
+int RigidWorld::startingBefore(float x) const
+{
+	int lo = 0, hi = order.size();
+	while(lo < hi){
+		int mid = (lo + hi)/2;
+		if(bodies[order[mid]].x0 <= x)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* order is sorted by the left side of the bounds, none reaches further right than widest */
+int RigidWorld::queryCircle(float x, float y, float r, std::vector<int>& out) const
+{
+	int i;
+	float px, py, nx, ny;
+	out.clear();
+	for(i=startingBefore(x + r)-1;i>=0 && bodies[order[i]].x0 >= x - r - widest;i--)
+		if(circleContact(order[i], x, y, r, px, py, nx, ny))
+			out.push_back(order[i]);
+	sort(out.begin(), out.end());
+	return out.size();
+}
+
+int RigidWorld::firstTouching(float x, float y, float r) const
+{
+	int i, first = -1;
+	float px, py, nx, ny;
+	for(i=startingBefore(x + r)-1;i>=0 && bodies[order[i]].x0 >= x - r - widest;i--)
+		if((first < 0 || order[i] < first) && circleContact(order[i], x, y, r, px, py, nx, ny))
+			first = order[i];
+	return first;
+}
+
+bool RigidWorld::circleContact(int i, float x, float y, float r, float& px, float& py, float& nx, float& ny) const
+{
+	const RigidBody& b = bodies[i];
+	if(x + r < b.x0 || x - r > b.x1 || y + r < b.y0 || y - r > b.y1)
+		return false;
+	Vec2 d = unrotate(b, vec2(x - b.x, y - b.y));
+	Vec2 q = vec2(min(max(d.x, -b.hx), b.hx), min(max(d.y, -b.hy), b.hy));
+	Vec2 n = d - q;
+	float length = sqrt(dot(n, n));
+	if(length > r)
+		return false;
+	if(length > 0)
+		n = (1/length)*n;
+	else if(b.hx - fabs(d.x) < b.hy - fabs(d.y)){
+		// The centre is inside, out through the nearest side
+		q.x = d.x < 0 ? -b.hx : b.hx;
+		n = vec2(d.x < 0 ? -1 : 1, 0);
+	}
+	else{
+		q.y = d.y < 0 ? -b.hy : b.hy;
+		n = vec2(0, d.y < 0 ? -1 : 1);
+	}
+	q = rotate(b, q);
+	n = rotate(b, n);
+	px = b.x + q.x;
+	py = b.y + q.y;
+	nx = n.x;
+	ny = n.y;
+	return true;
+}
+
+void RigidWorld::applyImpulse(int i, float px, float py, float ix, float iy)
+{
+	RigidBody& b = bodies[i];
+	if(b.invMass == 0)
+		return;
+	b.awake = true;
+	b.rest = 0;
+	push(b, vec2(px - b.x, py - b.y), vec2(ix, iy));
+}
+
+int RigidWorld::awakeBodies()
+{
+	int i, n = 0;
+	for(i=0;i<(int)order.size();i++)
+		n += bodies[order[i]].awake;
+	return n;
+}
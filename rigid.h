@@ -0,0 +1,116 @@
+#ifndef RIGID_H
+#define RIGID_H
+
+#include <vector>
+#include "workers.h"
+
+/* Solver settings: velocity iterations per step, how much overlap is left alone and what
+   share of the rest is pushed out per step */
+#define RIGID_ITERATIONS 20
+#define RIGID_SLOP 0.002f
+#define RIGID_BIAS 0.2f
+#define RIGID_MARGIN 0.005f	// bounds are grown by it, so resting contacts keep their pairs
+
+/* A body slower than RIGID_SLEEP_SPEED that turns slower than RIGID_SLEEP_TURN (radians
+   per second) is at rest; an island all at rest for RIGID_SLEEP_TIME seconds sleeps */
+#define RIGID_SLEEP_SPEED 0.02f
+#define RIGID_SLEEP_TURN 0.05f
+#define RIGID_SLEEP_TIME 0.5f
+
+/* A box; static ones have no mass and never move */
+struct RigidBody {
+	float x, y;
+	float angle;		// radians, counterclockwise
+	float c, s;		// its cosine and sine
+	float vx, vy, w;
+	float hx, hy;		// half the width and height
+	float invMass, invInertia;
+	float friction;
+	float prevx, prevy, prevAngle;
+	float x0, y0, x1, y1;	// bounds
+	float rest;		// seconds it has been at rest
+	bool awake;
+};
+
+/* Where two boxes touch, kept from step to step by the edges that made it */
+struct ContactPoint {
+	float x, y;
+	float separation;	// negative when they overlap
+	unsigned int feature;
+	float normalImpulse, tangentImpulse;	// accumulated, the next step starts from them
+	float normalMass, tangentMass, bias;
+	float r1x, r1y, r2x, r2y;	// from the centres of a and b
+};
+
+/* The contact of a pair of bodies, up to two points along normal from a to b */
+struct Manifold {
+	int a, b;
+	float nx, ny;
+	float friction;
+	int count;
+	ContactPoint points[2];
+};
+
+struct BodyPair {
+	int a, b;	// a < b
+};
+
+/* Stacks of boxes and planks, solved with sequential impulses. The bodies whose bounds
+   overlap are joined into islands, and the islands are solved independently of each
+   other on the workers, each with its contacts in pair order; nothing in one island is
+   written by another, so the result does not depend on the number of threads. An island
+   that comes to rest sleeps and costs nothing until something awake touches it.
+   Static bodies are not part of any island, all of them can touch it. */
+class RigidWorld {
+	std::vector<int> order;		// the moving bodies by the left side of their bounds
+	std::vector<int> statics;
+	float widest;			// of the moving bodies, bounds in x
+	std::vector<BodyPair> pairs;	// the bodies whose bounds overlap, sorted
+	std::vector<Manifold> manifolds;	// per pair
+	std::vector<Manifold> oldManifolds;	// of the step before
+	std::vector<int> previous;	// per pair, its manifold of the step before or -1
+	std::vector<int> parent;	// union-find over the bodies
+	std::vector<int> bodyIsland;
+	std::vector<int> islandStart, islandBodies;	// bodies of island k: islandBodies[islandStart[k] .. islandStart[k+1]-1]
+	std::vector<int> islandPairStart, islandPairs;
+	std::vector<int> awakeIslands;
+	float dt;
+
+	void sortBodies();
+	void findPairs();
+	void matchManifolds();
+	void buildIslands();
+	int root(int i);
+	int startingBefore(float x) const;
+	void collide(int pair);
+	void solveIsland(int island);
+	static void solveIslandJob(void* world, int index);
+
+	public:
+	std::vector<RigidBody> bodies;
+	float gravity;
+	int iterations;
+	int islands;		// in the last step, and how many of them were awake
+	int islandsAwake;
+
+	RigidWorld();
+	void reserve(int n);
+	void clear();
+	/* Centred at x, y; density 0 makes it static */
+	int addBox(float x, float y, float hx, float hy, float angle, float density, float friction);
+	void savePrevious();
+	void step(float dt, WorkerPool* workers);
+
+	/* The moving bodies the circle touches, in index order; the first of them, -1 for none.
+	   Both only read the world. */
+	int queryCircle(float x, float y, float r, std::vector<int>& out) const;
+	int firstTouching(float x, float y, float r) const;
+	/* Whether the circle touches body i, and where: the point of the body closest to the
+	   centre, and the normal from there towards the centre */
+	bool circleContact(int i, float x, float y, float r, float& px, float& py, float& nx, float& ny) const;
+	/* At the point px, py; wakes the body */
+	void applyImpulse(int i, float px, float py, float ix, float iy);
+	int awakeBodies();
+};
+
+#endif
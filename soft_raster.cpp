@@ -0,0 +1,302 @@
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include "soft_raster.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+/* The game draws its layers on top of each other in the same plane, relying on GL_LEQUAL.
+   Interpolated depth is not bit exact between two triangles, so allow for rounding errors */
+#define DEPTH_SLACK 1e-5f
+
+static unsigned int packColor(float r, float g, float b)
+{
+	int ir = (int)(min(max(r, 0.0f), 1.0f)*255.0f + 0.5f);
+	int ig = (int)(min(max(g, 0.0f), 1.0f)*255.0f + 0.5f);
+	int ib = (int)(min(max(b, 0.0f), 1.0f)*255.0f + 0.5f);
+	return (unsigned int)ir | ((unsigned int)ig << 8) | ((unsigned int)ib << 16) | 0xff000000u;
+}
+
+SoftRasterizer::SoftRasterizer(int w, int h, int threads) : workers(threads)
+{
+	width = w;
+	height = h;
+	tilesX = (w + SOFT_TILE_SIZE - 1)/SOFT_TILE_SIZE;
+	tilesY = (h + SOFT_TILE_SIZE - 1)/SOFT_TILE_SIZE;
+	color.resize(w*h);
+	depth.resize(w*h);
+	bins.resize(tilesX*tilesY);
+	clearColor = packColor(0, 0, 0);
+}
+
+void SoftRasterizer::setClearColor(float r, float g, float b)
+{
+	clearColor = packColor(r, g, b);
+}
+
+void SoftRasterizer::clear()
+{
+	fill(color.begin(), color.end(), clearColor);
+	fill(depth.begin(), depth.end(), 1.0f);
+	triangles.clear();
+	for (size_t i=0; i<bins.size(); i++)
+		bins[i].clear();
+}
+
+/* Column major 4x4 matrix times (x,y,z,1) */
+void SoftRasterizer::transform(const float mvp[16], const float* in, float out[4])
+{
+	for (int j=0; j<4; j++)
+		out[j] = mvp[j]*in[0] + mvp[4+j]*in[1] + mvp[8+j]*in[2] + mvp[12+j];
+}
+
+/* v are clip space positions, c the vertex colors */
+void SoftRasterizer::setupTriangle(const float v[3][4], const float c[3][3])
+{
+	SoftTriangle tri;
+	float sx[3], sy[3];
+	int i;
+
+	// Everything lies in front of the camera in this game, so there is no near plane clipping:
+	// triangles crossing w = 0 are dropped and the rest is clipped to the screen by the bounding box
+	for (i=0; i<3; i++) {
+		if (v[i][3] <= 0)
+			return;
+		tri.iw[i] = 1.0f/v[i][3];
+		sx[i] = (v[i][0]*tri.iw[i]*0.5f + 0.5f)*width;
+		sy[i] = (0.5f - v[i][1]*tri.iw[i]*0.5f)*height;
+		tri.z[i] = v[i][2]*tri.iw[i]*0.5f + 0.5f;
+		tri.r[i] = c[i][0]*tri.iw[i];
+		tri.g[i] = c[i][1]*tri.iw[i];
+		tri.b[i] = c[i][2]*tri.iw[i];
+	}
+
+	for (i=0; i<3; i++) {
+		int a = (i+1)%3, b = (i+2)%3;
+		tri.A[i] = sy[a] - sy[b];
+		tri.B[i] = sx[b] - sx[a];
+		tri.C[i] = sx[a]*sy[b] - sy[a]*sx[b];
+	}
+	// Twice the signed area. Barycentrics are later normalised by the sum of the edge functions
+	// rather than by the area, which keeps them consistent for long thin triangles
+	float area = tri.C[0] + tri.C[1] + tri.C[2];
+	if (area == 0)
+		return;
+	if (area < 0) {
+		// No face culling: flip the edges of clockwise triangles
+		for (i=0; i<3; i++) {
+			tri.A[i] = -tri.A[i];
+			tri.B[i] = -tri.B[i];
+			tri.C[i] = -tri.C[i];
+		}
+		area = -area;
+	}
+	// A shared edge is seen with opposite orientation by its two triangles, so exactly one of them owns it
+	for (i=0; i<3; i++)
+		tri.owner[i] = tri.A[i] > 0 || (tri.A[i] == 0 && tri.B[i] > 0);
+
+	tri.minx = max(0, (int)floor(min(sx[0], min(sx[1], sx[2]))));
+	tri.miny = max(0, (int)floor(min(sy[0], min(sy[1], sy[2]))));
+	tri.maxx = min(width - 1, (int)ceil(max(sx[0], max(sx[1], sx[2]))));
+	tri.maxy = min(height - 1, (int)ceil(max(sy[0], max(sy[1], sy[2]))));
+	if (tri.minx > tri.maxx || tri.miny > tri.maxy)
+		return;
+
+	int index = triangles.size();
+	triangles.push_back(tri);
+	for (int ty=tri.miny/SOFT_TILE_SIZE; ty<=tri.maxy/SOFT_TILE_SIZE; ty++)
+		for (int tx=tri.minx/SOFT_TILE_SIZE; tx<=tri.maxx/SOFT_TILE_SIZE; tx++)
+			bins[ty*tilesX + tx].push_back(index);
+}
+
+/* Lines are drawn as one pixel wide quads so that they go through the same tile pipeline */
+void SoftRasterizer::setupLine(const float v0[4], const float v1[4], const float c0[3], const float c1[3])
+{
+	if (v0[3] <= 0 || v1[3] <= 0)
+		return;
+	float dx = (v1[0]/v1[3] - v0[0]/v0[3])*width;
+	float dy = (v1[1]/v1[3] - v0[1]/v0[3])*height;
+	float len = sqrt(dx*dx + dy*dy);
+	if (len == 0)
+		return;
+	// Half a pixel along the normal, back in clip space of each end point
+	float nx = -dy/len/width, ny = dx/len/height;
+	float q[4][4] = {
+		{ v0[0] - nx*v0[3], v0[1] - ny*v0[3], v0[2], v0[3] },
+		{ v0[0] + nx*v0[3], v0[1] + ny*v0[3], v0[2], v0[3] },
+		{ v1[0] + nx*v1[3], v1[1] + ny*v1[3], v1[2], v1[3] },
+		{ v1[0] - nx*v1[3], v1[1] - ny*v1[3], v1[2], v1[3] },
+	};
+	float t0[3][4], t1[3][4], ct0[3][3], ct1[3][3];
+	for (int j=0; j<4; j++) {
+		t0[0][j] = q[0][j]; t0[1][j] = q[1][j]; t0[2][j] = q[2][j];
+		t1[0][j] = q[2][j]; t1[1][j] = q[3][j]; t1[2][j] = q[0][j];
+	}
+	for (int j=0; j<3; j++) {
+		ct0[0][j] = c0[j]; ct0[1][j] = c0[j]; ct0[2][j] = c1[j];
+		ct1[0][j] = c1[j]; ct1[1][j] = c1[j]; ct1[2][j] = c0[j];
+	}
+	setupTriangle(t0, ct0);
+	setupTriangle(t1, ct1);
+}
+
+void SoftRasterizer::draw(int primitive_mode, int fill_mode, int numVertices, const float* vertices, const float* colors, int stride, const float mvp[16])
+{
+	vector<float> clip(4*numVertices);
+	int i;
+	for (i=0; i<numVertices; i++)
+		transform(mvp, vertices + stride*i, &clip[4*i]);
+
+	const float* v = &clip[0];
+	bool lines = primitive_mode == SOFT_LINES || primitive_mode == SOFT_LINE_STRIP || fill_mode == SOFT_LINE;
+
+	if (primitive_mode == SOFT_LINES) {
+		for (i=0; i+1<numVertices; i+=2)
+			setupLine(v + 4*i, v + 4*(i+1), colors + stride*i, colors + stride*(i+1));
+	}
+	else if (primitive_mode == SOFT_LINE_STRIP) {
+		for (i=0; i+1<numVertices; i++)
+			setupLine(v + 4*i, v + 4*(i+1), colors + stride*i, colors + stride*(i+1));
+	}
+	else if (primitive_mode == SOFT_TRIANGLES || primitive_mode == SOFT_TRIANGLE_FAN) {
+		for (i=0; ; i++) {
+			int a, b, c;
+			if (primitive_mode == SOFT_TRIANGLES) {
+				a = 3*i; b = 3*i + 1; c = 3*i + 2;
+			}
+			else {
+				a = 0; b = i + 1; c = i + 2;
+			}
+			if (c >= numVertices)
+				break;
+			if (lines) {
+				setupLine(v + 4*a, v + 4*b, colors + stride*a, colors + stride*b);
+				setupLine(v + 4*b, v + 4*c, colors + stride*b, colors + stride*c);
+				setupLine(v + 4*c, v + 4*a, colors + stride*c, colors + stride*a);
+				continue;
+			}
+			float tv[3][4], tc[3][3];
+			int idx[3] = { a, b, c };
+			for (int k=0; k<3; k++) {
+				for (int j=0; j<4; j++)
+					tv[k][j] = v[4*idx[k] + j];
+				for (int j=0; j<3; j++)
+					tc[k][j] = colors[stride*idx[k] + j];
+			}
+			setupTriangle(tv, tc);
+		}
+	}
+}
+
+void SoftRasterizer::shadeTile(int tile)
+{
+	int x0 = (tile % tilesX)*SOFT_TILE_SIZE;
+	int y0 = (tile / tilesX)*SOFT_TILE_SIZE;
+	int x1 = min(x0 + SOFT_TILE_SIZE, width) - 1;
+	int y1 = min(y0 + SOFT_TILE_SIZE, height) - 1;
+	const vector<int>& bin = bins[tile];
+
+	for (size_t n=0; n<bin.size(); n++) {
+		const SoftTriangle& tri = triangles[bin[n]];
+		int minx = max(x0, tri.minx), maxx = min(x1, tri.maxx);
+		int miny = max(y0, tri.miny), maxy = min(y1, tri.maxy);
+
+		for (int y=miny; y<=maxy; y++) {
+			float py = y + 0.5f;
+			int x = minx;
+#ifdef __SSE2__
+			// Edge functions of 4 neighbouring pixels at once
+			__m128 offs = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+			for (; x<=maxx; x+=4) {
+				__m128 px = _mm_add_ps(_mm_set1_ps((float)x), offs);
+				int mask = 0xf;
+				__m128 e[3];
+				for (int i=0; i<3; i++) {
+					e[i] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.A[i]), px), _mm_set1_ps(tri.B[i]*py + tri.C[i]));
+					__m128 in = tri.owner[i] ? _mm_cmpge_ps(e[i], _mm_setzero_ps()) : _mm_cmpgt_ps(e[i], _mm_setzero_ps());
+					mask &= _mm_movemask_ps(in);
+				}
+				if (maxx - x < 3)
+					mask &= (1 << (maxx - x + 1)) - 1;
+				if (!mask)
+					continue;
+				float e0[4], e1[4], e2[4];
+				_mm_storeu_ps(e0, e[0]);
+				_mm_storeu_ps(e1, e[1]);
+				_mm_storeu_ps(e2, e[2]);
+				for (int k=0; k<4; k++) {
+					if (!(mask & (1 << k)))
+						continue;
+					float n = 1.0f/(e0[k] + e1[k] + e2[k]);
+					float l0 = e0[k]*n, l1 = e1[k]*n, l2 = e2[k]*n;
+					int p = y*width + x + k;
+					float z = l0*tri.z[0] + l1*tri.z[1] + l2*tri.z[2];
+					if (z > depth[p] + DEPTH_SLACK)
+						continue;
+					float w = 1.0f/(l0*tri.iw[0] + l1*tri.iw[1] + l2*tri.iw[2]);
+					depth[p] = z;
+					color[p] = packColor((l0*tri.r[0] + l1*tri.r[1] + l2*tri.r[2])*w,
+							(l0*tri.g[0] + l1*tri.g[1] + l2*tri.g[2])*w,
+							(l0*tri.b[0] + l1*tri.b[1] + l2*tri.b[2])*w);
+				}
+			}
+#else
+			for (; x<=maxx; x++) {
+				float px = x + 0.5f;
+				float e[3];
+				bool inside = true;
+				for (int i=0; i<3; i++) {
+					e[i] = tri.A[i]*px + tri.B[i]*py + tri.C[i];
+					inside = inside && (tri.owner[i] ? e[i] >= 0 : e[i] > 0);
+				}
+				if (!inside)
+					continue;
+				float n = 1.0f/(e[0] + e[1] + e[2]);
+				float l0 = e[0]*n, l1 = e[1]*n, l2 = e[2]*n;
+				int p = y*width + x;
+				float z = l0*tri.z[0] + l1*tri.z[1] + l2*tri.z[2];
+				if (z > depth[p] + DEPTH_SLACK)
+					continue;
+				float w = 1.0f/(l0*tri.iw[0] + l1*tri.iw[1] + l2*tri.iw[2]);
+				depth[p] = z;
+				color[p] = packColor((l0*tri.r[0] + l1*tri.r[1] + l2*tri.r[2])*w,
+						(l0*tri.g[0] + l1*tri.g[1] + l2*tri.g[2])*w,
+						(l0*tri.b[0] + l1*tri.b[1] + l2*tri.b[2])*w);
+			}
+#endif
+		}
+	}
+}
+
+void SoftRasterizer::shadeTileJob(void* raster, int tile)
+{
+	((SoftRasterizer*)raster)->shadeTile(tile);
+}
+
+/* Shade every binned triangle; the framebuffer is complete when this returns */
+void SoftRasterizer::flush()
+{
+	workers.run(tilesX*tilesY, shadeTileJob, this);
+	triangles.clear();
+	for (size_t i=0; i<bins.size(); i++)
+		bins[i].clear();
+}
+
+bool SoftRasterizer::writePPM(const char* path)
+{
+	FILE* fp = fopen(path, "wb");
+	if (fp == NULL) {
+		fprintf(stderr, "Error: cannot write %s\n", path);
+		return false;
+	}
+	fprintf(fp, "P6\n%d %d\n255\n", width, height);
+	for (int i=0; i<width*height; i++) {
+		unsigned char rgb[3] = { (unsigned char)(color[i] & 0xff), (unsigned char)((color[i] >> 8) & 0xff), (unsigned char)((color[i] >> 16) & 0xff) };
+		fwrite(rgb, 1, 3, fp);
+	}
+	fclose(fp);
+	return true;
+}
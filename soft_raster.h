@@ -0,0 +1,73 @@
+#ifndef SOFT_RASTER_H
+#define SOFT_RASTER_H
+
+#include <vector>
+#include "workers.h"
+
+/* Primitive and fill modes, same values as the GL enums so they can be passed straight through */
+#define SOFT_LINES          0x0001
+#define SOFT_LINE_STRIP     0x0003
+#define SOFT_TRIANGLES      0x0004
+#define SOFT_TRIANGLE_FAN   0x0006
+#define SOFT_LINE           0x1B01
+#define SOFT_FILL           0x1B02
+
+#define SOFT_TILE_SIZE 64
+
+/* Triangle after setup, in screen space (pixel units, y pointing down) */
+struct SoftTriangle {
+	float A[3], B[3], C[3];   // edge functions, edge i is opposite to vertex i
+	bool owner[3];            // edge i owns the pixels lying exactly on it
+	float z[3];               // depth in [0,1]
+	float iw[3];              // 1/w, for perspective correct colors
+	float r[3], g[3], b[3];   // colors premultiplied by 1/w
+	int minx, miny, maxx, maxy;
+};
+
+/* CPU rasterizer drawing into a memory framebuffer.
+   draw() transforms and sets up primitives right away and bins them into screen tiles,
+   flush() shades the tiles in parallel, one job of the workers per tile. Each tile is
+   owned by one thread and shades its triangles in submission order, so the output is
+   identical whatever the thread count. */
+class SoftRasterizer{
+	int width;
+	int height;
+	int tilesX;
+	int tilesY;
+	std::vector<unsigned int> color;   // RGBA8, row 0 is the top of the image
+	std::vector<float> depth;
+	unsigned int clearColor;
+
+	std::vector<SoftTriangle> triangles;
+	std::vector< std::vector<int> > bins;
+
+	WorkerPool workers;
+
+	static void shadeTileJob(void* raster, int tile);
+	void shadeTile(int tile);
+	void setupTriangle(const float v[3][4], const float c[3][3]);
+	void setupLine(const float v0[4], const float v1[4], const float c0[3], const float c1[3]);
+	void transform(const float mvp[16], const float* in, float out[4]);
+
+	public:
+	SoftRasterizer(int w, int h, int threads);
+
+	int getWidth(){
+		return width;
+	}
+	int getHeight(){
+		return height;
+	}
+	const unsigned int* getPixels(){
+		return &color[0];
+	}
+
+	void setClearColor(float r, float g, float b);
+	void clear();
+	/* vertices and colors are xyz / rgb triplets, stride in floats between two vertices */
+	void draw(int primitive_mode, int fill_mode, int numVertices, const float* vertices, const float* colors, int stride, const float mvp[16]);
+	void flush();
+	bool writePPM(const char* path);
+};
+
+#endif
@@ -0,0 +1,84 @@
+#include "workers.h"
+
+using namespace std;
+
+WorkerPool::WorkerPool(int threads)
+{
+	int i;
+	generation = 0;
+	busy = 0;
+	stopping = false;
+	job = NULL;
+	data = NULL;
+	jobs = 0;
+	nextJob = 0;
+	// The calling thread works too, so spawn one worker less
+	for(i=1;i<threads;i++)
+		workers.push_back(thread(&WorkerPool::workerLoop, this));
+}
+
+WorkerPool::~WorkerPool()
+{
+	int i;
+	{
+		unique_lock<mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for(i=0;i<(int)workers.size();i++)
+		workers[i].join();
+}
+
+void WorkerPool::work()
+{
+	int i;
+	for(i = nextJob++; i < jobs; i = nextJob++)
+		job(data, i);
+}
+
+void WorkerPool::workerLoop()
+{
+	int seen = 0;
+	while(true){
+		{
+			unique_lock<mutex> guard(lock);
+			while(!stopping && generation == seen)
+				wake.wait(guard);
+			if(stopping)
+				return;
+			seen = generation;
+		}
+		work();
+		{
+			unique_lock<mutex> guard(lock);
+			busy--;
+		}
+		done.notify_one();
+	}
+}
+
+void WorkerPool::run(int count, void (*job)(void* data, int index), void* data)
+{
+	int i;
+	if(workers.empty() || count <= 1){
+		for(i=0;i<count;i++)
+			job(data, i);
+		return;
+	}
+	this->job = job;
+	this->data = data;
+	jobs = count;
+	nextJob = 0;
+	{
+		unique_lock<mutex> guard(lock);
+		busy = workers.size();
+		generation++;
+	}
+	wake.notify_all();
+	work();
+	{
+		unique_lock<mutex> guard(lock);
+		while(busy > 0)
+			done.wait(guard);
+	}
+}
@@ -0,0 +1,45 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+/* Threads for the parts of the simulation that split into independent jobs. run() hands
+   the jobs out one at a time to the workers and to the calling thread, and returns once
+   all of them are done. Which thread does a job is left to chance, so a job may only
+   write what belongs to it for the result not to depend on the number of threads. */
+class WorkerPool{
+	std::vector<std::thread> workers;
+	std::mutex lock;
+	std::condition_variable wake;
+	std::condition_variable done;
+	int generation;
+	int busy;
+	bool stopping;
+
+	void (*job)(void* data, int index);
+	void* data;
+	int jobs;
+	std::atomic<int> nextJob;
+
+	void workerLoop();
+	void work();
+
+	WorkerPool(const WorkerPool&);
+	WorkerPool& operator=(const WorkerPool&);
+	public:
+	/* threads counts the calling thread, with 1 run() does everything itself */
+	WorkerPool(int threads);
+	~WorkerPool();
+
+	int threads(){
+		return workers.size() + 1;
+	}
+	/* job(data, i) for i from 0 to count-1 */
+	void run(int count, void (*job)(void* data, int index), void* data);
+};
+
+#endif